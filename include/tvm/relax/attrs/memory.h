@@ -86,6 +86,21 @@ struct AllocTensorAttrs : public tvm::AttrsNode<AllocTensorAttrs> {
   }
 };
 
+/*!
+ * \brief Attributes for copying a tensor to a device.
+ */
+struct ToDeviceAttrs : public tvm::AttrsNode<ToDeviceAttrs> {
+  int64_t runtime_device_index;
+
+  TVM_DECLARE_ATTRS(ToDeviceAttrs, "relax.attrs.ToDeviceAttrs") {
+    TVM_ATTR_FIELD(runtime_device_index)
+        .describe(
+            "The device index indicating to which device the tensor is copied at runtime. "
+            "Index -1 is reserved for the host device.")
+        .set_default(0);
+  }
+};
+
 /*!
  * \brief Attributes for allocating storage on Relax VM.
  */
@@ -53,8 +53,11 @@ class ExecBuilderNode : public Object {
    * \param func The function name.
    * \param num_inputs The number of inputs.
    * \param param_names The function parameter names.
+   * \param param_device_indexes The index of the device each parameter is expected on, all
+   *  parameters are on the first device if empty.
    */
-  void EmitFunction(std::string func, int64_t num_inputs, Array<String> param_names);
+  void EmitFunction(std::string func, int64_t num_inputs, Array<String> param_names,
+                    Array<Integer> param_device_indexes = {});
   /*!
    * \brief Emit a call instruction for a packed function.
    * \param func The packed function name.
@@ -81,9 +84,10 @@ class ExecBuilderNode : public Object {
   /*!
    * \brief Emit a constant value to the constant pool.
    * \param obj The constant value to be emitted
+   * \param device_index The runtime device index the constant is placed on, -1 for the host.
    * \return The index that represents the constant.
    */
-  vm::Index EmitConstant(TVMRetValue obj);
+  vm::Index EmitConstant(TVMRetValue obj, vm::Index device_index = 0);
   /*!
    * \brief Get the built executable.
    * \return The built executable.
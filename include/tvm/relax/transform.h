@@ -100,6 +100,24 @@ TVM_DLL Pass ToNonDataflow();
  */
 TVM_DLL Pass CallTIRRewrite();
 
+/*!
+ * \brief Statically plan the memory of the tensors allocated by relax.builtin.alloc_tensor.
+ * Tensors whose live intervals do not overlap share one relax.memory.alloc_storage, and each
+ * tensor is allocated at a planned offset via relax.memory.alloc_tensor.
+ *
+ * \return The Pass.
+ */
+TVM_DLL Pass StaticPlanBlockMemory();
+
+/*!
+ * \brief Insert relax.memory.kill_tensor/kill_storage right after the last use of the
+ * tensors and storages allocated in a function that do not escape it, so that their
+ * memory is released as early as possible.
+ *
+ * \return The Pass.
+ */
+TVM_DLL Pass KillAfterLastUse();
+
 /*!
  * \brief Attach global_symbol to Relax functions and TIR Primfuncs for codegen.
  *
@@ -135,7 +153,22 @@ TVM_DLL Pass Normalize();
 TVM_DLL Pass BindParams(String name, Map<String, runtime::NDArray> params);
 
 /*!
- * \brief Fold constant expressions.
+ * \brief Specialize a function of the module to given values of its symbolic shape vars.
+ * The PrimFuncs it calls through call_tir with arguments that become statically shaped are
+ * specialized to these shapes and added to the module.
+ *
+ * \param func_name The name of the function to specialize.
+ * \param shape_vars The map from a symbolic shape var to its value.
+ *
+ * \return The Pass.
+ */
+TVM_DLL Pass SpecializeShapes(String func_name, Map<tir::Var, PrimExpr> shape_vars);
+
+/*!
+ * \brief Fold constant expressions. A kernel is built once for all the structurally equal
+ *  PrimFuncs of the module. The pass config "relax.FoldConstant.num_threads" builds the kernels
+ *  on several threads ahead of folding, and "relax.FoldConstant.max_size_ratio" skips the folds
+ *  whose output is that many times larger than their inputs.
  *
  * \return The Pass.
  */
@@ -157,6 +190,10 @@ TVM_DLL Pass AnnotateTIROpPattern();
  * function being manipulated into function calls to the new grouped function.
  *
  * A follow-up pass named "FuseTIR" will generate a TIR PrimFunc for each grouped function.
+ * Every Relax function of the module is fused, and, with the pass config option
+ * "relax.FuseOps.fuse_reduction_epilogue", a reduction is fused with its elementwise consumer.
+ * This fusion is a fixed structural rule, applied whenever the reduced tensor has no other use,
+ * and is not guided by a cost model.
  * \param fuse_opt_level The level of fuse optimization.
  *        -1 indicates that the level will be inferred from pass context.
  * \return The Pass.
@@ -389,6 +389,14 @@ class Database : public runtime::ObjectRef {
    */
   TVM_DLL static Database JSONDatabase(String path_workload, String path_tuning_record,
                                        String path_measurement_record, bool allow_missing);
+  /*!
+   * \brief Create a database that keeps an on-disk index keyed by workload and target, and
+   *  loads the workloads and records lazily.
+   * \param path The directory holding the index and data files.
+   * \param top_k The number of tuning records kept for each pair of workload and target.
+   * \param allow_missing Whether to create new files when the given path is not found.
+   */
+  TVM_DLL static Database IndexedDatabase(String path, int top_k, bool allow_missing);
   TVM_DEFINE_MUTABLE_NOTNULLABLE_OBJECT_REF_METHODS(Database, runtime::ObjectRef, DatabaseNode);
 };
 
@@ -136,6 +136,12 @@ typedef int (*FTVMParallelLambda)(int task_id, TVMParallelGroupEnv* penv, void*
 /*!
  * \brief Backend function for running parallel jobs.
  *
+ *  The tasks are balanced dynamically between the threads, and can themselves
+ *  launch nested parallel jobs. The tasks may synchronize with
+ *  TVMBackendParallelBarrier, so a job runs at most as many tasks as threads
+ *  can run them at the same time, and a nested job runs a single task. The
+ *  number of tasks actually run is given to the tasks in penv->num_task.
+ *
  * \param flambda The parallel function to be launched.
  * \param cdata The closure data.
  * \param num_task Number of tasks to launch, can be 0, means launch
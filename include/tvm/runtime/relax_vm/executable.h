@@ -27,6 +27,7 @@
 #include <tvm/runtime/object.h>
 #include <tvm/runtime/registry.h>
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -37,6 +38,8 @@ namespace tvm {
 namespace runtime {
 namespace relax_vm {
 
+class MappedFile;
+
 /*!
  * \brief An object representing a vm closure.
  */
@@ -79,6 +82,8 @@ struct VMFunction {
   Index register_file_size;
   /*! \brief The function parameter names.*/
   std::vector<std::string> param_names;
+  /*! \brief The index of the device each parameter is expected on, -1 for the host. */
+  std::vector<Index> param_device_indexes;
 };
 
 /*!
@@ -138,12 +143,15 @@ class Executable : public runtime::ModuleNode {
   static Module LoadFromBinary(void* stream);
   /*!
    * \brief Write the Executable to the provided path as a file containing its serialized content.
+   *  The data of the NDArray constants is stored in a page-aligned section at the end of the
+   *  file, so that LoadFromFile can map it instead of reading it.
    * \param file_name The name of the file to write the serialized data to.
    * \param format The target format of the saved file.
    */
   void SaveToFile(const std::string& file_name, const std::string& format) final;
   /*!
-   * \brief Load Executable from the file.
+   * \brief Load Executable from the file. The NDArray constants saved by SaveToFile are views
+   *  of the mapped file, whose pages are only read when the constants are first used.
    * \param file_name The path of the file that load the executable from.
    * \return The loaded executable, in the form of a `runtime::Module`.
    */
@@ -155,6 +163,11 @@ class Executable : public runtime::ModuleNode {
   std::unordered_map<std::string, Index> global_map;
   /*! \brief The global constant pool. */
   std::vector<TVMRetValue> constants;
+  /*!
+   * \brief The runtime device index each constant is placed on, -1 for the host device.
+   *  The NDArray constants are copied to their device on their first use.
+   */
+  std::vector<Index> const_device_indexes;
   /*! \brief The name of packed functions. */
   std::vector<std::string> func_names;
   /*!
@@ -180,8 +193,10 @@ class Executable : public runtime::ModuleNode {
   /*!
    * \brief Save the constant pool.
    * \param strm The input stream.
+   * \param data_section If not null, the data of the NDArray constants is appended to it
+   *  instead of being written to the stream, which records its offset in the section.
    */
-  void SaveConstantSection(dmlc::Stream* strm);
+  void SaveConstantSection(dmlc::Stream* strm, std::string* data_section = nullptr);
   /*!
    * \brief Save the instructions.
    * \param strm The input stream.
@@ -200,8 +215,11 @@ class Executable : public runtime::ModuleNode {
   /*!
    * \brief Load the constant pool.
    * \param strm The input stream.
+   * \param file The mapped file holding the data section of the constants, if any.
+   * \param data_section_offset The offset of the data section in the file.
    */
-  void LoadConstantSection(dmlc::Stream* strm);
+  void LoadConstantSection(dmlc::Stream* strm, const std::shared_ptr<MappedFile>& file = nullptr,
+                           size_t data_section_offset = 0);
   /*!
    * \brief Load the instructions.
    * \param strm The input stream.
@@ -23,8 +23,14 @@
 #ifndef TVM_RUNTIME_RELAX_VM_VM_H_
 #define TVM_RUNTIME_RELAX_VM_VM_H_
 
+#include <tvm/runtime/profiling.h>
+
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "./bytecode.h"
@@ -64,6 +70,109 @@ struct VMFrame {
 
   VMFrame(Index pc, Index register_file_size)
       : return_pc(pc), register_file(register_file_size), caller_return_register(0) {}
+
+  /*! \brief Release the values held by the frame, keeping its space for reuse. */
+  void Clear() {
+    register_file.clear();
+    caller_return_register = 0;
+  }
+
+  /*!
+   * \brief Reinitialize a cleared frame for a new call.
+   * \param pc The return program counter.
+   * \param register_file_size The register file size of the called function.
+   */
+  void ResetForReuse(Index pc, Index register_file_size) {
+    return_pc = pc;
+    register_file.resize(register_file_size);
+  }
+};
+
+/*!
+ * \brief The execution state of the virtual machine on one thread.
+ *
+ * Everything that changes while running a function lives here, so that several threads
+ * can run functions of one VM concurrently, sharing its executable, constants and
+ * function table.
+ */
+struct VMExecutionContext {
+  /*!
+   * \brief The current stack of call frames.
+   * \note: Use unique ptr to avoid re-allocation and copy when frames get resized.
+   */
+  std::vector<std::unique_ptr<VMFrame>> frames;
+  /*!
+   * \brief The popped frames, reused by PushFrame so that invoking a function does not
+   *  allocate once the pool is warm.
+   */
+  std::vector<std::unique_ptr<VMFrame>> frame_free_list;
+  /*! \brief The virtual machine PC. */
+  Index pc{0};
+  /*! \brief The special return register. */
+  RegType return_value;
+  /*! \brief The function name to input register mapping. */
+  std::unordered_map<std::string, std::vector<RegType>> inputs;
+  /*! \brief The function name to output register. */
+  std::unordered_map<std::string, RegType> outputs;
+  /*! \brief The profiler recording the calls of this thread, if it is being profiled. */
+  profiling::Profiler* profiler{nullptr};
+};
+
+/*!
+ * \brief The execution contexts of the threads that invoked a VM. The context of a thread is
+ *  released when the thread exits, or with the table when the VM is destroyed.
+ */
+struct VMContextTable {
+  /*! \brief Protects contexts. */
+  std::mutex mutex;
+  /*! \brief The context of each thread, keyed by the thread-local owner of the thread. */
+  std::unordered_map<const void*, std::unique_ptr<VMExecutionContext>> contexts;
+};
+
+/*!
+ * \brief An instruction decoded when the executable is loaded.
+ *
+ * The bytecode of the executable is decoded and validated once, so that the dispatch loop
+ * does not re-decode instructions or check the program counter and register indices.
+ */
+struct DecodedInstruction {
+  /*! \brief The dispatch opcode, used to index the dispatch table. */
+  enum DispatchOp : int32_t {
+    kCall = 0,
+    kRet = 1,
+    kGoto = 2,
+    kIf = 3,
+    /*! \brief The sentinel following the last instruction. */
+    kEndOfCode = 4,
+  };
+  /*! \brief The pre-classified kind of a call argument. */
+  enum ArgKind : int32_t {
+    kRegister = 0,
+    kVMPointer = 1,
+    kImmediate = 2,
+    kConstIdx = 3,
+  };
+  /*! \brief A decoded call argument. */
+  struct Arg {
+    /*! \brief The kind of the argument. */
+    ArgKind kind;
+    /*! \brief The register, immediate value or constant index. */
+    Index value;
+  };
+  /*! \brief The dispatch opcode. */
+  DispatchOp op;
+  /*! \brief The number of arguments of a call. */
+  int32_t num_args{0};
+  /*! \brief The destination register of a call, or Instruction::kVoidArg. */
+  RegName dst{Instruction::kVoidArg};
+  /*! \brief The index of the callee in the function table. */
+  Index func_idx{0};
+  /*! \brief The offset of the first argument of a call in the decoded argument pool. */
+  Index args_begin{0};
+  /*! \brief The returned register of Ret, or the condition register of If. */
+  RegName reg{0};
+  /*! \brief The absolute jump target of Goto, or the false branch target of If. */
+  Index target_pc{0};
 };
 
 /*!
@@ -76,6 +185,11 @@ struct VMFrame {
  * enabling one to easily pass around VMs, execute them on
  * multiple threads, or serialize them to disk or over the
  * wire.
+ *
+ * Once initialized, a VM can be invoked from several threads at the same time. The loaded
+ * program (executable, device constants, function table) is shared and read-only, while each
+ * thread runs in its own VMExecutionContext. The stateful interface (set_input,
+ * invoke_stateful, get_output) is per thread as well.
  */
 class VirtualMachine : public runtime::ModuleNode {
  public:
@@ -109,7 +223,9 @@ class VirtualMachine : public runtime::ModuleNode {
    */
   PackedFunc GetFunction(const std::string& name, const ObjectPtr<Object>& sptr_to_self) final;
 
-  ~VirtualMachine() {}
+  VirtualMachine();
+
+  ~VirtualMachine();
 
   const char* type_key() const final { return "relax.VirtualMachine"; }
 
@@ -117,20 +233,70 @@ class VirtualMachine : public runtime::ModuleNode {
   Optional<runtime::Module> lib;
   /*! \brief The memory allocators. */
   std::vector<Allocator*> allocators;
-  /*! \brief Runtime physical device list. */
+  /*! \brief Runtime physical device list. The host is always the last device. */
   std::vector<Device> devices;
 
+  /*!
+   * \brief Get the device of a runtime device index.
+   * \param device_index The index in the device list, -1 is reserved for the host device.
+   * \return The device.
+   */
+  Device GetDevice(Index device_index) const {
+    if (device_index == -1) {
+      ICHECK(!devices.empty()) << "Did you forget to init the VirtualMachine with devices?";
+      return devices.back();
+    }
+    ICHECK(device_index >= 0 && device_index < static_cast<Index>(devices.size()))
+        << "The device index " << device_index << " is out of VM physical devices list";
+    return devices[device_index];
+  }
+
+  /*!
+   * \brief Get a function that the bytecode refers to by name, such as the kernel called by
+   *  vm.call_tir_dyn or the function of a closure.
+   * \param func_name The function name.
+   * \return The function, or PackedFunc(nullptr) when it is not found.
+   * \note The functions named by the string constants of the executable are resolved when it
+   *  is loaded and found by the address of the constant, other names are looked up. The
+   *  functions of the executable do not hold a reference to the VM, so the caller must only
+   *  call them while the VM is alive.
+   */
+  PackedFunc GetFuncByName(const String& func_name);
+
+  /*!
+   * \brief Enable or disable asynchronous execution. When enabled, the calls of a function
+   *  are enqueued on a stream created for each accelerator device, so that the host runs
+   *  ahead of the devices and only waits for them when it reads their results: a scalar
+   *  condition, a copy to the host, or the return of the outermost function call.
+   * \param enable Whether to enable asynchronous execution.
+   * \note It must not be called while a function of the VM is running.
+   */
+  void SetAsyncExecution(bool enable);
+  /*!
+   * \brief Get the stream the VM enqueues the work of a device on.
+   * \param dev The device.
+   * \return The stream, or nullptr (the default stream) when the execution is synchronous.
+   */
+  TVMStreamHandle GetStream(Device dev) const;
+
  protected:
+  /*!
+   * \brief Get the execution context of the calling thread, creating it on first use.
+   * \return The execution context.
+   */
+  VMExecutionContext* GetContext();
   /*!
    * \brief Push a call frame onto the call stack.
+   * \param ctx The execution context.
    * \param ret_pc The program counter to return to.
    * \param vm_func The function to be pushed to the call stack.
    */
-  void PushFrame(Index ret_pc, const VMFunction& vm_func);
+  void PushFrame(VMExecutionContext* ctx, Index ret_pc, const VMFunction& vm_func);
   /*!
    * \brief Pop a frame off the call stack.
+   * \param ctx The execution context.
    */
-  void PopFrame();
+  void PopFrame(VMExecutionContext* ctx);
   /*!
    * \brief Write to a VM register.
    * \param frame current vm frame.
@@ -138,39 +304,120 @@ class VirtualMachine : public runtime::ModuleNode {
    * \param obj The object to write to.
    */
   inline void WriteRegister(VMFrame* frame, RegName reg, const RegType& obj);
+  /*!
+   * \brief Move a value into a VM register.
+   * \param frame current vm frame.
+   * \param reg The register to write to.
+   * \param obj The object to move from.
+   */
+  inline void WriteRegister(VMFrame* frame, RegName reg, RegType&& obj);
   /*!
    * \brief Read a VM register.
    * \param frame current vm frame.
    * \param reg The register to read from.
-   * \return The value of the register.
+   * \return The value of the register. The reference is valid until the register is written
+   *  or the frame is popped.
+   */
+  inline const RegType& ReadRegister(VMFrame* frame, RegName reg) const;
+  /*!
+   * \brief Look up a function in the kernel library, then in the global PackedFunc registry.
+   * \param func_name The function name.
+   * \return The function, or PackedFunc(nullptr) when it is not found.
+   */
+  PackedFunc LookupExternFunc(const std::string& func_name);
+  /*!
+   * \brief Look up a function called by the bytecode, in the kernel library, the global
+   *  PackedFunc registry, and the functions of the executable, in that order.
+   * \param func_name The function name.
+   * \return The function, or PackedFunc(nullptr) when it is not found.
+   * \note The functions of the executable do not hold a reference to the VM, they must not
+   *  be handed out.
    */
-  inline RegType ReadRegister(VMFrame* frame, RegName reg) const;
+  PackedFunc LookupPackedFunc(const std::string& func_name);
   /*!
-   * \brief Prepare function table so that func_table_[func_index] is populated.
-   * \param func_index The function index.
+   * \brief Decode and validate the instructions of the loaded executable,
+   *  and resolve the functions they call.
    */
-  inline void PrepareFuncTable(Index func_index);
+  void DecodeInstructions();
   /*!
    * \brief Invoke a VM function.
    * \param fidx The function index.
-   * \param args The arguments to the function.
+   * \param args The arguments to the function, moved into the registers of the callee.
    * \return The object representing the result.
    */
-  RegType Invoke(Index fidx, const std::vector<RegType>& args);
+  RegType Invoke(Index fidx, std::vector<RegType> args);
+  /*!
+   * \brief Invoke a VM function.
+   * \param fidx The function index.
+   * \param args The arguments to the function, written to the registers of the callee.
+   * \return The object representing the result.
+   */
+  RegType Invoke(Index fidx, TVMArgs args);
+  /*! \brief The implementation of Invoke. */
+  template <typename ArgsType>
+  RegType InvokeImpl(Index fidx, ArgsType args);
+  /*!
+   * \brief Push the frame of a VM function and run it.
+   * \param ctx The execution context.
+   * \param gfunc The function.
+   * \param args The arguments to the function, moved into the registers of the callee.
+   * \return The object representing the result.
+   */
+  RegType InvokeFrame(VMExecutionContext* ctx, const VMFunction& gfunc, std::vector<RegType> args);
+  /*! \brief Push the frame of a VM function, writing \p args to its registers, and run it. */
+  RegType InvokeFrame(VMExecutionContext* ctx, const VMFunction& gfunc, TVMArgs args);
+  /*!
+   * \brief Push the frame of a VM function called with \p num_args arguments.
+   * \return The new frame.
+   */
+  VMFrame* EnterFrame(VMExecutionContext* ctx, const VMFunction& gfunc, size_t num_args);
+  /*!
+   * \brief Run a VM function from its first instruction, in the frame pushed by EnterFrame.
+   * \return The object representing the result.
+   */
+  RegType RunFrame(VMExecutionContext* ctx, const VMFunction& gfunc);
   /*!
    * \brief Read a VM register and cast it to int64_t.
+   * \param frame The current frame.
    * \param reg The register to read from.
    * \return The read scalar.
    */
-  int64_t LoadScalarInt(RegName reg) const;
-  /*! \brief Run VM dispatch loop. */
-  void RunLoop();
+  int64_t LoadScalarInt(VMFrame* frame, RegName reg) const;
+  /*!
+   * \brief Get a constant, copying it to the device it is placed on at its first use.
+   * \param idx The index of the constant.
+   * \return The constant.
+   */
+  inline const TVMRetValue& GetConstant(Index idx);
+  /*!
+   * \brief Copy a constant still on the host to the device it is placed on.
+   * \param idx The index of the constant.
+   */
+  void MaterializeConstant(Index idx);
+  /*!
+   * \brief Run VM dispatch loop.
+   * \param ctx The execution context.
+   */
+  void RunLoop(VMExecutionContext* ctx);
   /*!
    * \brief Run call instruction.
+   * \param ctx The execution context.
    * \param curr_frame The current frame.
    * \param inst The call instruction.
    */
-  inline void RunInstrCall(VMFrame* curr_frame, Instruction inst);
+  inline void RunInstrCall(VMExecutionContext* ctx, VMFrame* curr_frame,
+                           const DecodedInstruction& inst);
+  /*!
+   * \brief Call the function of a call instruction under the profiler, recording its latency,
+   *  the time spent synchronizing its device, and the bytes it allocates.
+   * \param prof The profiler.
+   * \param inst The call instruction.
+   * \param func The called function.
+   * \param args The arguments of the call.
+   * \param rv The return value.
+   */
+  void ProfileCall(profiling::Profiler* prof, const DecodedInstruction& inst,
+                   const PackedFunc& func, TVMArgs args, TVMRetValue* rv);
 
   /*!
    * \brief Set inputs to a function.
@@ -210,6 +457,30 @@ class VirtualMachine : public runtime::ModuleNode {
   RegType LookupVMOutput(const std::string& func_name);
 
  private:
+  /*! \brief The params bound to a function by `bind_params`. */
+  struct BoundParams {
+    /*! \brief The arguments of the function, holding the bound params. */
+    std::vector<RegType> values;
+    /*! \brief The indices of the params which are not bound, in their order. */
+    std::vector<size_t> free_indices;
+  };
+  /*!
+   * \brief Look up the params bound to a function.
+   * \param gf_idx The function index.
+   * \return The bound params, nullptr if none is bound.
+   */
+  std::shared_ptr<const BoundParams> LookupBoundParams(Index gf_idx);
+  /*!
+   * \brief Complete the arguments of a function with the params bound to it.
+   * \param bound The params bound to the function.
+   * \param func_name The function name, for the error message.
+   * \param args The arguments of the params which are not bound, in their order.
+   * \return The arguments of all the params of the function.
+   */
+  static std::vector<RegType> WithBoundParams(const BoundParams& bound,
+                                              const std::string& func_name,
+                                              std::vector<RegType> args);
+
   /*! \brief The loaded executable. */
   ObjectPtr<Executable> exec_;
   /*!
@@ -218,25 +489,51 @@ class VirtualMachine : public runtime::ModuleNode {
    *       to look up by name every time.
    *       It does mean that the definition of the function
    *       cannot change when the vm get loaded.
+   *       The table is filled when the executable is loaded and never modified afterwards,
+   *       so it is shared by all the execution contexts without locking.
    */
   std::vector<PackedFunc> func_table_;
   /*!
-   * \brief The current stack of call frames.
-   * \note: Use unique ptr to avoid re-allocation and copy when frames_ get resized.
+   * \brief Map from a string constant of the executable to the kernel, registered function or
+   *  function of the executable it names, filled when the executable is loaded and read-only
+   *  afterwards.
+   */
+  std::unordered_map<const Object*, PackedFunc> const_func_table_;
+  /*!
+   * \brief The functions of the executable, by function index, filled when the executable is
+   *  loaded and read-only afterwards. They do not hold a reference to the VM.
+   */
+  std::vector<PackedFunc> vm_func_table_;
+  /*! \brief The decoded instructions, followed by a kEndOfCode sentinel. */
+  std::vector<DecodedInstruction> decoded_instrs_;
+  /*! \brief The arguments of the decoded call instructions. */
+  std::vector<DecodedInstruction::Arg> decoded_args_;
+  /*! \brief The largest register file size of the functions in the executable. */
+  Index max_register_file_size_{0};
+  /*!
+   * \brief The global constant pool. The NDArray constants are copied to the device on their
+   *  first use, so that the executable loads without reading or copying unused weights.
    */
-  std::vector<std::unique_ptr<VMFrame>> frames_;
-  /*! \brief The virtual machine PC. */
-  Index pc_{0};
-  /*! \brief The special return register. */
-  RegType return_value_;
-  /*! \brief The global constant pool */
   std::vector<TVMRetValue> constants;
-  /*! \brief The function name to input register mapping. */
-  std::unordered_map<std::string, std::vector<RegType>> inputs_;
-  /*! \brief The function name to output register. */
-  std::unordered_map<std::string, RegType> outputs_;
+  /*! \brief Whether a constant is still on the host and needs to be copied to the device. */
+  std::unique_ptr<std::atomic<bool>[]> constant_pending_;
+  /*! \brief Protects the materialization of the constants. */
+  std::mutex constant_mutex_;
+  /*!
+   * \brief The stream of each device in asynchronous execution, nullptr for the host devices.
+   *  Empty when the execution is synchronous.
+   */
+  std::vector<TVMStreamHandle> streams_;
   /*! \brief A store of closures created by `save_function`. */
   std::unordered_map<std::string, PackedFunc> saved_closures_;
+  /*! \brief The params bound to the functions by `bind_params`, by function index. */
+  std::unordered_map<Index, std::shared_ptr<const BoundParams>> bound_params_;
+  /*! \brief The unique id of the VM, used to validate the thread-local context cache. */
+  const uint64_t id_;
+  /*! \brief The execution contexts of the threads that invoked the VM. */
+  std::shared_ptr<VMContextTable> contexts_{std::make_shared<VMContextTable>()};
+  /*! \brief Protects saved_closures_ and bound_params_. */
+  std::mutex mutex_;
 };
 
 }  // namespace relax_vm
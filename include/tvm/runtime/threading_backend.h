@@ -140,12 +140,31 @@ void ResetThreadPool();
 TVM_DLL void Configure(tvm::runtime::threading::ThreadGroup::AffinityMode mode, int nthreads,
                        std::vector<unsigned int> cpus);
 
+/*!
+ * \brief Get the ids of the CPUs the worker threads of the calling thread may use.
+ * \return The CPUs given to Configure by the calling thread, or else the first MaxConcurrency()
+ *  CPUs of the affinity mask of the calling thread.
+ */
+TVM_DLL std::vector<unsigned int> GetCpuIds();
+
 /*!
  * \brief Get the number of threads being used by the TVM runtime
  * \returns The number of threads used.
  */
 int32_t NumThreads();
 
+/*!
+ * \brief Set how long the parallel jobs launched by the calling thread wait actively.
+ *
+ *  The threads waiting for these jobs, the launching thread and the workers once they
+ *  are idle, spin for spin_count iterations before sleeping. A spin count of 0 saves the
+ *  cores for the other processes, a large one reduces the latency of the next jobs.
+ *
+ * \param spin_count The number of iterations to spin, negative for the default which can
+ *  be set with the TVM_THREAD_POOL_SPIN_COUNT environment variable.
+ */
+TVM_DLL void SetLaunchSpinCount(int64_t spin_count);
+
 }  // namespace threading
 }  // namespace runtime
 }  // namespace tvm
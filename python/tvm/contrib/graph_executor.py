@@ -207,6 +207,22 @@ class GraphModule(object):
             self.set_input(**input_dict)
         self._run()
 
+    def set_inter_op_parallelism(self, num_groups):
+        """Run the independent operators of the graph concurrently.
+
+        The cores are split into num_groups groups, each one running one operator
+        at a time. The cores split are the ones given to ``runtime.config_threadpool``,
+        or else the cores of the affinity mask of the process. Only supported when the
+        graph runs on CPU.
+
+        Parameters
+        ----------
+        num_groups : int
+            The number of operators which can run concurrently,
+            0 or 1 to run the operators in order.
+        """
+        self.module["set_inter_op_parallelism"](num_groups)
+
     def get_num_outputs(self):
         """Get the number of outputs from the graph
 
@@ -31,7 +31,7 @@ from tvm.tir.expr import IntImm
 
 from .builder import Builder
 from .cost_model import CostModel
-from .database import Database
+from .database import Database, MemoryDatabase
 from .extracted_task import ExtractedTask
 from .logging import get_loggers_from_work_dir
 from .measure_callback import MeasureCallback
@@ -39,7 +39,7 @@ from .runner import Runner
 from .search_strategy import SearchStrategy
 from .space_generator import SpaceGenerator
 from .task_scheduler import TaskScheduler
-from .tune import tune_tasks
+from .tune import create_database, tune_tasks
 from .tune_context import TuneContext
 from .utils import fork_seed
 
@@ -51,20 +51,31 @@ _extract_task_func = get_global_func(  # pylint: disable=invalid-name
     allow_missing=False,
 )
 
+# The mean run time of the failed builds and runs committed to the database, see `kMaxMeanTime`
+# in src/meta_schedule/utils.h.
+_MAX_MEAN_TIME = 1e10
+
 
 def extract_tasks(
-    mod: Union[IRModule, "relax.Function"],
+    mod: Union[IRModule, "relax.Function", List[Union[IRModule, "relax.Function"]]],
     target: Target,
-    params: Optional[Dict[str, NDArray]] = None,
+    params: Optional[Union[Dict[str, NDArray], List[Optional[Dict[str, NDArray]]]]] = None,
+    module_equality: str = "structural",
 ) -> List[ExtractedTask]:
     """Extract tuning tasks from a relax program.
 
     Parameters
     ----------
-    mod : Union[IRModule, relax.Function]
-        The module or function to tune
+    mod : Union[IRModule, relax.Function, List[Union[IRModule, relax.Function]]]
+        The module or function to tune, or a list of them, e.g. several models sharing a
+        database. The workloads shared by the modules are extracted as a single task.
     target : tvm.target.Target
         The compilation target
+    params : Optional[Union[Dict[str, tvm.runtime.NDArray], List[Optional[Dict]]]]
+        The associated parameters of the program, or of each program of the list
+    module_equality : Optional[str]
+        A string to specify the module equality testing and hashing method used to
+        deduplicate the tasks, see `tvm.meta_schedule.tune_tasks`.
 
     Returns
     -------
@@ -76,13 +87,69 @@ def extract_tasks(
     from tvm.relax.transform import BindParams
 
     # pylint: enable=import-outside-toplevel
-    if isinstance(mod, RelaxFunc):
-        mod = IRModule({"main": mod})
+    mods = list(mod) if isinstance(mod, (list, tuple)) else [mod]
+    if isinstance(params, (list, tuple)):
+        if len(params) != len(mods):
+            raise ValueError(
+                f"Length of mods ({len(mods)}) and params ({len(params)}) do not match."
+            )
+        params_list = list(params)
+    else:
+        params_list = [params] * len(mods)
     if not isinstance(target, Target):
         target = Target(target)
-    if params:
-        mod = BindParams("main", params)(mod)
-    return list(_extract_task_func(mod, target))
+    for i, (each_mod, each_params) in enumerate(zip(mods, params_list)):
+        if isinstance(each_mod, RelaxFunc):
+            each_mod = IRModule({"main": each_mod})
+        if each_params:
+            each_mod = BindParams("main", each_params)(each_mod)
+        mods[i] = each_mod
+    return list(_extract_task_func(mods, target, module_equality))
+
+
+def filter_tuned_tasks(
+    extracted_tasks: List[ExtractedTask],
+    database: Database,
+    module_equality: str = "structural",
+) -> List[ExtractedTask]:
+    """Filter out the tasks whose workload already has a tuning record for the target of the
+    task in the database. The database is only read.
+
+    Parameters
+    ----------
+    extracted_tasks : List[ExtractedTask]
+        The tasks to be filtered
+    database : Database
+        The database
+    module_equality : Optional[str]
+        The module equality of the database, used to match the workloads,
+        see `tvm.meta_schedule.tune_tasks`.
+
+    Returns
+    -------
+    tasks : List[ExtractedTask]
+        The tasks that are not tuned yet
+    """
+    # The workloads with a successful tuning record, for each target, kept in a scratch database
+    # which matches the workloads as the given one does.
+    tuned: Dict[str, Database] = {}
+    for record in database.get_all_tuning_records():
+        if not record.run_secs:
+            continue
+        mean_run_secs = sum(float(secs) for secs in record.run_secs) / len(record.run_secs)
+        if mean_run_secs >= _MAX_MEAN_TIME:
+            continue
+        target_tuned = tuned.setdefault(
+            str(record.target), MemoryDatabase(module_equality=module_equality)
+        )
+        target_tuned.commit_workload(record.workload.mod)
+    new_tasks = []
+    for task in extracted_tasks:
+        target_tuned = tuned.get(str(task.target))
+        if target_tuned is not None and target_tuned.has_workload(task.dispatched[0]):
+            continue
+        new_tasks.append(task)
+    return new_tasks
 
 
 def extracted_tasks_to_tune_contexts(
@@ -141,8 +208,8 @@ def extracted_tasks_to_tune_contexts(
 
 
 def tune_relax(
-    mod: Union[IRModule, "relax.Function"],
-    params: Dict[str, NDArray],
+    mod: Union[IRModule, "relax.Function", List[Union[IRModule, "relax.Function"]]],
+    params: Optional[Union[Dict[str, NDArray], List[Optional[Dict[str, NDArray]]]]],
     target: Union[str, Target],
     work_dir: str,
     max_trials_global: int,
@@ -158,15 +225,17 @@ def tune_relax(
     space: SpaceGenerator.SpaceGeneratorType = "post-order-apply",
     strategy: SearchStrategy.SearchStrategyType = "evolutionary",
     seed: Optional[int] = None,
+    module_equality: str = "structural",
+    incremental: bool = False,
 ) -> Database:
     """Tune a Relax program.
 
     Parameters
     ----------
-    mod : Union[IRModule, relax.Function]
-        The module or function to tune
-    params : Optional[Dict[str, tvm.runtime.NDArray]]
-        The associated parameters of the program
+    mod : Union[IRModule, relax.Function, List[Union[IRModule, relax.Function]]]
+        The module or function to tune, or a list of them tuned together
+    params : Optional[Union[Dict[str, tvm.runtime.NDArray], List[Optional[Dict]]]]
+        The associated parameters of the program, or of each program of the list
     target : Union[Target, str]
         The compilation target
     work_dir : str
@@ -195,14 +264,28 @@ def tune_relax(
         The search strategy to use
     seed : Optional[int]
         The random seed
+    module_equality : Optional[str]
+        A string to specify the module equality testing and hashing method used to
+        deduplicate the tasks and to match them with the workloads of the database,
+        see `tvm.meta_schedule.tune_tasks`.
+    incremental : bool
+        Whether to only tune the tasks whose workload has no tuning record in the database yet,
+        so that re-tuning a slightly changed model, or a model sharing kernels with the models
+        already tuned, only tunes the new kernels.
 
     Returns
     -------
     database : Database
         The database that contains the tuning records
     """
+    database = create_database(database, work_dir, module_equality)
+    extracted_tasks = extract_tasks(mod, target, params, module_equality=module_equality)
+    if incremental:
+        extracted_tasks = filter_tuned_tasks(extracted_tasks, database, module_equality)
+        if not extracted_tasks:
+            return database
     tasks, task_weights = extracted_tasks_to_tune_contexts(
-        extracted_tasks=extract_tasks(mod, target, params),
+        extracted_tasks=extracted_tasks,
         work_dir=work_dir,
         space=space,
         strategy=strategy,
@@ -221,6 +304,7 @@ def tune_relax(
         cost_model=cost_model,
         measure_callbacks=measure_callbacks,
         task_scheduler=task_scheduler,
+        module_equality=module_equality,
     )
 
 
@@ -26,6 +26,35 @@ from .task_scheduler import TaskScheduler
 from .tune_context import TuneContext
 
 
+def create_database(
+    database: Database.DatabaseType,
+    work_dir: str,
+    module_equality: str = "structural",
+) -> Database:
+    """Create the database to tune with, unless a database is given.
+
+    Parameters
+    ----------
+    database : Database.DatabaseType
+        The database, or the kind of database to create.
+    work_dir : str
+        The working directory, where a JSON database keeps its files.
+    module_equality : Optional[str]
+        A string to specify the module equality testing and hashing method,
+        see `tvm.meta_schedule.tune_tasks`.
+
+    Returns
+    -------
+    database : Database
+        The database.
+    """
+    if database == "json":
+        return Database.create(database, work_dir=work_dir, module_equality=module_equality)
+    if not isinstance(database, Database):
+        return Database.create(database, module_equality=module_equality)
+    return database
+
+
 def tune_tasks(
     *,
     tasks: List[TuneContext],
@@ -96,10 +125,7 @@ def tune_tasks(
         builder = Builder.create(builder)
     if not isinstance(runner, Runner):
         runner = Runner.create(runner)
-    if database == "json":
-        database = Database.create(database, work_dir=work_dir, module_equality=module_equality)
-    elif not isinstance(database, Database):
-        database = Database.create(database, module_equality=module_equality)
+    database = create_database(database, work_dir, module_equality)
     if not isinstance(cost_model, CostModel):
         cost_model = CostModel.create(cost_model)
     if isinstance(measure_callbacks, MeasureCallback):
@@ -20,6 +20,7 @@ from . import exec_builder
 from . import expr
 from . import ty
 from . import vm
+from . import aot
 from . import block_builder
 from . import op
 from . import analysis
@@ -60,7 +61,7 @@ from .ty import Type, ObjectType, ShapeType, DynTensorType, TupleType, FuncType,
 
 # VM
 from .exec_builder import ExecBuilder
-from .vm import VirtualMachine
+from .vm import VirtualMachine, ShapeBucketedVirtualMachine
 
 # Operator
 from .op.base import call_tir, make_closure, invoke_closure
@@ -0,0 +1,77 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""Ahead-of-time compilation of static-shape Relax functions to C."""
+from typing import Union
+
+import tvm
+from tvm import relax
+from tvm.ir.module import IRModule
+from tvm.runtime import Module
+from . import _ffi_api
+from .vm import _split_tir_relax
+
+
+def build(
+    mod: IRModule,
+    target: Union[str, tvm.target.Target],
+    mod_name: str = "default",
+) -> Module:
+    """
+    Build an IRModule of static-shape Relax functions ahead of time.
+
+    Each Relax function is emitted as a C function named ``tvmgen_<mod_name>_<name>``, which
+    calls the kernels directly and places its intermediate tensors in a static arena planned at
+    compile time. The emitted functions do not go through the Relax VM, and are not reentrant.
+
+    Parameters
+    ----------
+    mod: IRModule
+        The input IRModule to be built. The Relax functions must have static shapes, no control
+        flow, and return a single tensor.
+
+    target : Union[str, tvm.target.Target]
+        A CPU build target for the kernels.
+
+    mod_name: str
+        The name used in the prefix of the emitted functions.
+
+    Returns
+    -------
+    lib: tvm.runtime.Module
+        A C source module importing the kernel library, to be exported with export_library.
+
+    Example
+    -------
+
+    .. code-block:: python
+        lib = relax.aot.build(mod, "llvm")
+        lib.export_library("model.so")
+        func = tvm.runtime.load_module("model.so")["tvmgen_default_main"]
+    """
+    if isinstance(target, str):
+        target = tvm.target.Target(target)
+
+    passes = [relax.transform.ToNonDataflow()]
+    passes.append(relax.transform.CallTIRRewrite())
+    passes.append(relax.transform.StaticPlanBlockMemory())
+    passes.append(relax.transform.AttachGlobalSymbol())
+    seq = tvm.transform.Sequential(passes)
+    new_mod = seq(mod)
+
+    _, tir_mod = _split_tir_relax(new_mod)
+    lib = tvm.build(tir_mod, target=target)
+    return _ffi_api.AOTCodeGen(new_mod, lib, mod_name)  # type: ignore
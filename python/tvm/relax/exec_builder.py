@@ -74,18 +74,24 @@ class ExecBuilder(Object):
         return self.r(SpecialReg.VM_STATE)
 
     def function(
-        self, func_name: str, num_inputs: Optional[int] = 0, param_names: List[str] = None
+        self,
+        func_name: str,
+        num_inputs: Optional[int] = 0,
+        param_names: List[str] = None,
+        param_device_indexes: List[int] = None,
     ) -> VMFuncScope:
         """annotate a VM function."""
-        _ffi_api.ExecBuilderFunction(self, func_name, num_inputs, param_names)  # type: ignore
+        _ffi_api.ExecBuilderFunction(  # type: ignore
+            self, func_name, num_inputs, param_names, param_device_indexes
+        )
         return VMFuncScope()
 
     def _check_scope(self) -> None:
         if len(VMFuncScope.stack) == 0:
             raise ValueError("emit should happen in a function scope")
 
-    def emit_constant(self, const: TVMRetValueHandle) -> int:
-        return _ffi_api.ExecBuilderEmitConstant(self, const)  # type: ignore
+    def emit_constant(self, const: TVMRetValueHandle, device_index: int = 0) -> int:
+        return _ffi_api.ExecBuilderEmitConstant(self, const, device_index)  # type: ignore
 
     def emit_call(
         self,
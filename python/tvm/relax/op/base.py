@@ -343,3 +343,24 @@ def shape_of(expr: Expr) -> Expr:
         A relax Call, which gets the shape of the input
     """
     return _ffi_api.shape_of(expr)  # type: ignore # pylint: disable=no-member
+
+
+def to_device(data: Expr, runtime_device_index: int) -> Expr:
+    """Copy a tensor to a device of the VM. The kernels called on the copy, and the tensors
+    they produce, are placed on that device.
+
+    Parameters
+    ----------
+    data : Expr
+        The tensor to copy.
+
+    runtime_device_index : int
+        The index of the device in the device list of the VM.
+        Index -1 is reserved for the host device.
+
+    Returns
+    -------
+    result : Expr
+        A relax Call, which gets the tensor on the device.
+    """
+    return _ffi_api.to_device(data, runtime_device_index)  # type: ignore # pylint: disable=no-member
@@ -34,6 +34,11 @@ class MemAllocTensorAttrs(Attrs):
     """Attributes used in memory planning alloc_tensor operators"""
 
 
+@tvm._ffi.register_object("relax.attrs.ToDeviceAttrs")
+class ToDeviceAttrs(Attrs):
+    """Attributes used in to_device operators"""
+
+
 @tvm._ffi.register_object("relax.attrs.VMAllocStorageAttrs")
 class VMAllocStorageAttrs(Attrs):
     """Attributes used in VM alloc_storage operators"""
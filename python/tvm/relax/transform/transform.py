@@ -19,7 +19,7 @@
 import functools
 import inspect
 import types
-from typing import Callable, Dict, Union, Optional, List
+from typing import Callable, Dict, Union, Optional, List, Tuple
 import numpy as np  # type: ignore
 
 import tvm.ir
@@ -101,6 +101,31 @@ def CallTIRRewrite() -> tvm.ir.transform.Pass:
     return _ffi_api.CallTIRRewrite()  # type: ignore
 
 
+def StaticPlanBlockMemory() -> tvm.ir.transform.Pass:
+    """Statically plan the memory of the tensors allocated by relax.builtin.alloc_tensor.
+    Tensors whose live intervals do not overlap share one relax.memory.alloc_storage,
+    and each tensor is allocated at a planned offset via relax.memory.alloc_tensor.
+    Tensors that may outlive the function are left untouched.
+
+    Returns
+    -------
+    ret: tvm.ir.transform.Pass
+    """
+    return _ffi_api.StaticPlanBlockMemory()  # type: ignore
+
+
+def KillAfterLastUse() -> tvm.ir.transform.Pass:
+    """Insert relax.memory.kill_tensor/kill_storage right after the last use of the tensors
+    and storages allocated in a function, so that their memory is released early.
+    Allocations that may outlive the function are never killed.
+
+    Returns
+    -------
+    ret: tvm.ir.transform.Pass
+    """
+    return _ffi_api.KillAfterLastUse()  # type: ignore
+
+
 def VMMemoryLower() -> tvm.ir.transform.Pass:
     """Perform memory lowering. Lowers the relax.builtin.alloc_tensor intrinsic to VM intrinsics.
 
@@ -200,6 +225,67 @@ def BindParams(
     return _ffi_api.BindParams(func_name, tvm_params)  # type: ignore
 
 
+def prepack_params(
+    mod: tvm.IRModule,
+    func_name: str,
+    params: Dict[str, Union[tvm.runtime.NDArray, np.ndarray]],
+) -> Tuple[tvm.IRModule, Dict[str, tvm.runtime.NDArray]]:
+    """Pre-pack the params of a function of the module offline.
+
+    The params are bound, the computations depending only on them (e.g. the layout transforms
+    of the weights required by the kernels) are folded, and the resulting constants are lifted
+    back into params appended to the function. The pre-packed params can be saved with
+    :py:func:`tvm.runtime.save_param_dict` and bound by name at run time with
+    :py:func:`tvm.relax.VirtualMachine.load_params`, so that the executable does not embed them
+    and can be reused across checkpoints.
+
+    Parameters
+    ----------
+    mod: tvm.IRModule
+        The module containing the function.
+
+    func_name: str
+        The name of the function whose params are pre-packed.
+
+    params : Dict[str, Union[tvm.runtime.NDArray, np.ndarray]]
+        The map from param name to constant tensors.
+
+    Returns
+    -------
+    ret: Tuple[tvm.IRModule, Dict[str, tvm.runtime.NDArray]]
+        The module with the pre-packed params as params of the function, and the map from their
+        name to their value.
+    """
+    tvm_params = {}
+    for k, v in params.items():
+        if isinstance(v, np.ndarray):
+            v = tvm.nd.array(v)
+        tvm_params[k] = v
+
+    new_mod, packed_params = _ffi_api.PrepackParams(mod, func_name, tvm_params)  # type: ignore
+    return new_mod, dict(packed_params.items())
+
+
+def SpecializeShapes(func_name: str, shape_vars: Dict[tvm.tir.Var, int]) -> tvm.ir.transform.Pass:
+    """Specialize a function of the module to given values of its symbolic shape vars.
+    The PrimFuncs called through call_tir whose arguments become statically shaped are
+    specialized to these shapes and added to the module, the generic ones are kept.
+
+    Parameters
+    ----------
+    func_name: str
+        The name of the function to specialize.
+
+    shape_vars: Dict[tvm.tir.Var, int]
+        The map from a symbolic shape var of the function to its value.
+
+    Returns
+    -------
+    ret: tvm.ir.transform.Pass
+    """
+    return _ffi_api.SpecializeShapes(func_name, shape_vars)  # type: ignore
+
+
 def RemoveUnusedFunctions(entry_functions: Optional[List[str]] = None) -> tvm.ir.transform.Pass:
     """Remove unused relax/prim functions without external linkage in a IRModule.
 
@@ -243,6 +329,11 @@ def RunCodegen(
 def FoldConstant() -> tvm.ir.transform.Pass:
     """Fold constant expressions.
 
+    A kernel is built once for all the structurally equal PrimFuncs of the module. The pass
+    config "relax.FoldConstant.num_threads" builds the kernels on several threads ahead of
+    folding, and "relax.FoldConstant.max_size_ratio" skips the folds whose output is more than
+    that many times larger than their inputs (e.g. broadcasts of weights).
+
     Returns
     -------
     ret: tvm.ir.transform.Pass
@@ -268,6 +359,12 @@ def FuseOps(fuse_opt_level=-1) -> tvm.ir.transform.Pass:
 
     A follow-up pass named "FuseTIR" will generate a TIR PrimFunc for each grouped function.
 
+    Every Relax function of the module is fused, including the dataflow blocks nested in
+    functions and in the branches of control flow. With the pass config option
+    ``relax.FuseOps.fuse_reduction_epilogue``, a reduction is also fused with its single
+    elementwise consumer, which saves writing the reduced tensor to memory. This is a fixed
+    structural rule, not guided by a cost model.
+
     Parameters
     ----------
     fuse_opt_level : int
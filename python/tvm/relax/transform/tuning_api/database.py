@@ -17,6 +17,7 @@
 """Relax Tuning Pass API default functions"""
 from typing import List, Optional
 import logging
+import os
 
 from tvm.runtime import Object
 from tvm.ir.module import IRModule
@@ -271,3 +272,48 @@ class JSONDatabase(Database):
             path_measurement_record,
             allow_missing,
         )
+
+
+@register_object("relax.tuning_api.IndexedDatabase")
+class IndexedDatabase(Database):
+    """The class of indexed database.
+    It keeps an on-disk index keyed by workload and target next to a data file of compact
+    payloads. Opening the database only reads the index, and the workloads and records are
+    loaded when they are first queried.
+
+    Parameters
+    ----------
+    path : str
+        The directory holding the index and data files.
+    top_k : int
+        The number of tuning records kept for each pair of workload and target.
+    """
+
+    path: str
+    top_k: int
+
+    def __init__(self, path: str, top_k: int = 16, allow_missing: bool = True) -> None:
+        """Constructor.
+
+        Parameters
+        ----------
+        path : str
+            The directory holding the index and data files.
+        top_k : int
+            The number of tuning records kept for each pair of workload and target.
+        allow_missing : bool
+            Whether to create new files when the given path is not found.
+        """
+        if allow_missing:
+            os.makedirs(path, exist_ok=True)
+        self.__init_handle_by_constructor__(
+            _ffi_api.DatabaseIndexedDatabase,  # type: ignore # pylint: disable=no-member
+            path,
+            top_k,
+            allow_missing,
+        )
+
+    def compact(self) -> None:
+        """Rewrite the files of the database with only the workloads, the measurement records
+        and the top K tuning records of each pair of workload and target."""
+        _ffi_api.IndexedDatabaseCompact(self)  # type: ignore # pylint: disable=no-member
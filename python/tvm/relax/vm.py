@@ -16,7 +16,9 @@
 # under the License.
 # pylint: disable=invalid-name, redefined-builtin, no-else-return
 """The Relax virtual machine"""
-from typing import Callable, List, Optional, Union, Dict, Tuple
+from concurrent.futures import Future, ThreadPoolExecutor, wait
+from typing import Callable, List, Optional, Union, Dict, Set, Tuple
+import threading
 import numpy as np  # type: ignore
 
 from tvm._ffi import base as _base
@@ -110,11 +112,7 @@ class VirtualMachine(object):
                 )
             devs = [dev]
 
-        if any(dev.device_type % RPC_SESS_MASK == tvm.cpu().device_type for dev in devs[:-1]):
-            raise RuntimeError(
-                "CPU host is required to be the last element of the device list if provided."
-            )
-
+        # Several CPU devices (e.g. one per NUMA node) may be listed, the last device is the host.
         # CPU is required for executing shape functions
         if devs[-1].device_type % RPC_SESS_MASK != tvm.cpu().device_type:
             devs.append(tvm.cpu())
@@ -450,6 +448,299 @@ class VirtualMachine(object):
             f_preproc=f_preproc,
         )
 
+    def profile(self, func_name: str, *args: Any) -> "tvm.runtime.profiling.Report":
+        """Profile a call of a function, reporting each kernel and builtin it calls.
+
+        The function is run once to warm up, then once more under the profiler. Every call is
+        reported with its latency, the time spent synchronizing its device afterwards, and the
+        bytes it allocates when it is a storage allocation.
+
+        Parameters
+        ----------
+        func_name : str
+            The name of the function.
+
+        args : List[tvm.nd.NDArray]
+            The arguments of the function.
+
+        Returns
+        -------
+        report : tvm.runtime.profiling.Report
+            The per-call profiling report, e.g. print it with ``report.table()``.
+        """
+        return self.module["profile"](func_name, *args)
+
+    def load_params(
+        self,
+        func_name: str,
+        params: Union[bytes, bytearray, Dict[str, tvm.nd.NDArray]],
+    ) -> None:
+        """Bind the params of a function by name, e.g. the params pre-packed by
+        :py:func:`tvm.relax.transform.prepack_params`. The function is then called, and given
+        its inputs by :py:meth:`set_input`, with its remaining params only, in their order.
+
+        Parameters
+        ----------
+        func_name : str
+            The name of the function.
+
+        params : Union[bytes, bytearray, Dict[str, tvm.nd.NDArray]]
+            The params, or their serialization by :py:func:`tvm.runtime.save_param_dict`.
+        """
+        if isinstance(params, (bytes, bytearray)):
+            self.module["load_params"](func_name, bytearray(params))
+        else:
+            self.module["bind_params"](func_name, params)
+
+    def set_async_execution(self, enable: bool = True) -> None:
+        """Enable or disable asynchronous execution.
+
+        When enabled, the kernels called on each accelerator device are enqueued on a stream of
+        that device, so that the host runs the shape computations and control flow ahead of
+        them. The host only waits for a device when it reads a scalar condition or a copy to the
+        host, and when the outermost function call returns.
+
+        Parameters
+        ----------
+        enable : bool
+            Whether to enable asynchronous execution.
+        """
+        self.module["set_async_execution"](enable)
+
+    def memory_stats(self, dev: Device) -> Dict[str, float]:
+        """Get the statistics of the pooled allocator of a device.
+
+        The allocator is shared by all the virtual machines using the device.
+
+        Parameters
+        ----------
+        dev : Device
+            The device whose allocator is queried.
+
+        Returns
+        -------
+        stats : Dict[str, float]
+            The bytes in use, the bytes cached for reuse, the number of allocation
+            requests, the number of requests served from the cache and their rate.
+        """
+        f = tvm.get_global_func("vm.memory_manager.pooled_allocator_stats")
+        stats = f(dev.device_type, dev.device_id)
+        return {
+            name: value.ratio if name == "hit_rate" else value.value
+            for name, value in stats.items()
+        }
+
+    def trim_memory(self, dev: Device, max_cached_bytes: int = 0) -> None:
+        """Release the buffers cached by the pooled allocator of a device, e.g. when idle.
+
+        Parameters
+        ----------
+        dev : Device
+            The device whose allocator is trimmed.
+
+        max_cached_bytes : int
+            The number of cached bytes to keep.
+        """
+        f = tvm.get_global_func("vm.memory_manager.pooled_allocator_trim")
+        f(dev.device_type, dev.device_id, max_cached_bytes)
+
+    def set_idle_trim(self, dev: Device, timeout_ms: int) -> None:
+        """Release the buffers cached by the pooled allocator of a device once no buffer
+        was allocated or freed for a timeout.
+
+        Parameters
+        ----------
+        dev : Device
+            The device whose allocator is trimmed.
+
+        timeout_ms : int
+            The idle timeout in milliseconds, 0 disables the idle trim.
+        """
+        f = tvm.get_global_func("vm.memory_manager.pooled_allocator_set_idle_trim")
+        f(dev.device_type, dev.device_id, timeout_ms)
+
+    def set_memory_limit(self, dev: Device, limit_bytes: int) -> None:
+        """Cap the bytes in use plus the bytes cached by the pooled allocator of a device.
+        Cached buffers are released when a new allocation would exceed the cap, and the
+        allocation fails if the buffers in use alone still exceed it.
+
+        Parameters
+        ----------
+        dev : Device
+            The device whose allocator is capped.
+
+        limit_bytes : int
+            The cap in bytes, 0 means unlimited.
+        """
+        f = tvm.get_global_func("vm.memory_manager.pooled_allocator_set_limit")
+        f(dev.device_type, dev.device_id, limit_bytes)
+
+
+class ShapeBucketedVirtualMachine(object):
+    """Relax VM runtime that specializes a dynamic-shape function to its hot input shapes.
+
+    Every call records the shape signature of its inputs. Once a signature has been seen
+    `hot_threshold` times, the function is compiled again in the background with its symbolic
+    shape vars bound to that signature, which gives static kernels and a static memory plan.
+    The calls keep running the dynamic executable until the build is done, then the calls with
+    the signature are dispatched to the specialized executable. At most `max_buckets`
+    signatures are specialized, calls with any other signature run the dynamic executable.
+    """
+
+    def __init__(
+        self,
+        mod: tvm.IRModule,
+        target: Union[str, tvm.target.Target],
+        device: Union[Device, List[Device]],
+        func_name: str = "main",
+        hot_threshold: int = 8,
+        max_buckets: int = 4,
+        memory_cfg: Optional[Union[str, Dict[Device, str]]] = None,
+    ) -> None:
+        """
+        Construct a ShapeBucketedVirtualMachine.
+
+        Parameters
+        ----------
+        mod: IRModule
+            The input IRModule to be built.
+
+        target : Union[str, tvm.target.Target]
+            The build target.
+
+        device : Union[Device, List[Device]]
+            The device to deploy the module.
+
+        func_name : str
+            The name of the dynamic-shape function to dispatch.
+
+        hot_threshold : int
+            The number of calls with a shape signature before it is specialized.
+
+        max_buckets : int
+            The maximum number of specialized shape signatures.
+
+        memory_cfg : Optional[Union[str, Dict[Device, str]]]
+            Config the type of memory allocator, see VirtualMachine.
+        """
+        self._mod = mod
+        self._target = target
+        self._device = device
+        self._memory_cfg = memory_cfg
+        self._func_name = func_name
+        self._hot_threshold = hot_threshold
+        self._max_buckets = max_buckets
+        self._dynamic_vm = VirtualMachine(build(mod, target), device, memory_cfg)
+        self._lock = threading.Lock()
+        # The specialized builds run one at a time, off the request path.
+        self._executor = ThreadPoolExecutor(max_workers=1)
+        self._counts: Dict[Tuple, int] = {}
+        # Map from a shape signature to the future of its specialized VM.
+        self._buckets: Dict[Tuple, Future] = {}
+        # The shape signatures which cannot be specialized, never retried.
+        self._failed: Set[Tuple] = set()
+        self._param_shapes = []
+        for param in mod[func_name].params:
+            sinfo = param.struct_info
+            if isinstance(sinfo, relax.TensorStructInfo) and isinstance(
+                sinfo.shape, relax.ShapeExpr
+            ):
+                self._param_shapes.append(list(sinfo.shape.values))
+            else:
+                self._param_shapes.append(None)
+
+    @property
+    def specialized_shapes(self) -> List[Tuple]:
+        """The shape signatures dispatched to a specialized executable."""
+        with self._lock:
+            return [
+                sig
+                for sig, future in self._buckets.items()
+                if future.done() and future.exception() is None
+            ]
+
+    def wait_for_builds(self) -> None:
+        """Wait for the specialized executables being built."""
+        with self._lock:
+            futures = list(self._buckets.values())
+        wait(futures)
+        with self._lock:
+            for sig, future in list(self._buckets.items()):
+                self._check_build(sig, future)
+
+    def __call__(self, *args: Any) -> Object:
+        vm = self._dynamic_vm
+        sig = self._signature(args)
+        if sig is not None:
+            with self._lock:
+                vm = self._dispatch(sig)
+        return vm[self._func_name](*args)
+
+    def _dispatch(self, sig: Tuple) -> "VirtualMachine":
+        """Get the VM of a shape signature, starting its build once it is hot."""
+        future = self._buckets.get(sig)
+        if future is not None:
+            if future.done() and self._check_build(sig, future):
+                return future.result()
+            return self._dynamic_vm
+        if sig in self._failed or len(self._buckets) >= self._max_buckets:
+            return self._dynamic_vm
+        count = self._counts.get(sig, 0) + 1
+        self._counts[sig] = count
+        if count >= self._hot_threshold:
+            del self._counts[sig]
+            shape_vars = self._bind_shape_vars(sig)
+            if shape_vars is None:
+                self._failed.add(sig)
+            else:
+                self._buckets[sig] = self._executor.submit(
+                    self._specialize, shape_vars, tvm.transform.PassContext.current()
+                )
+        return self._dynamic_vm
+
+    def _check_build(self, sig: Tuple, future: Future) -> bool:
+        """Whether the build of a signature succeeded, which frees its bucket otherwise."""
+        if future.done() and future.exception() is not None:
+            del self._buckets[sig]
+            self._failed.add(sig)
+            return False
+        return True
+
+    @staticmethod
+    def _signature(args: Tuple) -> Optional[Tuple]:
+        sig = []
+        for arg in args:
+            if not isinstance(arg, tvm.nd.NDArray):
+                return None
+            sig.append(tuple(int(dim) for dim in arg.shape))
+        return tuple(sig)
+
+    def _bind_shape_vars(self, sig: Tuple) -> Optional[Dict[tvm.tir.Var, int]]:
+        """Bind the symbolic shape vars of the function to a shape signature, if possible."""
+        if len(sig) != len(self._param_shapes):
+            return None
+        shape_vars: Dict[tvm.tir.Var, int] = {}
+        for param_shape, arg_shape in zip(self._param_shapes, sig):
+            if param_shape is None:
+                continue
+            if len(param_shape) != len(arg_shape):
+                return None
+            for dim, value in zip(param_shape, arg_shape):
+                if not isinstance(dim, tvm.tir.Var):
+                    continue
+                if shape_vars.setdefault(dim, value) != value:
+                    return None
+        return shape_vars if shape_vars else None
+
+    def _specialize(
+        self, shape_vars: Dict[tvm.tir.Var, int], pass_ctx: tvm.transform.PassContext
+    ) -> "VirtualMachine":
+        """Build the VM of the function specialized to values of its shape vars."""
+        with pass_ctx:
+            mod = relax.transform.SpecializeShapes(self._func_name, shape_vars)(self._mod)
+            ex = build(mod, self._target)
+        return VirtualMachine(ex, self._device, self._memory_cfg)
+
 
 def build(
     mod: tvm.IRModule,
@@ -501,6 +792,8 @@ def build(
 
     passes = [relax.transform.ToNonDataflow()]
     passes.append(relax.transform.CallTIRRewrite())
+    passes.append(relax.transform.StaticPlanBlockMemory())
+    passes.append(relax.transform.KillAfterLastUse())
     passes.append(relax.transform.VMMemoryLower())
     passes.append(relax.transform.VMShapeLower())
     passes.append(relax.transform.AttachGlobalSymbol())
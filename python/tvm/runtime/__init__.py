@@ -22,7 +22,13 @@ from .object import Object
 from .object_path import ObjectPath, ObjectPathPair
 from .object_generic import ObjectGeneric, ObjectTypes
 from .ndarray import NDArray, DataType, DataTypeCode, Device
-from .module import Module, num_threads
+from .module import (
+    Module,
+    num_threads,
+    config_threadpool_shared,
+    config_threadpool_spin_count,
+    threadpool_stats,
+)
 from .profiling import Report
 
 # function exposures
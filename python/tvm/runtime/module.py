@@ -652,4 +652,64 @@ def num_threads() -> int:
     return _ffi_api.NumThreads()
 
 
+def config_threadpool_shared(shared: bool):
+    """Make the threads launching parallel jobs share one process-wide thread pool.
+
+    By default each thread launching parallel jobs owns its pool of workers. With the
+    shared pool, a job only uses the workers which are not working for another job, and
+    ``config_threadpool`` on a launching thread limits the number of workers it uses.
+
+    Parameters
+    ----------
+    shared : bool
+        Whether to share the process-wide pool.
+    """
+    _ffi_api.config_threadpool_shared(shared)
+
+
+def config_threadpool_spin_count(spin_count: int):
+    """Set how long the parallel jobs launched by the current thread wait actively.
+
+    The threads waiting for these jobs spin for ``spin_count`` iterations before sleeping.
+    A spin count of 0 saves the cores for the other processes, a large one reduces the
+    latency of the next jobs.
+
+    Parameters
+    ----------
+    spin_count : int
+        The number of iterations to spin, negative for the default which can be set with
+        the ``TVM_THREAD_POOL_SPIN_COUNT`` environment variable.
+    """
+    _ffi_api.config_threadpool_spin_count(spin_count)
+
+
+def threadpool_stats(reset: bool = False) -> dict:
+    """Get the statistics of the thread pool used by the current thread.
+
+    Parameters
+    ----------
+    reset : bool
+        Whether to reset the statistics after reading them.
+
+    Returns
+    -------
+    dict
+        The number of launches, of tickets run by the workers and of tickets denied because
+        no worker was free, the mean and max queueing delays of the tickets, and the time
+        the launching threads and each worker spent spinning and sleeping, in microseconds.
+    """
+    stats = {}
+    for name, value in _ffi_api.ThreadPoolStats(reset).items():
+        if name == "workers":
+            stats[name] = [
+                {key: wait_time.microseconds for key, wait_time in worker.items()}
+                for worker in value
+            ]
+        elif name.endswith("_us"):
+            stats[name] = value.microseconds
+        else:
+            stats[name] = value.value
+    return stats
+
+
 _set_class_module(Module)
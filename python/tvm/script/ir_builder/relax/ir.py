@@ -38,6 +38,7 @@ from tvm.relax.op import (
     multiply,
     print,
     shape_of,
+    to_device,
     unique,
     memory,
 )
@@ -420,5 +421,6 @@ __all__ = [
     "unique",
     "shape_of",
     "tensor",
+    "to_device",
     "memory",
 ]
@@ -0,0 +1,389 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/relax/backend/aot/codegen_aot.cc
+ * \brief A codegen emitting static-shape Relax functions as straight-line C functions that call
+ *  the kernels directly, without going through the Relax VM.
+ */
+#include <tvm/relax/attrs/memory.h>
+#include <tvm/relax/expr_functor.h>
+#include <tvm/relax/struct_info.h>
+#include <tvm/runtime/device_api.h>
+#include <tvm/runtime/module.h>
+#include <tvm/tir/function.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../../../target/source/codegen_source_base.h"
+
+namespace tvm {
+namespace relax {
+namespace aot {
+
+using runtime::kAllocAlignment;
+
+// ==================
+// CodeGenAOT
+// Emit each Relax function as a C function with the packed calling convention, named
+// tvmgen_<mod_name>_<global symbol>. The functions are expected after CallTIRRewrite and
+// StaticPlanBlockMemory, with static shapes and no control flow. Example:
+// def main(x: R.Tensor((16, 16), "float32")):
+//   storage = R.memory.alloc_storage((1024,), 0, "global", "float32")
+//   alloc0 = R.memory.alloc_tensor(storage, (16, 16), 0, "float32")
+//   _ = addone(x, alloc0)
+//   alloc1 = R.builtin.alloc_tensor((16, 16), "float32", 0)
+//   _ = addone(alloc0, alloc1)
+//   return alloc1
+// -->
+// static uint8_t tvmgen_default_main_arena[1024];
+// static DLTensor tvmgen_default_main_t0 = {tvmgen_default_main_arena + 0, ...};
+// int32_t tvmgen_default_main(TVMValue* args, int32_t* type_codes, int32_t num_args, ...) {
+//   <call addone(args[0], &tvmgen_default_main_t0)>
+//   TVMArrayAlloc(..., &alloc0);
+//   <call addone(&tvmgen_default_main_t0, alloc0)>
+//   <return alloc0>
+// }
+//
+// The planned tensors live in a static arena per function, so the emitted functions are not
+// reentrant. The tensors left unplanned by StaticPlanBlockMemory, i.e. the returned one, are
+// allocated at run time and handed over to the caller.
+
+class CodeGenAOT {
+ public:
+  CodeGenAOT(IRModule mod, String mod_name) : mod_(mod), mod_name_(mod_name) {}
+
+  /*!
+   * \brief Emit a Relax function.
+   * \return The name of the emitted C function.
+   */
+  std::string AddFunction(const Function& func) {
+    Optional<String> gsymbol = func->GetAttr<String>(tvm::attr::kGlobalSymbol);
+    ICHECK(gsymbol.defined()) << "there should be no local functions in AOT codegen phase. "
+                                 "Did you forget to apply LambdaLift pass?";
+    func_name_ = "tvmgen_" + std::string(mod_name_) + "_" + std::string(gsymbol.value());
+    tensors_.clear();
+    runtime_allocs_.clear();
+    arena_bytes_ = 0;
+    num_statics_ = 0;
+
+    std::ostringstream body;
+    int num_params = func->params.size();
+    for (int i = 0; i < num_params; ++i) {
+      const Var& param = func->params[i];
+      CHECK(param->struct_info_.as<TensorStructInfoNode>())
+          << "AOT codegen only supports tensor parameters, but " << param << " has struct info "
+          << param->struct_info_;
+      body << "  if (type_codes[" << i << "] != kTVMDLTensorHandle && type_codes[" << i
+           << "] != kTVMNDArrayHandle) {\n"
+           << "    TVMAPISetLastError(\"" << func_name_ << ": expects a tensor as argument " << i
+           << "\");\n"
+           << "    return -1;\n"
+           << "  }\n";
+      tensors_[param.get()] = "((DLTensor*)args[" + std::to_string(i) + "].v_handle)";
+    }
+
+    const auto* seq = func->body.as<SeqExprNode>();
+    CHECK(seq != nullptr) << "AOT codegen expects the body of " << gsymbol.value()
+                          << " to be a SeqExpr";
+    // The arena offsets of the storages, before the arena size is known.
+    std::unordered_map<const VarNode*, int64_t> storage_offsets;
+    std::ostringstream calls;
+    for (const BindingBlock& block : seq->blocks) {
+      for (const Binding& binding : block->bindings) {
+        const auto* var_binding = binding.as<VarBindingNode>();
+        CHECK(var_binding != nullptr)
+            << "AOT codegen only supports static shapes, but gets the binding " << binding;
+        EmitBinding(var_binding->var, var_binding->value, &storage_offsets, &calls);
+      }
+    }
+
+    const auto* ret = seq->body.as<VarNode>();
+    std::string ret_tensor = ret != nullptr ? LookupTensor(GetRef<Var>(ret)) : "";
+    CHECK(std::find(runtime_allocs_.begin(), runtime_allocs_.end(), ret_tensor) !=
+          runtime_allocs_.end())
+        << "AOT codegen expects " << gsymbol.value()
+        << " to return a single tensor computed by the function, but it returns " << seq->body;
+
+    if (arena_bytes_ != 0) {
+      decl_stream_ << "static TVM_AOT_ALIGNED uint8_t " << func_name_ << "_arena[" << arena_bytes_
+                   << "];\n";
+    }
+    decl_stream_ << statics_.str() << "\n";
+    statics_.str("");
+
+    code_stream_ << "TVM_DLL int32_t " << func_name_
+                 << "(TVMValue* args, int32_t* type_codes, int32_t num_args, "
+                    "TVMValue* out_ret_value, int32_t* out_ret_tcode, void* resource_handle) {\n";
+    for (const std::string& alloc : runtime_allocs_) {
+      code_stream_ << "  TVMArrayHandle " << alloc << " = NULL;\n";
+    }
+    code_stream_ << "  TVMValue values[" << max_call_args_ << "];\n"
+                 << "  int32_t codes[" << max_call_args_ << "];\n"
+                 << "  TVMValue rv;\n"
+                 << "  int32_t rcode;\n"
+                 << "  if (num_args != " << num_params << ") {\n"
+                 << "    TVMAPISetLastError(\"" << func_name_ << ": expects " << num_params
+                 << " arguments\");\n"
+                 << "    return -1;\n"
+                 << "  }\n"
+                 << body.str() << calls.str();
+    for (const std::string& alloc : runtime_allocs_) {
+      if (alloc != ret_tensor) {
+        code_stream_ << "  TVMArrayFree(" << alloc << ");\n";
+      }
+    }
+    code_stream_ << "  out_ret_value->v_handle = " << ret_tensor << ";\n"
+                 << "  *out_ret_tcode = kTVMNDArrayHandle;\n"
+                 << "  return 0;\n"
+                 << "fail:\n";
+    for (const std::string& alloc : runtime_allocs_) {
+      code_stream_ << "  if (" << alloc << " != NULL) TVMArrayFree(" << alloc << ");\n";
+    }
+    code_stream_ << "  return -1;\n}\n\n";
+    return func_name_;
+  }
+
+  /*! \return The C source of the emitted functions. */
+  std::string Finish() const {
+    std::ostringstream os;
+    os << "// tvm target: c -keys=cpu\n"
+       << "#include <stdint.h>\n"
+       << "#include <tvm/runtime/c_backend_api.h>\n"
+       << "#include <tvm/runtime/c_runtime_api.h>\n\n"
+       << "#if defined(_MSC_VER)\n"
+       << "#define TVM_AOT_ALIGNED __declspec(align(" << kAllocAlignment << "))\n"
+       << "#else\n"
+       << "#define TVM_AOT_ALIGNED __attribute__((aligned(" << kAllocAlignment << ")))\n"
+       << "#endif\n\n"
+       << "#ifdef __cplusplus\n"
+       << "extern \"C\" {\n"
+       << "#endif\n\n"
+       << kernel_decl_stream_.str() << "\n"
+       << decl_stream_.str() << code_stream_.str() << "#ifdef __cplusplus\n"
+       << "}  // extern \"C\"\n"
+       << "#endif\n";
+    return os.str();
+  }
+
+ private:
+  void EmitBinding(const Var& var, const Expr& value,
+                   std::unordered_map<const VarNode*, int64_t>* storage_offsets,
+                   std::ostringstream* calls) {
+    if (const auto* alias = value.as<VarNode>()) {
+      if (storage_offsets->count(alias)) {
+        (*storage_offsets)[var.get()] = storage_offsets->at(alias);
+      } else {
+        tensors_[var.get()] = LookupTensor(GetRef<Var>(alias));
+      }
+      return;
+    }
+    if (const auto* constant = value.as<ConstantNode>()) {
+      tensors_[var.get()] = EmitConstant(constant->data);
+      return;
+    }
+    const auto* call = value.as<CallNode>();
+    CHECK(call != nullptr) << "AOT codegen cannot handle the binding " << var << " = " << value;
+    if (call->op.same_as(mem_alloc_storage_op_)) {
+      const auto* attrs = call->attrs.as<MemAllocStorageAttrs>();
+      CHECK_EQ(attrs->virtual_device_index, 0) << "AOT codegen only supports the host device";
+      int64_t bytes = StaticShape(call->args[0])[0];
+      (*storage_offsets)[var.get()] = arena_bytes_;
+      arena_bytes_ += (bytes + kAllocAlignment - 1) / kAllocAlignment * kAllocAlignment;
+    } else if (call->op.same_as(mem_alloc_tensor_op_)) {
+      const auto* attrs = call->attrs.as<MemAllocTensorAttrs>();
+      const auto* storage = call->args[0].as<VarNode>();
+      CHECK(storage != nullptr && storage_offsets->count(storage))
+          << "AOT codegen expects the storage of " << var << " to be allocated in the function";
+      int64_t offset = storage_offsets->at(storage) + attrs->offset;
+      tensors_[var.get()] = EmitStaticTensor(func_name_ + "_arena + " + std::to_string(offset),
+                                             StaticShape(call->args[1]), attrs->dtype);
+    } else if (call->op.same_as(builtin_alloc_tensor_op_)) {
+      const auto* attrs = call->attrs.as<AllocTensorAttrs>();
+      CHECK_EQ(attrs->runtime_device_index, 0) << "AOT codegen only supports the host device";
+      std::vector<int64_t> shape = StaticShape(call->args[0]);
+      std::string alloc = "alloc" + std::to_string(runtime_allocs_.size());
+      std::string shape_name = EmitShape(shape);
+      *calls << "  if (TVMArrayAlloc(" << shape_name << ", " << shape.size() << ", "
+             << static_cast<int>(attrs->dtype.code()) << ", " << attrs->dtype.bits() << ", "
+             << attrs->dtype.lanes() << ", kDLCPU, 0, &" << alloc << ") != 0) goto fail;\n";
+      runtime_allocs_.push_back(alloc);
+      tensors_[var.get()] = alloc;
+    } else if (const auto* gv = call->op.as<GlobalVarNode>()) {
+      EmitKernelCall(GetRef<GlobalVar>(gv), call->args, calls);
+    } else {
+      LOG(FATAL) << "AOT codegen only supports static-shape functions calling kernels, but gets "
+                 << value;
+    }
+  }
+
+  void EmitKernelCall(const GlobalVar& gv, const Array<Expr>& args, std::ostringstream* calls) {
+    const auto* prim_func = mod_->Lookup(gv).as<tir::PrimFuncNode>();
+    CHECK(prim_func != nullptr) << "AOT codegen only supports calls to PrimFuncs, but "
+                                << gv->name_hint << " is not a PrimFunc";
+    Optional<String> gsymbol = prim_func->GetAttr<String>(tvm::attr::kGlobalSymbol);
+    std::string symbol = gsymbol.defined() ? gsymbol.value() : gv->name_hint;
+    if (declared_kernels_.insert(symbol).second) {
+      kernel_decl_stream_ << "TVM_DLL int32_t " << symbol
+                          << "(TVMValue* args, int32_t* type_codes, int32_t num_args, "
+                             "TVMValue* out_ret_value, int32_t* out_ret_tcode, "
+                             "void* resource_handle);\n";
+    }
+    for (size_t i = 0; i < args.size(); ++i) {
+      std::string tensor;
+      if (const auto* constant = args[i].as<ConstantNode>()) {
+        tensor = EmitConstant(constant->data);
+      } else {
+        const auto* var = args[i].as<VarNode>();
+        CHECK(var != nullptr) << "AOT codegen expects the arguments of " << symbol
+                              << " to be tensors, but gets " << args[i];
+        tensor = LookupTensor(GetRef<Var>(var));
+      }
+      *calls << "  values[" << i << "].v_handle = " << tensor << ";\n"
+             << "  codes[" << i << "] = kTVMDLTensorHandle;\n";
+    }
+    *calls << "  if (" << symbol << "(values, codes, " << args.size()
+           << ", &rv, &rcode, NULL) != 0) goto fail;\n";
+    max_call_args_ = std::max(max_call_args_, args.size());
+  }
+
+  /*! \return The C expression of the DLTensor* bound to the var. */
+  std::string LookupTensor(const Var& var) const {
+    auto it = tensors_.find(var.get());
+    CHECK(it != tensors_.end()) << "AOT codegen expects " << var << " to be a tensor";
+    return it->second;
+  }
+
+  std::vector<int64_t> StaticShape(const Expr& expr) const {
+    const auto* shape = expr.as<ShapeExprNode>();
+    CHECK(shape != nullptr) << "AOT codegen only supports static shapes, but gets " << expr;
+    std::vector<int64_t> values;
+    for (const PrimExpr& value : shape->values) {
+      const auto* int_value = value.as<IntImmNode>();
+      CHECK(int_value != nullptr) << "AOT codegen only supports static shapes, but gets " << expr;
+      values.push_back(int_value->value);
+    }
+    return values;
+  }
+
+  /*! \return The name of a static int64_t array holding the shape. */
+  std::string EmitShape(const std::vector<int64_t>& shape) {
+    std::string name = func_name_ + "_shape" + std::to_string(num_statics_++);
+    statics_ << "static int64_t " << name << "[" << std::max<size_t>(shape.size(), 1) << "] = {";
+    for (size_t i = 0; i < shape.size(); ++i) {
+      statics_ << (i == 0 ? "" : ", ") << shape[i];
+    }
+    statics_ << (shape.empty() ? "0" : "") << "};\n";
+    return name;
+  }
+
+  /*! \return The C expression of a static DLTensor on the host with the given data. */
+  std::string EmitStaticTensor(const std::string& data, const std::vector<int64_t>& shape,
+                               DataType dtype) {
+    std::string shape_name = EmitShape(shape);
+    std::string name = func_name_ + "_t" + std::to_string(num_statics_++);
+    statics_ << "static DLTensor " << name << " = {(void*)(" << data << "), {kDLCPU, 0}, "
+             << shape.size() << ", {" << static_cast<int>(dtype.code()) << ", " << dtype.bits()
+             << ", " << dtype.lanes() << "}, " << shape_name << ", NULL, 0};\n";
+    return "&" + name;
+  }
+
+  /*! \return The C expression of a static DLTensor holding the constant. */
+  std::string EmitConstant(const runtime::NDArray& data) {
+    CHECK_EQ(data->device.device_type, kDLCPU) << "AOT codegen expects the constants on the host";
+    CHECK(data.IsContiguous()) << "AOT codegen expects the constants to be contiguous";
+    std::string name = func_name_ + "_const" + std::to_string(num_statics_++);
+    size_t size = runtime::GetDataSize(*data.operator->());
+    const uint8_t* bytes = static_cast<const uint8_t*>(data->data) + data->byte_offset;
+    statics_ << "static const TVM_AOT_ALIGNED uint8_t " << name << "[" << std::max<size_t>(size, 1)
+             << "] = {";
+    for (size_t i = 0; i < size; ++i) {
+      statics_ << (i % 16 == 0 ? "\n  " : " ") << "0x" << std::hex << std::setw(2)
+               << std::setfill('0') << static_cast<int>(bytes[i]) << std::dec << ",";
+    }
+    statics_ << (size == 0 ? "0" : "\n") << "};\n";
+    std::vector<int64_t> shape(data->shape, data->shape + data->ndim);
+    return EmitStaticTensor(name, shape, data.DataType());
+  }
+
+  /*! \brief The module to look up the kernels in. */
+  IRModule mod_;
+  /*! \brief The prefix of the emitted functions. */
+  String mod_name_;
+  /*! \brief The declarations of the called kernels. */
+  std::ostringstream kernel_decl_stream_;
+  /*! \brief The static data of the emitted functions. */
+  std::ostringstream decl_stream_;
+  /*! \brief The emitted functions. */
+  std::ostringstream code_stream_;
+  /*! \brief The kernels declared so far. */
+  std::unordered_set<std::string> declared_kernels_;
+  /*! \brief The maximum number of arguments of a kernel call. */
+  size_t max_call_args_{1};
+
+  // The state of the function being emitted.
+  /*! \brief The name of the emitted C function. */
+  std::string func_name_;
+  /*! \brief The static data of the function, emitted once its arena size is known. */
+  std::ostringstream statics_;
+  /*! \brief The number of static data of the function. */
+  int num_statics_{0};
+  /*! \brief The size of the static arena of the function in bytes. */
+  int64_t arena_bytes_{0};
+  /*! \brief Map from a var to the C expression of its DLTensor*. */
+  std::unordered_map<const VarNode*, std::string> tensors_;
+  /*! \brief The tensors allocated at run time. */
+  std::vector<std::string> runtime_allocs_;
+  /*! \brief Cache ops that need to be frequently used later to reduce lookup overhead. */
+  const Op& mem_alloc_storage_op_ = Op::Get("relax.memory.alloc_storage");
+  const Op& mem_alloc_tensor_op_ = Op::Get("relax.memory.alloc_tensor");
+  const Op& builtin_alloc_tensor_op_ = Op::Get("relax.builtin.alloc_tensor");
+};
+
+/*!
+ * \brief Emit the Relax functions of a module as a C source module calling the kernel library.
+ * \param mod The IRModule containing the Relax functions and the PrimFuncs they call.
+ * \param lib The kernel library, imported by the returned module.
+ * \param mod_name The name used in the prefix of the emitted functions.
+ * \return The C source module, to be exported with export_library.
+ */
+runtime::Module CodeGen(IRModule mod, runtime::Module lib, String mod_name) {
+  CodeGenAOT codegen(mod, mod_name);
+  Array<String> func_names;
+  for (const auto& kv : mod->functions) {
+    if (const auto* func = kv.second.as<FunctionNode>()) {
+      func_names.push_back(codegen.AddFunction(GetRef<Function>(func)));
+    }
+  }
+  runtime::Module source = codegen::CSourceModuleCreate(codegen.Finish(), "c", func_names);
+  source.Import(lib);
+  return source;
+}
+
+TVM_REGISTER_GLOBAL("relax.AOTCodeGen").set_body_typed(CodeGen);
+
+}  // namespace aot
+}  // namespace relax
+}  // namespace tvm
@@ -23,6 +23,11 @@
 #include <tvm/target/target.h>
 #include <tvm/tir/function.h>
 
+#include <memory>
+#include <unordered_map>
+
+#include "../../meta_schedule/module_equality.h"
+
 namespace tvm {
 namespace relax {
 namespace backend {
@@ -33,7 +38,9 @@ using tvm::meta_schedule::ExtractedTask;
  * \brief Extract the Meta-Schedule tuning task from a given IRModule.
  * \note
  *   1. The task extractor is responsible for task deduplication. The
- *   deduplication is achieved by comparing structural hashes of PrimFuncs.
+ *   deduplication is achieved by comparing the normalized PrimFuncs with
+ *   the given module equality, which is the one the database of the tuning
+ *   records is queried with.
  *   2. For a PrimFunc, the weight of its corresponding task is the number
  *   of times it called by op Call-TIR. Say in an IRModule there are three
  *   PrimFuncs `fn1`, `fn2` and `fn3` sharing the same structural hash.
@@ -41,23 +48,39 @@ using tvm::meta_schedule::ExtractedTask;
  *   `fn2` is called by 3 Call-TIR and `fn3` is called by 5 Call-TIR.
  *   Then we will have a ExtractedTask for all three functions, whose weight
  *   is 5 + 3 + 2 = 10.
+ *   3. The tasks of several IRModules, e.g. the models sharing a tuning
+ *   database, are extracted at once, so that a workload shared by the
+ *   modules is a single task weighted by its calls in all of them.
  */
 class TaskExtractor : public ExprVisitor {
  public:
-  static Array<ExtractedTask> ExtractTask(IRModule mod, Target target) {
-    TaskExtractor extractor(mod, target);
-    // We go through each Relax function in the module.
-    for (const auto& kv : mod->functions) {
-      if (const auto* func = kv.second.as<FunctionNode>()) {
-        extractor(GetRef<Function>(func));
+  static Array<ExtractedTask> ExtractTask(Array<IRModule> mods, Target target,
+                                          String mod_eq_name) {
+    std::unique_ptr<meta_schedule::ModuleEquality> mod_eq =
+        meta_schedule::ModuleEquality::Create(mod_eq_name);
+    Array<ExtractedTask> tasks;
+    TaskCache cache(/*bucket_count=*/0, meta_schedule::ModuleHash(*mod_eq),
+                    meta_schedule::ModuleEqual(*mod_eq));
+    for (const IRModule& mod : mods) {
+      TaskExtractor extractor(mod, target, &tasks, &cache);
+      // We go through each Relax function in the module.
+      for (const auto& kv : mod->functions) {
+        if (const auto* func = kv.second.as<FunctionNode>()) {
+          extractor(GetRef<Function>(func));
+        }
       }
     }
-    return std::move(extractor.tasks_);
+    return tasks;
   }
 
  private:
-  explicit TaskExtractor(IRModule mod, Target target)
-      : mod_(std::move(mod)), target_(std::move(target)) {
+  /*! \brief Map from the normalized module of a PrimFunc to its task. */
+  using TaskCache = std::unordered_map<IRModule, ExtractedTask, meta_schedule::ModuleHash,
+                                       meta_schedule::ModuleEqual>;
+
+  explicit TaskExtractor(IRModule mod, Target target, Array<ExtractedTask>* tasks,
+                         TaskCache* cache)
+      : mod_(std::move(mod)), target_(std::move(target)), tasks_(tasks), cache_(cache) {
     normalize_mod_func_ = runtime::Registry::Get("tvm.meta_schedule.normalize_mod");
     ICHECK(normalize_mod_func_) << "Normalization function is not found.";
   }
@@ -81,6 +104,7 @@ class TaskExtractor : public ExprVisitor {
     const GlobalVar& global_var = Downcast<GlobalVar>(call->args[0]);
     const tir::PrimFunc& func = Downcast<tir::PrimFunc>(mod_->Lookup(global_var));
 
+    // A PrimFunc called several times is normalized once.
     auto it = func2task_.find(func);
     if (it != func2task_.end()) {
       it->second->weight += 1;
@@ -88,25 +112,35 @@ class TaskExtractor : public ExprVisitor {
     }
 
     IRModule tir_mod = (*normalize_mod_func_)(func);
+    auto cache_it = cache_->find(tir_mod);
+    if (cache_it != cache_->end()) {
+      cache_it->second->weight += 1;
+      func2task_.emplace(func, cache_it->second);
+      return;
+    }
     ExtractedTask task(/*task_name=*/global_var->name_hint,  //
                        /*mod=*/tir_mod,                      //
                        /*target=*/target_,                   //
                        /*dispatched=*/{tir_mod},             //
                        /*weight=*/1);
-    tasks_.push_back(task);
+    tasks_->push_back(task);
+    cache_->emplace(tir_mod, task);
     func2task_.emplace(func, task);
   }
 
   IRModule mod_;
   Target target_;
-  Array<ExtractedTask> tasks_;
+  /*! \brief The tasks extracted from all the modules. */
+  Array<ExtractedTask>* tasks_;
+  /*! \brief The tasks of all the modules by normalized module. */
+  TaskCache* cache_;
   std::unordered_map<tir::PrimFunc, ExtractedTask, StructuralHash, StructuralEqual> func2task_;
   const runtime::PackedFunc* normalize_mod_func_;
 };
 
 TVM_REGISTER_GLOBAL("relax.backend.MetaScheduleExtractTask")
-    .set_body_typed([](IRModule mod, Target target) {
-      return TaskExtractor::ExtractTask(std::move(mod), std::move(target));
+    .set_body_typed([](Array<IRModule> mods, Target target, String mod_eq_name) {
+      return TaskExtractor::ExtractTask(std::move(mods), std::move(target), std::move(mod_eq_name));
     });
 
 }  // namespace backend
@@ -32,6 +32,7 @@
 #include <tvm/target/target.h>
 #include <tvm/tir/function.h>
 
+#include <algorithm>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -77,7 +78,8 @@ class CodeGenVM : public ExprFunctor<Instruction::Arg(const Expr&)> {
       param_names.push_back(param->name_hint());
     }
 
-    builder_->EmitFunction(gsymbol.value(), func_node->params.size(), param_names);
+    builder_->EmitFunction(gsymbol.value(), func_node->params.size(), param_names,
+                           ParamDeviceIndexes(func_node));
 
     for (Var param : func_node->params) {
       Instruction::Arg reg = this->VisitExpr(param);
@@ -89,6 +91,34 @@ class CodeGenVM : public ExprFunctor<Instruction::Arg(const Expr&)> {
     return ret;
   }
 
+  /*!
+   * \brief The device index of each param: the device the function moves the param to when all
+   *  of its uses are `relax.to_device` calls to the same device, and the first device otherwise.
+   */
+  Array<Integer> ParamDeviceIndexes(const FunctionNode* func_node) {
+    std::unordered_map<const VarNode*, size_t> num_uses;
+    std::unordered_map<const VarNode*, std::vector<int64_t>> moved_to;
+    PostOrderVisit(func_node->body, [&](const Expr& e) {
+      if (const auto* var = e.as<VarNode>()) {
+        ++num_uses[var];
+      } else if (const auto* call = e.as<CallNode>()) {
+        if (call->op == to_device_op_ && call->args[0]->IsInstance<VarNode>()) {
+          moved_to[call->args[0].as<VarNode>()].push_back(
+              call->attrs.as<ToDeviceAttrs>()->runtime_device_index);
+        }
+      }
+    });
+    Array<Integer> device_indexes;
+    for (const Var& param : func_node->params) {
+      const std::vector<int64_t>& devices = moved_to[param.get()];
+      bool moved = !devices.empty() && devices.size() == num_uses[param.get()] &&
+                   std::all_of(devices.begin(), devices.end(),
+                               [&](int64_t index) { return index == devices[0]; });
+      device_indexes.push_back(Integer(moved ? devices[0] : 0));
+    }
+    return device_indexes;
+  }
+
   Instruction::Arg VisitExpr_(const SeqExprNode* op) {
     for (auto block : op->blocks) {
       for (Binding binding : block->bindings) {
@@ -126,6 +156,10 @@ class CodeGenVM : public ExprFunctor<Instruction::Arg(const Expr&)> {
         return EmitAllocClosure(call);
       } else if (call_node->op == invoke_closure_op_) {
         return EmitInvokeClosure(call);
+      } else if (call_node->op == kill_storage_op_ || call_node->op == kill_tensor_op_) {
+        return EmitKillObject(call);
+      } else if (call_node->op == to_device_op_) {
+        return EmitToDevice(call);
       } else {
         // every "normal" operator is lowered to a global var in the IRModule. The Attrs for those
         // ops are handled in a pass when lowering them to TIR.
@@ -307,6 +341,42 @@ class CodeGenVM : public ExprFunctor<Instruction::Arg(const Expr&)> {
     return Instruction::Arg(Instruction::kRegister, dst_register);
   }
 
+  Instruction::Arg EmitToDevice(const Call& call_node) {
+    ICHECK_EQ(call_node->args.size(), 1);
+    auto to_device_attrs = call_node->attrs.as<ToDeviceAttrs>();
+    ICHECK(to_device_attrs != nullptr) << "must be ToDeviceAttrs";
+    Index runtime_device_index = to_device_attrs->runtime_device_index;
+    // A constant is placed on the device in the constant pool, and copied there only once.
+    if (const auto* constant = call_node->args[0].as<ConstantNode>()) {
+      TVMRetValue constant_data;
+      constant_data = constant->data;
+      Index index = builder_->EmitConstant(constant_data, runtime_device_index);
+      size_t dst_register = NewRegister();
+      std::vector<Instruction::Arg> args;
+      args.push_back(Instruction::Arg(Instruction::kConstIdx, index));
+      builder_->EmitCall("vm.builtin.copy", args, dst_register);
+      return Instruction::Arg(Instruction::kRegister, dst_register);
+    }
+    std::vector<Instruction::Arg> args;
+    args.push_back(Instruction::Arg(Instruction::kVMRegister));
+    args.push_back(ConvertArg(call_node->args[0]));
+    args.push_back(Instruction::Arg(Instruction::kImmediate, runtime_device_index));
+    size_t dst_register = NewRegister();
+    builder_->EmitCall("vm.builtin.to_device", args, dst_register);
+    return Instruction::Arg(Instruction::kRegister, dst_register);
+  }
+
+  Instruction::Arg EmitKillObject(const Call& call_node) {
+    ICHECK_EQ(call_node->args.size(), 1);
+    // Overwrite the register holding the killed object, so that the register file no longer
+    // keeps the underlying buffer alive.
+    Instruction::Arg arg = ConvertArg(call_node->args[0]);
+    ICHECK(arg.kind() == Instruction::kRegister)
+        << "kill_storage/kill_tensor expects a variable, but got " << call_node->args[0];
+    builder_->EmitCall("vm.builtin.null_value", {}, arg.value());
+    return arg;
+  }
+
   Instruction::Arg EmitShape(const Call& call_node) {
     // Handle args of the call
     std::vector<Instruction::Arg> args;
@@ -530,6 +600,9 @@ class CodeGenVM : public ExprFunctor<Instruction::Arg(const Expr&)> {
   const Op& assert_op_ = Op::Get("relax.assert_op");
   const Op& make_closure_op_ = Op::Get("relax.make_closure");
   const Op& invoke_closure_op_ = Op::Get("relax.invoke_closure");
+  const Op& kill_storage_op_ = Op::Get("relax.memory.kill_storage");
+  const Op& kill_tensor_op_ = Op::Get("relax.memory.kill_tensor");
+  const Op& to_device_op_ = Op::Get("relax.to_device");
 };
 
 void VMCodeGen::CodeGen(IRModule rx_mod) {
@@ -37,14 +37,16 @@ ExecBuilder ExecBuilderNode::Create() {
   return ret;
 }
 
-vm::Index ExecBuilderNode::EmitConstant(TVMRetValue obj) {
+vm::Index ExecBuilderNode::EmitConstant(TVMRetValue obj, vm::Index device_index) {
   vm::Index idx = exec->constants.size();
   exec->constants.push_back(obj);
+  exec->const_device_indexes.push_back(device_index);
   return vm::Instruction::Arg(vm::Instruction::kConstIdx, idx).data;
 }
 
 void ExecBuilderNode::EmitFunction(std::string func_name, int64_t num_inputs,
-                                   Array<String> param_names) {
+                                   Array<String> param_names,
+                                   Array<Integer> param_device_indexes) {
   const auto& m = exec->global_map;
   ICHECK(m.find(func_name) == m.end());
   VMFunction vmfunc;
@@ -56,6 +58,14 @@ void ExecBuilderNode::EmitFunction(std::string func_name, int64_t num_inputs,
     names.push_back(param_names[i]);
   }
   vmfunc.param_names = names;
+  if (param_device_indexes.empty()) {
+    vmfunc.param_device_indexes.assign(names.size(), 0);
+  } else {
+    ICHECK_EQ(param_device_indexes.size(), names.size());
+    for (const Integer& index : param_device_indexes) {
+      vmfunc.param_device_indexes.push_back(index->value);
+    }
+  }
   exec->global_map[func_name] = exec->global_funcs.size();
   exec->global_funcs.push_back(vmfunc);
 }
@@ -214,7 +224,8 @@ TVM_REGISTER_GLOBAL("relax.ExecBuilderEmitConstant").set_body([](TVMArgs args, T
   ExecBuilder builder = args[0];
   TVMRetValue rt;
   rt = args[1];
-  *ret = builder->EmitConstant(rt);
+  vm::Index device_index = args[2];
+  *ret = builder->EmitConstant(rt, device_index);
 });
 
 TVM_REGISTER_GLOBAL("relax.ExecBuilderFunction")
@@ -18,7 +18,8 @@
  */
 /*!
  * \file src/relax/backend/vm/vm_memory_lower.cc
- * \brief Perform memory lowering. Lowers the relax.builtin.alloc_tensor intrinsic to VM intrinsics.
+ * \brief Perform memory lowering. Lowers the relax.builtin.alloc_tensor intrinsic and the planned
+ * relax.memory.alloc_storage/alloc_tensor intrinsics to VM intrinsics.
  */
 #include <tvm/relax/attrs/memory.h>
 #include <tvm/relax/backend.h>
@@ -26,6 +27,8 @@
 #include <tvm/relax/type.h>
 #include <tvm/tir/op.h>
 
+#include <unordered_map>
+
 #include "../../../relay/transforms/pattern_utils.h"
 
 namespace tvm {
@@ -74,10 +77,13 @@ class VMMemLowerMutator : public ExprMutator {
     call = expr.as<CallNode>();
 
     static const Op& alloc_tensor_op = Op::Get("relax.builtin.alloc_tensor");
+    static const Op& mem_alloc_storage_op = Op::Get("relax.memory.alloc_storage");
+    static const Op& mem_alloc_tensor_op = Op::Get("relax.memory.alloc_tensor");
     static const Op& vm_alloc_storage_op = Op::Get("relax.vm.builtin.alloc_storage");
     static const Op& vm_alloc_tensor_op = Op::Get("relax.vm.builtin.alloc_tensor");
+    static const Op& mem_kill_tensor_op = Op::Get("relax.memory.kill_tensor");
+    static const Op& mem_kill_storage_op = Op::Get("relax.memory.kill_storage");
 
-    // TODO(@yuchen): memory planning
     if (call->op == alloc_tensor_op) {
       ShapeExpr output_shape = Downcast<ShapeExpr>(call->args[0]);
       auto alloc_attrs = call->attrs.as<AllocTensorAttrs>();
@@ -96,11 +102,54 @@ class VMMemLowerMutator : public ExprMutator {
       Expr shape = call->args[0];
       Var tensor =
           builder_->Emit(Call(vm_alloc_tensor_op, {storage, shape}, Attrs(tensor_attr)), "tensor");
+      tensor_storage_[tensor.get()] = storage;
       return std::move(tensor);
     }
 
+    // The storage created above for a tensor is only reachable from the tensor,
+    // release it together with the tensor.
+    if (call->op == mem_kill_tensor_op) {
+      auto it = tensor_storage_.find(LookupTensorVar(call->args[0]));
+      if (it != tensor_storage_.end()) {
+        builder_->Emit(GetRef<Call>(call), "_");
+        return Call(mem_kill_storage_op, {it->second});
+      }
+    }
+
+    // Storages and tensors planned by StaticPlanBlockMemory.
+    if (call->op == mem_alloc_storage_op) {
+      auto alloc_attrs = call->attrs.as<MemAllocStorageAttrs>();
+      ICHECK(alloc_attrs != nullptr) << "must be MemAllocStorageAttrs";
+      auto storage_attr = make_object<VMAllocStorageAttrs>();
+      storage_attr->dtype = alloc_attrs->dtype;
+      storage_attr->runtime_device_index = alloc_attrs->virtual_device_index;
+      return Call(vm_alloc_storage_op, call->args, Attrs(storage_attr));
+    }
+
+    if (call->op == mem_alloc_tensor_op) {
+      auto alloc_attrs = call->attrs.as<MemAllocTensorAttrs>();
+      ICHECK(alloc_attrs != nullptr) << "must be MemAllocTensorAttrs";
+      auto tensor_attr = make_object<VMAllocTensorAttrs>();
+      tensor_attr->offset = alloc_attrs->offset;
+      tensor_attr->dtype = alloc_attrs->dtype;
+      return Call(vm_alloc_tensor_op, call->args, Attrs(tensor_attr));
+    }
+
     return GetRef<Expr>(call);
   }
+
+  /*! \brief Follow the var-to-var bindings from \p expr to the var bound to the tensor. */
+  const VarNode* LookupTensorVar(Expr expr) {
+    while (const auto* var = expr.as<VarNode>()) {
+      Optional<Expr> value = builder_->LookupBinding(GetRef<Var>(var));
+      if (!value.defined() || !value.value()->IsInstance<VarNode>()) return var;
+      expr = value.value();
+    }
+    return nullptr;
+  }
+
+  /*! \brief Map from the tensors lowered from relax.builtin.alloc_tensor to their storage. */
+  std::unordered_map<const VarNode*, Var> tensor_storage_;
 };
 
 Expr VMMemLower(const Expr& e) { return VMMemLowerMutator().VisitExpr(e); }
@@ -30,6 +30,9 @@
 #include <tvm/tir/op.h>
 #include <tvm/tir/stmt_functor.h>
 
+#include <unordered_set>
+#include <vector>
+
 namespace tvm {
 namespace relax {
 
@@ -82,6 +85,37 @@ class PrimExprSlotCollector : public ExprVisitor, public StructInfoVisitor {
   Map<PrimExpr, Integer> slot_map_;
 };
 
+/*!
+ * \brief Collect the slots of the shapes used in a scope, leaving out the branches of the If
+ *  nodes and the functions nested in it, which are scopes of their own.
+ */
+class ScopeSlotCollector : public ExprVisitor {
+ public:
+  static std::unordered_set<int64_t> Collect(const Expr& scope,
+                                             const Map<PrimExpr, Integer>& expr2slot) {
+    ScopeSlotCollector collector(expr2slot);
+    collector.VisitExpr(scope);
+    return std::move(collector.slots_);
+  }
+
+ private:
+  explicit ScopeSlotCollector(const Map<PrimExpr, Integer>& expr2slot) : expr2slot_(expr2slot) {}
+
+  void VisitExpr_(const ShapeExprNode* op) final {
+    for (const PrimExpr& e : op->values) {
+      auto it = expr2slot_.find(e);
+      if (it != expr2slot_.end()) slots_.insert((*it).second->value);
+    }
+  }
+
+  void VisitExpr_(const IfNode* op) final { this->VisitExpr(op->cond); }
+
+  void VisitExpr_(const FunctionNode* op) final {}
+
+  const Map<PrimExpr, Integer>& expr2slot_;
+  std::unordered_set<int64_t> slots_;
+};
+
 class VMShapeLowerMutator : public ExprMutator {
  public:
   static DataType ShapeDType() { return DataType::Int(64); }
@@ -95,6 +129,11 @@ class VMShapeLowerMutator : public ExprMutator {
         // prepare mapping and heap var
         expr2slot_ = PrimExprSlotCollector::Collect(Downcast<Function>(func));
         heap_size_ = IntImm(ShapeDType(), expr2slot_.size());
+        slot2expr_.assign(expr2slot_.size(), PrimExpr());
+        for (const auto& kv : expr2slot_) {
+          slot2expr_[kv.second->value] = kv.first;
+        }
+        available_slots_.clear();
         shape_heap_ = Var("shape_heap", TensorStructInfo(ShapeExpr({heap_size_}), ShapeDType()));
 
         // mutate
@@ -128,10 +167,30 @@ class VMShapeLowerMutator : public ExprMutator {
     if (IsConstantShape(GetRef<ShapeExpr>(node))) {
       return ExprMutator::VisitExpr_(node);
     }
-    tir::PrimFunc func = CalculateShape(GetRef<ShapeExpr>(node));
-
-    GlobalVar shape_func_var = builder_->AddFunction(func, "shape_func");
-    builder_->Emit(Call(shape_func_var, {shape_heap_}), "_");
+    // The values of the shape which are neither on the heap nor plain vars are computed, along
+    // with the other slots used in the same scope that can be computed from the vars already on
+    // the heap. This way a single shape function fills the heap for the following shapes of the
+    // scope, which only load it, while the slots only used in a branch are left to the branch.
+    Array<PrimExpr> to_compute;
+    for (const PrimExpr& e : node->values) {
+      if (!IsAvailable(e) && !e->IsInstance<tir::VarNode>()) {
+        to_compute.push_back(e);
+        available_slots_.insert(expr2slot_.at(e)->value);
+      }
+    }
+    if (!to_compute.empty()) {
+      for (size_t slot = 0; slot < slot2expr_.size(); ++slot) {
+        const PrimExpr& e = slot2expr_[slot];
+        if (!scope_slots_.count(slot)) continue;
+        if (!IsAvailable(e) && !e->IsInstance<tir::VarNode>() && IsComputable(e)) {
+          to_compute.push_back(e);
+          available_slots_.insert(expr2slot_.at(e)->value);
+        }
+      }
+      tir::PrimFunc func = CalculateShape(to_compute);
+      GlobalVar shape_func_var = builder_->AddFunction(func, "shape_func");
+      builder_->Emit(Call(shape_func_var, {shape_heap_}), "_");
+    }
 
     // construct shape
     Array<Integer> indices;
@@ -162,7 +221,11 @@ class VMShapeLowerMutator : public ExprMutator {
         }
       }
     }
+    std::unordered_set<int64_t> scope_slots =
+        ScopeSlotCollector::Collect(node->body, expr2slot_);
+    std::swap(scope_slots, scope_slots_);
     Expr new_body = this->VisitExpr(node->body);
+    std::swap(scope_slots, scope_slots_);
 
     Array<BindingBlock> blocks;
 
@@ -190,7 +253,46 @@ class VMShapeLowerMutator : public ExprMutator {
     return builder_->Normalize(Function(node->params, new_body, ret_struct_info, node->attrs));
   }
 
-  tir::PrimFunc CalculateShape(ShapeExpr s) {
+  Expr VisitExpr_(const IfNode* op) override {
+    // The slots filled in a branch are not available after it, nor in the other branch.
+    // Each branch only batches the slots it uses itself.
+    std::unordered_set<int64_t> available_slots = available_slots_;
+    std::unordered_set<int64_t> scope_slots = scope_slots_;
+    Expr guard = this->VisitExpr(op->cond);
+    scope_slots_ = ScopeSlotCollector::Collect(op->true_branch, expr2slot_);
+    Expr true_b = this->VisitWithNewScope(op->true_branch);
+    available_slots_ = available_slots;
+    scope_slots_ = ScopeSlotCollector::Collect(op->false_branch, expr2slot_);
+    Expr false_b = this->VisitWithNewScope(op->false_branch);
+    available_slots_ = available_slots;
+    scope_slots_ = std::move(scope_slots);
+    if (op->cond.same_as(guard) && op->true_branch.same_as(true_b) &&
+        op->false_branch.same_as(false_b)) {
+      return GetRef<Expr>(op);
+    }
+    return If(guard, true_b, false_b, op->span);
+  }
+
+  /*! \brief Whether the slot of the expression already holds its value. */
+  bool IsAvailable(const PrimExpr& expr) const {
+    if (expr->IsInstance<IntImmNode>() && !expr2slot_.count(expr)) return true;
+    return available_slots_.count(expr2slot_.at(expr)->value);
+  }
+
+  /*! \brief Whether the expression can be computed from the slots already holding a value. */
+  bool IsComputable(const PrimExpr& expr) const {
+    bool computable = true;
+    tir::PostOrderVisit(expr, [&](const ObjectRef& e) {
+      if (const auto* var = e.as<tir::VarNode>()) {
+        auto it = expr2slot_.find(GetRef<tir::Var>(var));
+        computable = computable && it != expr2slot_.end() &&
+                     available_slots_.count((*it).second->value);
+      }
+    });
+    return computable;
+  }
+
+  tir::PrimFunc CalculateShape(const Array<PrimExpr>& values) {
     // TODO(ziheng): avoid generating shape func for known value
     tir::Var heap("heap", DataType::Handle());
     Array<PrimExpr> buffer_shape{heap_size_};
@@ -199,7 +301,7 @@ class VMShapeLowerMutator : public ExprMutator {
     buffer_map.Set(heap, buffer);
 
     Array<tir::Stmt> seq;
-    for (PrimExpr e : s->values) {
+    for (PrimExpr e : values) {
       Map<tir::Var, PrimExpr> var_mapping = BuildVarMapping(e, buffer);
       PrimExpr value = tir::Substitute(e, var_mapping);
       // cast value to shape heap dtype
@@ -237,6 +339,7 @@ class VMShapeLowerMutator : public ExprMutator {
       auto it = expr2slot_.find(pattern[i]);
       ICHECK(it != expr2slot_.end()) << "PrimExpr pattern " << pattern[i] << " is not in expr2slot";
       indices.push_back((*it).second);
+      available_slots_.insert((*it).second->value);
     }
     store_shape_attr->indices = indices;
     builder_->Emit(Call(store_shape_op, {shape, shape_heap_}, Attrs(store_shape_attr)), "gv");
@@ -256,6 +359,12 @@ class VMShapeLowerMutator : public ExprMutator {
   IntImm heap_size_;
   Var shape_heap_;
   Map<PrimExpr, Integer> expr2slot_;
+  /*! \brief The expression of each slot of the shape heap. */
+  std::vector<PrimExpr> slot2expr_;
+  /*! \brief The slots of the shape heap holding their value at the current binding. */
+  std::unordered_set<int64_t> available_slots_;
+  /*! \brief The slots of the shapes used in the current scope, out of its nested branches. */
+  std::unordered_set<int64_t> scope_slots_;
 };
 
 namespace transform {
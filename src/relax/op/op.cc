@@ -29,6 +29,7 @@ namespace tvm {
 namespace relax {
 
 TVM_REGISTER_NODE_TYPE(AllocTensorAttrs);
+TVM_REGISTER_NODE_TYPE(ToDeviceAttrs);
 TVM_REGISTER_NODE_TYPE(MemAllocStorageAttrs);
 TVM_REGISTER_NODE_TYPE(MemAllocTensorAttrs);
 TVM_REGISTER_NODE_TYPE(VMAllocStorageAttrs);
@@ -264,6 +265,34 @@ Expr MakeAllocTensor(Expr shape, DataType dtype, int64_t runtime_device_index) {
 
 TVM_REGISTER_GLOBAL("relax.op.builtin.alloc_tensor").set_body_typed(MakeAllocTensor);
 
+// to_device
+
+StructInfo InferStructInfoToDevice(const Call& call, const BlockBuilder& ctx) {
+  if (call->args.size() != 1) {
+    ctx->ReportFatal(Diagnostic::Error(call) << "to_device expects exactly one argument");
+  }
+  if (!call->args[0]->struct_info_.as<TensorStructInfoNode>()) {
+    ctx->ReportFatal(Diagnostic::Error(call)
+                     << "to_device expects a tensor, but got " << call->args[0]->struct_info_);
+  }
+  return GetStructInfo(call->args[0]);
+}
+
+RELAY_REGISTER_OP("relax.to_device")
+    .set_attrs_type<ToDeviceAttrs>()
+    .set_num_inputs(1)
+    .add_argument("data", "Expr", "The tensor to copy.")
+    .set_attr<FInferStructInfo>("FInferStructInfo", InferStructInfoToDevice);
+
+Expr MakeToDevice(Expr data, int64_t runtime_device_index) {
+  auto attrs = make_object<ToDeviceAttrs>();
+  attrs->runtime_device_index = runtime_device_index;
+  static const Op& op = Op::Get("relax.to_device");
+  return Call(op, {data}, Attrs(attrs), {});
+}
+
+TVM_REGISTER_GLOBAL("relax.op.to_device").set_body_typed(MakeToDevice);
+
 // memory planning alloc_storage
 
 RELAY_REGISTER_OP("relax.memory.alloc_storage")
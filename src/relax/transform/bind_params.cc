@@ -24,8 +24,12 @@
 #include <tvm/relax/expr_functor.h>
 #include <tvm/relax/transform.h>
 #include <tvm/relax/type.h>
+#include <tvm/tir/function.h>
 #include <tvm/tir/op.h>
 
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 namespace tvm {
@@ -98,6 +102,132 @@ IRModule BindParam(IRModule m, String func_name, Map<String, runtime::NDArray> p
   return GetRef<IRModule>(new_module);
 }
 
+/*! \brief Collect the constants of an expression. */
+class ConstantCollector : public ExprVisitor {
+ public:
+  static std::unordered_set<const ConstantNode*> Collect(const Expr& expr) {
+    ConstantCollector collector;
+    collector.VisitExpr(expr);
+    return std::move(collector.constants_);
+  }
+
+ private:
+  void VisitExpr_(const ConstantNode* op) final { constants_.insert(op); }
+
+  std::unordered_set<const ConstantNode*> constants_;
+};
+
+/*!
+ * \brief Lift the constants of a function, except the given ones, into new params appended to
+ *  the params of the function. Each param is named after the var the constant is bound to, or
+ *  the param it was bound from, so that the names are stable across checkpoints.
+ */
+class ConstantLifter : public ExprMutator {
+ public:
+  static std::pair<Function, Map<String, runtime::NDArray>> Lift(
+      const Function& func, const std::unordered_set<const ConstantNode*>& kept,
+      const Map<String, runtime::NDArray>& params) {
+    ConstantLifter lifter(kept);
+    for (const auto& kv : params) {
+      lifter.param_names_[kv.second.get()] = kv.first;
+    }
+    for (const Var& param : func->params) {
+      lifter.used_names_.insert(param->name_hint());
+    }
+    Function lifted = Downcast<Function>(lifter.VisitExpr(func));
+    if (lifter.new_params_.empty()) return {func, {}};
+    Array<Var> new_params = func->params;
+    new_params.insert(new_params.end(), lifter.new_params_.begin(), lifter.new_params_.end());
+    return {Function(new_params, lifted->body, lifted->ret_struct_info, lifted->attrs),
+            lifter.lifted_};
+  }
+
+ private:
+  explicit ConstantLifter(const std::unordered_set<const ConstantNode*>& kept) : kept_(kept) {}
+
+  using ExprMutator::VisitExpr_;
+
+  void VisitBinding_(const VarBindingNode* binding, const ConstantNode* constant) final {
+    // Name the param after the first var the constant is bound to.
+    if (!kept_.count(constant)) {
+      hints_.emplace(constant, binding->var->name_hint());
+    }
+    ExprMutator::VisitBinding_(binding, constant);
+  }
+
+  Expr VisitExpr_(const ConstantNode* op) final {
+    if (kept_.count(op)) return GetRef<Expr>(op);
+    auto it = lifted_vars_.find(op);
+    if (it != lifted_vars_.end()) return it->second;
+
+    std::string name;
+    auto param_it = param_names_.find(op->data.get());
+    if (param_it != param_names_.end()) {
+      name = param_it->second;
+    } else if (hints_.count(op)) {
+      name = hints_.at(op);
+    } else {
+      name = "param";
+    }
+    std::string unique_name = name;
+    for (int i = 1; used_names_.count(unique_name); ++i) {
+      unique_name = name + "_" + std::to_string(i);
+    }
+    used_names_.insert(unique_name);
+
+    Var var(unique_name, GetStructInfo(GetRef<Constant>(op)));
+    lifted_vars_[op] = var;
+    new_params_.push_back(var);
+    lifted_.Set(unique_name, op->data);
+    return std::move(var);
+  }
+
+  /*! \brief The constants which are not lifted. */
+  const std::unordered_set<const ConstantNode*>& kept_;
+  /*! \brief Map from the bound param arrays to their name. */
+  std::unordered_map<const Object*, std::string> param_names_;
+  /*! \brief Map from a constant to the name of the var it is bound to. */
+  std::unordered_map<const ConstantNode*, std::string> hints_;
+  /*! \brief The names of the params of the function. */
+  std::unordered_set<std::string> used_names_;
+  /*! \brief Map from the lifted constants to their param. */
+  std::unordered_map<const ConstantNode*, Var> lifted_vars_;
+  /*! \brief The new params, in their order. */
+  Array<Var> new_params_;
+  /*! \brief The lifted constants by param name. */
+  Map<String, runtime::NDArray> lifted_;
+};
+
+/*!
+ * \brief Pre-pack the params of a function: bind them, fold the computations that only depend on
+ *  them (e.g. the layout transforms of the weights), and lift the resulting constants back into
+ *  params of the function.
+ * \param mod The module
+ * \param func_name The name of the function
+ * \param params The param dict
+ * \return The module and the dict of the pre-packed params, to be bound by name at run time.
+ */
+Array<ObjectRef> PrepackParams(IRModule mod, String func_name,
+                               Map<String, runtime::NDArray> params) {
+  GlobalVar gv = mod->GetGlobalVar(func_name);
+  Function func = Downcast<Function>(mod->Lookup(gv));
+  std::unordered_set<const ConstantNode*> kept = ConstantCollector::Collect(func);
+
+  IRModule bound = BindParam(mod, func_name, params);
+  // Only fold the function, in a module holding it and the PrimFuncs it may call, so that the
+  // other functions of the module are left as they are.
+  IRModule scope(Map<GlobalVar, BaseFunc>{{gv, bound->Lookup(gv)}});
+  for (const auto& kv : bound->functions) {
+    if (kv.second->IsInstance<tir::PrimFuncNode>()) {
+      scope->Add(kv.first, kv.second);
+    }
+  }
+  Function folded = Downcast<Function>(transform::FoldConstant()(scope)->Lookup(gv));
+  auto lifted = ConstantLifter::Lift(folded, kept, params);
+  bound.CopyOnWrite()->Update(gv, lifted.first);
+  return {bound, lifted.second};
+}
+
 namespace transform {
 
 Pass BindParams(String func_name, Map<String, runtime::NDArray> params) {
@@ -108,6 +238,8 @@ Pass BindParams(String func_name, Map<String, runtime::NDArray> params) {
 
 TVM_REGISTER_GLOBAL("relax.transform.BindParams").set_body_typed(BindParams);
 
+TVM_REGISTER_GLOBAL("relax.transform.PrepackParams").set_body_typed(PrepackParams);
+
 }  // namespace transform
 
 }  // namespace relax
@@ -27,6 +27,8 @@
 #include <tvm/relax/type.h>
 #include <tvm/tir/op.h>
 
+#include <unordered_map>
+
 #include "../../relay/transforms/pattern_utils.h"
 
 namespace tvm {
@@ -40,11 +42,33 @@ namespace relax {
 // -->
 // gv0 = rx.call("relax.builtin.alloc_tensor", [n, m], dtype="float32")
 // rx.call_packed(func, x, gv0)
+//
+// The outputs are allocated on the device of the first input of the call, which is the device
+// given by relax.to_device for a tensor copied to a device, and device 0 otherwise.
 
 class CallTIRMutator : public ExprMutator {
  public:
+  using ExprMutator::VisitBinding_;
   using ExprMutator::VisitExpr_;
+
+  void VisitBinding_(const VarBindingNode* binding) override {
+    int64_t device_index = DeviceIndexOf(binding->value);
+    if (device_index != 0) {
+      var_device_index_[binding->var.get()] = device_index;
+    }
+    ExprMutator::VisitBinding_(binding);
+  }
+
+  void VisitBinding_(const MatchCastNode* binding) override {
+    int64_t device_index = DeviceIndexOf(binding->value);
+    if (device_index != 0) {
+      var_device_index_[binding->var.get()] = device_index;
+    }
+    ExprMutator::VisitBinding_(binding);
+  }
+
   Expr VisitExpr_(const CallNode* call) override {
+    int64_t device_index = DeviceIndexOf(GetRef<Call>(call));
     // post-order mutation
     Expr expr = VisitExprPostOrder_(call);
     call = expr.as<CallNode>();
@@ -62,7 +86,7 @@ class CallTIRMutator : public ExprMutator {
             << "the TensorStructInfo shape of call_tir has not populated";
         auto alloc_tensor_attr = make_object<AllocTensorAttrs>();
         alloc_tensor_attr->dtype = tensor_sinfo->dtype;
-        alloc_tensor_attr->runtime_device_index = 0;
+        alloc_tensor_attr->runtime_device_index = device_index;
         outs.push_back(builder_->Emit(Call(alloc_tensor_op,                                     //
                                            {Downcast<ShapeExpr>(tensor_sinfo->shape.value())},  //
                                            Attrs(alloc_tensor_attr)),
@@ -82,7 +106,7 @@ class CallTIRMutator : public ExprMutator {
               << " as an element of TupleStructInfo";
           auto alloc_tensor_attr = make_object<AllocTensorAttrs>();
           alloc_tensor_attr->dtype = field_tensor->dtype;
-          alloc_tensor_attr->runtime_device_index = 0;
+          alloc_tensor_attr->runtime_device_index = device_index;
           outs.push_back(builder_->Emit(
               Call(alloc_tensor_op, {Downcast<ShapeExpr>(field_tensor->shape.value())},
                    Attrs(alloc_tensor_attr)),
@@ -120,6 +144,31 @@ class CallTIRMutator : public ExprMutator {
 
     return GetRef<Expr>(call);
   }
+
+ private:
+  /*! \brief The runtime device index of the value of an expression. */
+  int64_t DeviceIndexOf(const Expr& expr) const {
+    static const Op& call_tir_op = Op::Get("relax.call_tir");
+    static const Op& to_device_op = Op::Get("relax.to_device");
+    if (const auto* var = expr.as<VarNode>()) {
+      auto it = var_device_index_.find(var);
+      return it != var_device_index_.end() ? it->second : 0;
+    } else if (const auto* tuple = expr.as<TupleNode>()) {
+      return tuple->fields.empty() ? 0 : DeviceIndexOf(tuple->fields[0]);
+    } else if (const auto* get_item = expr.as<TupleGetItemNode>()) {
+      return DeviceIndexOf(get_item->tuple);
+    } else if (const auto* call = expr.as<CallNode>()) {
+      if (call->op == to_device_op) {
+        return call->attrs.as<ToDeviceAttrs>()->runtime_device_index;
+      } else if (call->op == call_tir_op) {
+        return DeviceIndexOf(call->args[1]);
+      }
+    }
+    return 0;
+  }
+
+  /*! \brief The runtime device index of the vars not on device 0. */
+  std::unordered_map<const VarNode*, int64_t> var_device_index_;
 };
 
 Expr CallTIRRewrite(const Expr& e) { return CallTIRMutator().VisitExpr(e); }
@@ -23,17 +23,110 @@
 #include <tvm/relax/expr_functor.h>
 #include <tvm/relax/transform.h>
 #include <tvm/relax/type.h>
+#include <tvm/support/parallel_for.h>
 #include <tvm/tir/function.h>
 #include <tvm/tir/op.h>
 
+#include <unordered_set>
+#include <vector>
+
 namespace tvm {
 namespace relax {
 
+TVM_REGISTER_PASS_CONFIG_OPTION("relax.FoldConstant.max_size_ratio", Integer);
+TVM_REGISTER_PASS_CONFIG_OPTION("relax.FoldConstant.num_threads", Integer);
+
+/*!
+ * \brief Collect the PrimFuncs which may be folded, i.e. those called through call_tir on
+ *  arguments that are constants or results of other such calls.
+ */
+class FoldCandidateCollector : public ExprVisitor {
+ public:
+  static Array<tir::PrimFunc> Collect(const IRModule& mod) {
+    FoldCandidateCollector collector(mod);
+    for (const auto& kv : mod->functions) {
+      if (kv.second->IsInstance<FunctionNode>()) {
+        collector.VisitExpr(kv.second);
+      }
+    }
+    return collector.candidates_;
+  }
+
+ private:
+  explicit FoldCandidateCollector(IRModule mod) : mod_(mod) {}
+
+  void VisitBinding_(const VarBindingNode* binding) final {
+    ExprVisitor::VisitBinding_(binding);
+    if (binding->value->IsInstance<ConstantNode>()) {
+      maybe_const_vars_.insert(binding->var.get());
+      return;
+    }
+    const auto* call = binding->value.as<CallNode>();
+    if (call == nullptr || !call->op.same_as(call_tir_op_) || call->args.size() < 3) return;
+    const auto* gv = call->args[0].as<GlobalVarNode>();
+    const auto* tuple = call->args[1].as<TupleNode>();
+    if (gv == nullptr || tuple == nullptr || !call->args[2]->IsInstance<ShapeExprNode>()) return;
+    for (const Expr& arg : tuple->fields) {
+      if (!arg->IsInstance<ConstantNode>() && !maybe_const_vars_.count(arg.as<VarNode>())) return;
+    }
+    if (const auto* func = mod_->functions.Get(GetRef<GlobalVar>(gv)).as<tir::PrimFuncNode>()) {
+      candidates_.push_back(GetRef<tir::PrimFunc>(func));
+      maybe_const_vars_.insert(binding->var.get());
+    }
+  }
+
+  /*! \brief The module to look up the PrimFuncs in. */
+  IRModule mod_;
+  /*! \brief The vars which are constants, or may become constants once folded. */
+  std::unordered_set<const VarNode*> maybe_const_vars_;
+  /*! \brief The PrimFuncs which may be folded. */
+  Array<tir::PrimFunc> candidates_;
+  /*! \brief Cache ops that need to be frequently used later to reduce lookup overhead. */
+  const Op& call_tir_op_ = Op::Get("relax.call_tir");
+};
+
 class ConstantFolder : public ExprMutator {
  public:
-  explicit ConstantFolder(IRModule ctx_module) : ctx_module_(ctx_module) {}
+  /*!
+   * \brief Fold the constant expressions of all the Relax functions of a module. A kernel is
+   *  built once for all the structurally equal PrimFuncs of the module.
+   * \param max_size_ratio Skip the folds whose output is larger than this many times the size
+   *  of their inputs, or 0 to fold regardless of the size.
+   * \param num_threads The number of threads building the kernels ahead of folding, or 1 to
+   *  build each kernel when it is first needed.
+   */
+  static IRModule Fold(IRModule mod, int64_t max_size_ratio, int num_threads) {
+    ConstantFolder folder(mod, max_size_ratio);
+    if (num_threads > 1) {
+      folder.BuildInParallel(FoldCandidateCollector::Collect(mod), num_threads);
+    }
+    Map<GlobalVar, Function> updates;
+    for (const auto& kv : mod->functions) {
+      if (const auto* func = kv.second.as<FunctionNode>()) {
+        Function new_func = Downcast<Function>(folder(GetRef<Function>(func)));
+        if (!new_func.same_as(kv.second)) {
+          updates.Set(kv.first, new_func);
+        }
+      }
+    }
+    if (updates.empty()) return mod;
+    IRModuleNode* new_mod = mod.CopyOnWrite();
+    for (const auto& kv : updates) {
+      new_mod->Update(kv.first, kv.second);
+    }
+    return mod;
+  }
 
  private:
+  ConstantFolder(IRModule ctx_module, int64_t max_size_ratio)
+      : ctx_module_(ctx_module), max_size_ratio_(max_size_ratio) {}
+
+  /*!
+   * \brief Outputs up to this size are always folded, as they cannot grow the module much
+   *  whatever the size of the inputs.
+   */
+  static constexpr const int64_t kMaxAlwaysFoldedBytes = 4096;
+
   /*!
    * \brief Pattern match expr to a constant shape and get runtime shape tuple from it.
    * \return The runtime shape tuple, or nullopt if it is not a constant shape.
@@ -85,14 +178,56 @@ class ConstantFolder : public ExprMutator {
    * \return The cached func, nullopt if func cannot be built.
    */
   Optional<PackedFunc> GetCachedBuild(tir::PrimFunc func) {
-    // TODO(tvm-team): consider another way of bulk extract and build PrimFunc once
-    // would be helpful for future cases where PrimFunc recursively call into each other
-    Target eval_cpu_target{"llvm"};
-
+    func = CacheKey(func);
     auto it = func_build_cache_.find(func);
     if (it != func_build_cache_.end()) {
       return it->second;
     }
+    Optional<PackedFunc> build_func = Build(func);
+    func_build_cache_[func] = build_func;
+    return build_func;
+  }
+
+  /*!
+   * \brief The key of a PrimFunc in the build cache. The global symbol is dropped, so that the
+   *  copies of a PrimFunc under different names share their kernel.
+   */
+  static tir::PrimFunc CacheKey(tir::PrimFunc func) {
+    return WithoutAttr(std::move(func), tvm::attr::kGlobalSymbol);
+  }
+
+  /*!
+   * \brief Build the kernels of the given PrimFuncs ahead of folding, on several threads.
+   */
+  void BuildInParallel(const Array<tir::PrimFunc>& funcs, int num_threads) {
+    std::vector<tir::PrimFunc> to_build;
+    for (const tir::PrimFunc& func : funcs) {
+      tir::PrimFunc key = CacheKey(func);
+      if (func_build_cache_.emplace(key, NullOpt).second) {
+        to_build.push_back(key);
+      }
+    }
+    std::vector<Optional<PackedFunc>> built(to_build.size());
+    // The pass context is thread local, so each worker enters the one of the pass.
+    transform::PassContext pass_ctx = transform::PassContext::Current();
+    support::parallel_for_dynamic(0, to_build.size(), num_threads,
+                                  [&](int thread_id, int task_id) {
+                                    With<transform::PassContext> scope(pass_ctx);
+                                    built[task_id] = Build(to_build[task_id]);
+                                  });
+    for (size_t i = 0; i < to_build.size(); ++i) {
+      func_build_cache_[to_build[i]] = built[i];
+    }
+  }
+
+  /*!
+   * \brief Build a PrimFunc for the CPU.
+   * \return The built function, nullopt if func cannot be built.
+   */
+  static Optional<PackedFunc> Build(tir::PrimFunc func) {
+    // TODO(tvm-team): consider another way of bulk extract and build PrimFunc once
+    // would be helpful for future cases where PrimFunc recursively call into each other
+    Target eval_cpu_target{"llvm"};
     Optional<PackedFunc> build_func = NullOpt;
 
     try {
@@ -107,14 +242,32 @@ class ConstantFolder : public ExprMutator {
       // build failure may happen in which case we skip
       DLOG(WARNING) << "Build failure for function " << func << ", Error message: " << err.what();
     }
-    func_build_cache_[func] = build_func;
     return build_func;
   }
 
+  /*!
+   * \brief Check whether folding would grow the module too much, e.g. a broadcast of a weight.
+   */
+  bool IsTooLarge(const Array<runtime::NDArray>& arr_args, runtime::ShapeTuple shape,
+                  DataType ret_type) const {
+    if (max_size_ratio_ <= 0) return false;
+    int64_t output_bytes = (ret_type.bits() * ret_type.lanes() + 7) / 8;
+    for (int64_t dim : shape) {
+      output_bytes *= dim;
+    }
+    if (output_bytes <= kMaxAlwaysFoldedBytes) return false;
+    int64_t input_bytes = 0;
+    for (const runtime::NDArray& arg : arr_args) {
+      input_bytes += static_cast<int64_t>(runtime::GetDataSize(*arg.operator->()));
+    }
+    return output_bytes > input_bytes * max_size_ratio_;
+  }
+
   // Try constant evaluate the function call
   // if failed return NullOpt
   Optional<Expr> ConstEvaluateCallTIR(tir::PrimFunc tir_func, Array<runtime::NDArray> arr_args,
                                       runtime::ShapeTuple shape, DataType ret_type) {
+    if (IsTooLarge(arr_args, shape, ret_type)) return NullOpt;
     // obtain function from the cache.
     Optional<PackedFunc> func = GetCachedBuild(tir_func);
     if (!func) return NullOpt;
@@ -196,6 +349,8 @@ class ConstantFolder : public ExprMutator {
 
   // the context module to lookup functions
   IRModule ctx_module_;
+  // the maximum ratio of the output size to the input size of a fold, 0 if unlimited
+  int64_t max_size_ratio_;
   // cache for function build, via structural equality
   std::unordered_map<tir::PrimFunc, Optional<runtime::PackedFunc>, StructuralHash, StructuralEqual>
       func_build_cache_;
@@ -204,12 +359,14 @@ class ConstantFolder : public ExprMutator {
 namespace transform {
 
 Pass FoldConstant() {
-  runtime::TypedPackedFunc<Function(Function, IRModule, PassContext)> pass_func =
-      [=](Function f, IRModule m, PassContext pc) {
-        ConstantFolder folder(m);
-        return Downcast<Function>(folder(f));
+  runtime::TypedPackedFunc<IRModule(IRModule, PassContext)> pass_func =  //
+      [=](IRModule m, PassContext pc) {
+        auto max_size_ratio = pc->GetConfig("relax.FoldConstant.max_size_ratio", Integer(0));
+        auto num_threads = pc->GetConfig("relax.FoldConstant.num_threads", Integer(1));
+        return ConstantFolder::Fold(m, max_size_ratio.value().IntValue(),
+                                    num_threads.value().IntValue());
       };
-  return CreateFunctionPass(pass_func, 0, "FoldConstant", {});
+  return CreateModulePass(pass_func, 0, "FoldConstant", {});
 }
 
 TVM_REGISTER_GLOBAL("relax.transform.FoldConstant").set_body_typed(FoldConstant);
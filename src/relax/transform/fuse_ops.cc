@@ -27,11 +27,14 @@
  * A follow-up pass named "FuseTIR" will generate a TIR PrimFunc for each grouped function.
  */
 
+#include <tvm/relax/analysis.h>
 #include <tvm/relax/expr_functor.h>
 #include <tvm/relax/struct_info.h>
 #include <tvm/relax/transform.h>
 #include <tvm/tir/function.h>
 
+#include <algorithm>
+
 #include "../../relay/analysis/graph_partitioner.h"
 #include "../../support/arena.h"
 
@@ -86,6 +89,7 @@ using support::LinkNode;
 constexpr uint32_t kMaxFusedOps = 256;
 
 TVM_REGISTER_PASS_CONFIG_OPTION("relax.FuseOps.max_depth", Integer);
+TVM_REGISTER_PASS_CONFIG_OPTION("relax.FuseOps.fuse_reduction_epilogue", Bool);
 
 class GraphCreator : public ExprVisitor {
  public:
@@ -97,11 +101,15 @@ class GraphCreator : public ExprVisitor {
    * \return The created IndexedForwardGraph
    */
   static IndexedForwardGraph Create(IRModule mod, support::Arena* arena) {
-    // Since cross-function call is not supported yet, FuseOps only serves the entry function, whose
-    // name is "main".
-    auto relax_func = Downcast<Function>(mod->Lookup("main"));
+    // The graph covers every Relax function of the module, including the functions nested in
+    // other functions and the branches of control flow. The bindings of different functions
+    // and blocks are never connected, so they are never fused together.
     GraphCreator creator(mod, arena);
-    creator(relax_func);
+    for (const auto& kv : mod->functions) {
+      const auto* func = kv.second.as<FunctionNode>();
+      if (func == nullptr || func->HasNonzeroAttr(attr::kPrimitive)) continue;
+      creator(GetRef<Function>(func));
+    }
 
     // The algorithm of the graph creator ensures that each created node will be added to the
     // post-dfs order and will be set its op pattern. Thus we check whether all these containers
@@ -132,8 +140,27 @@ class GraphCreator : public ExprVisitor {
   void VisitBindingBlock(const BindingBlock& block) final {
     if (const auto* df_block = block.as<DataflowBlockNode>()) {
       VisitBindingBlock_(df_block);
+      return;
+    }
+    // The bindings of ordinary binding blocks are not fused since they might be impure (with side
+    // effect or control flow), but the dataflow blocks nested in their values are.
+    for (const Binding& binding : block->bindings) {
+      if (const auto* var_binding = binding.as<VarBindingNode>()) {
+        VisitNestedScopes(var_binding->value);
+      } else if (const auto* match_cast = binding.as<MatchCastNode>()) {
+        VisitNestedScopes(match_cast->value);
+      }
+    }
+  }
+
+  /*! \brief Visit the dataflow blocks of the functions and branches nested in an expression. */
+  void VisitNestedScopes(const Expr& expr) {
+    if (const auto* if_node = expr.as<IfNode>()) {
+      this->VisitExpr(if_node->true_branch);
+      this->VisitExpr(if_node->false_branch);
+    } else if (expr->IsInstance<FunctionNode>() || expr->IsInstance<SeqExprNode>()) {
+      this->VisitExpr(expr);
     }
-    // We skip ordinary binding blocks since they might be impure (with side effect or control flow)
   }
 
   // TODO(tvm-team): how to deal with MatchCast binding here
@@ -158,6 +185,10 @@ class GraphCreator : public ExprVisitor {
       // In this case, we skip adding edges, adding an empty node into graph.
     }
     AddToPostDFSOrder(node, binding->var.get());
+    // A function defined in the block has dataflow blocks of its own.
+    if (binding->value->IsInstance<FunctionNode>()) {
+      this->VisitExpr(binding->value);
+    }
   }
 
   /********** Non-Leaf Expression Nodes **********/
@@ -210,8 +241,15 @@ class GraphCreator : public ExprVisitor {
     ICHECK_NOTNULL(binding_var_node);
     SetNodePattern(binding_var_node, OpPatternKind::kOpaque);
 
-    auto visit_leaves = [this, &binding_var_node](const Expr& e) {
-      if (e->IsInstance<VarNode>() || e->IsInstance<ConstantNode>()) {
+    // Only the vars defined outside of the expression are its inputs, e.g. a function defined
+    // in the block uses its own params.
+    std::unordered_set<const VarNode*> free_vars;
+    for (const Var& var : FreeVars(expr)) {
+      free_vars.insert(var.get());
+    }
+    auto visit_leaves = [this, &binding_var_node, &free_vars](const Expr& e) {
+      if (e->IsInstance<ConstantNode>() ||
+          (e->IsInstance<VarNode>() && free_vars.count(e.as<VarNode>()))) {
         VisitLeaf(e, binding_var_node, OpPatternKind::kOpaque);
       }
     };
@@ -241,6 +279,13 @@ class GraphCreator : public ExprVisitor {
       // Since we never fuse constants, the pattern of the constant is set to `kOpaque`.
       SetNodePattern(leaf_node, OpPatternKind::kOpaque);
       AddToPostDFSOrder(leaf_node, leaf_expr.get());
+    } else if (leaf_expr->IsInstance<VarNode>()) {
+      // A var defined outside of the dataflow blocks, e.g. by an ordinary binding or in an
+      // enclosing scope, is an input from the outside like a parameter.
+      leaf_node = CreateNode(leaf_expr.get());
+      MarkAsExternRef(leaf_node);
+      SetNodePattern(leaf_node, OpPatternKind::kOpaque);
+      AddToPostDFSOrder(leaf_node, leaf_expr.get());
     } else {
       LOG(FATAL) << "The leaf Expr is supposed to be defined before, but got: " << leaf_expr
                  << " used before definition.";
@@ -565,13 +610,23 @@ class OperatorFusor : public ExprMutator {
     if (const auto* df_block = block.as<DataflowBlockNode>()) {
       return VisitBindingBlock_(df_block);
     }
-    // We skip ordinary binding blocks since they might be impure (with side effect or control flow)
-    return block;
+    // The bindings of ordinary binding blocks are kept since they might be impure (with side
+    // effect or control flow), but the dataflow blocks nested in their values are fused.
+    return ExprMutator::VisitBindingBlock_(block.as<BindingBlockNode>());
   }
 
   BindingBlock VisitBindingBlock_(const DataflowBlockNode* block) final {
-    group2func_.clear();
+    // The block may be nested in a function defined by a binding of an enclosing block, whose
+    // grouped functions are restored once this block is done.
+    std::unordered_map<GraphPartitioner::Group*, FunctionCreator> enclosing_group2func;
+    std::swap(enclosing_group2func, group2func_);
+    BindingBlock new_block = FuseBindings(block);
+    std::swap(enclosing_group2func, group2func_);
+    return new_block;
+  }
 
+  /*! \brief Substitute the groups of bindings of a dataflow block by calls to grouped functions. */
+  BindingBlock FuseBindings(const DataflowBlockNode* block) {
     // Step 1. Collect the bindings for each grouped function.
     CollectFuncBindings(block->bindings);
 
@@ -668,7 +723,8 @@ class OperatorFusor : public ExprMutator {
       // - If the var's group is different with the binding's, the var must be the output from
       //   another group. Mark it to be the group output.
       auto update_boundary = [this, &cur_group](const Expr& e) {
-        if (e->IsInstance<VarNode>()) {
+        // The vars defined in the scopes nested in the binding are not in the graph.
+        if (e->IsInstance<VarNode>() && obj2group_.count(e.get())) {
           const Var& used_var = Downcast<Var>(e);
           GraphPartitioner::Group* producer_group = GetGroupFromVar(used_var);
           // Only check those group defined before.
@@ -740,7 +796,60 @@ class OperatorFusor : public ExprMutator {
   std::unordered_map<GraphPartitioner::Group*, FunctionCreator> group2func_;
 };
 
-IRModule FuseOps(IRModule mod, int opt_level, size_t max_fuse_depth) {
+/*!
+ * \brief Fuse the reductions into the groups of their elementwise consumer, which the fusion
+ * algorithm never does. The reduced tensor of such a pair does not need to be written to and read
+ * back from memory, since the consumer can be computed right after each reduced element. Hence a
+ * reduction is only fused when this saves the traffic of the reduced tensor, that is:
+ *  - the reduced tensor is used by a single elementwise consumer and is not an output,
+ *  - the other nodes of the group of the reduction are only used inside the group,
+ *  - the fused group does not exceed the maximum number of fused ops.
+ * This is a fixed structural rule, applied to every such pair without a cost model.
+ * \param graph The indexed-forward graph.
+ * \param groups The groups of the nodes, updated in place.
+ * \param max_fuse_depth The maximum number of ops in a group.
+ */
+void FuseReductionEpilogues(const IndexedForwardGraph& graph,
+                            const std::vector<GraphPartitioner::Group*>& groups,
+                            size_t max_fuse_depth) {
+  // The consumers of the nodes of each group out of the group, collected once and merged along
+  // with the groups.
+  std::unordered_map<GraphPartitioner::Group*, std::vector<size_t>> group_outputs;
+  for (size_t nid = 0; nid < graph.post_dfs_order.size(); ++nid) {
+    GraphPartitioner::Group* group = groups[nid]->FindRoot();
+    for (auto* out = graph.post_dfs_order[nid]->outputs.head; out != nullptr; out = out->next) {
+      size_t out_id = out->value.node->index;
+      if (groups[out_id]->FindRoot() != group) group_outputs[group].push_back(out_id);
+    }
+  }
+  for (size_t nid = 0; nid < graph.post_dfs_order.size(); ++nid) {
+    IndexedForwardGraph::Node* node = graph.post_dfs_order[nid];
+    if (node->pattern != OpPatternKind::kCommReduce || node->extern_ref) continue;
+    const LinkNode<IndexedForwardGraph::Edge>* link = node->outputs.head;
+    if (link == nullptr || link->next != nullptr) continue;
+    if (link->value.pattern != OpPatternKind::kElemWise) continue;
+    GraphPartitioner::Group* group = groups[nid]->FindRoot();
+    GraphPartitioner::Group* consumer_group = groups[link->value.node->index]->FindRoot();
+    if (group == consumer_group || consumer_group->pattern > OpPatternKind::kInjective) continue;
+    if (group->num_nodes + consumer_group->num_nodes > max_fuse_depth) continue;
+    // The group of the reduction must not have another consumer, otherwise the fused group might
+    // both produce and consume the values of the other consumer.
+    std::vector<size_t>& outputs = group_outputs[group];
+    bool single_consumer = std::all_of(outputs.begin(), outputs.end(), [&](size_t out_id) {
+      GraphPartitioner::Group* out_group = groups[out_id]->FindRoot();
+      return out_group == group || out_group == consumer_group;
+    });
+    if (!single_consumer) continue;
+    group->parent = consumer_group;
+    consumer_group->num_nodes += group->num_nodes;
+    consumer_group->pattern = OpPatternKind::kCommReduce;
+    std::vector<size_t>& consumer_outputs = group_outputs[consumer_group];
+    consumer_outputs.insert(consumer_outputs.end(), outputs.begin(), outputs.end());
+    group_outputs.erase(group);
+  }
+}
+
+IRModule FuseOps(IRModule mod, int opt_level, size_t max_fuse_depth, bool fuse_reduction_epilogue) {
   support::Arena arena;
 
   // Step 1. Create the indexed-forward graph according to the input IRModule.
@@ -749,6 +858,9 @@ IRModule FuseOps(IRModule mod, int opt_level, size_t max_fuse_depth) {
   // Step 2. Partition the graph by applying the fusion algorithm.
   std::vector<GraphPartitioner::Group*> groups =
       GraphPartitioner(&arena, opt_level, max_fuse_depth).Partition(graph);
+  if (fuse_reduction_epilogue && opt_level > 0) {
+    FuseReductionEpilogues(graph, groups, max_fuse_depth);
+  }
 
   // Step 3. Transform the IRModule by fusing the operators in accordance with the graph partition
   // results.
@@ -764,7 +876,10 @@ Pass FuseOps(int fuse_opt_level) {
       [=](IRModule m, PassContext pc) {
         int opt_level = fuse_opt_level == -1 ? pc->opt_level : fuse_opt_level;
         auto max_fuse_depth = pc->GetConfig("relax.FuseOps.max_depth", Integer(kMaxFusedOps));
-        return relax::FuseOps(m, opt_level, max_fuse_depth.value().IntValue());
+        auto fuse_reduction_epilogue =
+            pc->GetConfig("relax.FuseOps.fuse_reduction_epilogue", Bool(false));
+        return relax::FuseOps(m, opt_level, max_fuse_depth.value().IntValue(),
+                              fuse_reduction_epilogue.value());
       };
   return CreateModulePass(/*pass_function=*/pass_func,  //
                           /*opt_level=*/0,              //
@@ -0,0 +1,129 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * \file src/relax/transform/kill_after_last_use.cc
+ * \brief Release the tensors and storages allocated in a function right after their last use.
+ */
+#include <tvm/relax/expr_functor.h>
+#include <tvm/relax/transform.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "storage_liveness.h"
+
+namespace tvm {
+namespace relax {
+
+// ==================
+// KillAfterLastUse
+// Insert relax.memory.kill_tensor/kill_storage right after the binding that last uses an
+// allocation which does not escape the function, so that the VM releases the register
+// holding it instead of keeping it alive until the function returns.
+// Example:
+// storage = relax.memory.alloc_storage((1024,), 0, "global", "float32")
+// alloc0 = relax.memory.alloc_tensor(storage, (256,), 0, "float32")
+// _ = f(x, alloc0)
+// alloc1 = relax.builtin.alloc_tensor((256,), dtype="float32", runtime_device_index=0)
+// _ = f(alloc0, alloc1)
+// -->
+// storage = relax.memory.alloc_storage((1024,), 0, "global", "float32")
+// alloc0 = relax.memory.alloc_tensor(storage, (256,), 0, "float32")
+// _ = f(x, alloc0)
+// alloc1 = relax.builtin.alloc_tensor((256,), dtype="float32", runtime_device_index=0)
+// _ = f(alloc0, alloc1)
+// _ = relax.memory.kill_tensor(alloc0)
+// _ = relax.memory.kill_storage(storage)
+//
+// A storage is released once all the tensors allocated from it are dead. The vars aliasing an
+// allocation (tuples, tuple projections, packed function results) are released along with
+// it. Allocations that escape (see AnalyzeStorageLiveness) are never killed.
+
+class KillAfterLastUseMutator : public ExprMutator {
+ public:
+  static Function Rewrite(const Function& func, const IRModule& mod) {
+    StorageLiveness liveness = AnalyzeStorageLiveness(func, mod);
+    KillAfterLastUseMutator mutator(mod);
+    for (const StorageToken& token : liveness.tokens) {
+      if (token.escaped) continue;
+      const VarNode* last_use = liveness.binding_vars[token.last_use_pos].get();
+      mutator.kills_[last_use].push_back(&token);
+    }
+    if (mutator.kills_.empty()) return func;
+    // Release the tensors before the storages they are allocated from.
+    for (auto& kv : mutator.kills_) {
+      std::stable_sort(kv.second.begin(), kv.second.end(),
+                       [](const StorageToken* lhs, const StorageToken* rhs) {
+                         return lhs->kind != StorageTokenKind::kMemAllocStorage &&
+                                rhs->kind == StorageTokenKind::kMemAllocStorage;
+                       });
+    }
+    return Downcast<Function>(mutator.VisitExpr(func));
+  }
+
+ private:
+  explicit KillAfterLastUseMutator(const IRModule& mod) : ExprMutator(mod) {}
+
+  void VisitBinding(const Binding& binding) final {
+    ExprMutator::VisitBinding(binding);
+    auto it = kills_.find(binding->var.get());
+    if (it == kills_.end()) return;
+    for (const StorageToken* token : it->second) {
+      const Op& kill_op =
+          token->kind == StorageTokenKind::kMemAllocStorage ? kill_storage_op_ : kill_tensor_op_;
+      // Tuples, projections and packed results holding the allocation keep it alive as well.
+      // None of them is used past the last use of the allocation, so they are released too.
+      for (const Var& alias : token->aliases) {
+        EmitKill(kill_op, alias);
+      }
+      EmitKill(kill_op, token->var);
+    }
+  }
+
+  void EmitKill(const Op& kill_op, const Var& var) {
+    if (!killed_.insert(var.get()).second) return;
+    builder_->Emit(Call(kill_op, {this->VisitExpr(var)}), "_");
+  }
+
+  /*! \brief Map from the binding var to the allocations released after the binding. */
+  std::unordered_map<const VarNode*, std::vector<const StorageToken*>> kills_;
+  /*! \brief The vars already released. */
+  std::unordered_set<const VarNode*> killed_;
+  /*! \brief Cache ops that need to be frequently used later to reduce lookup overhead. */
+  const Op& kill_storage_op_ = Op::Get("relax.memory.kill_storage");
+  const Op& kill_tensor_op_ = Op::Get("relax.memory.kill_tensor");
+};
+
+namespace transform {
+
+Pass KillAfterLastUse() {
+  runtime::TypedPackedFunc<Function(Function, IRModule, PassContext)> pass_func =
+      [=](Function f, IRModule m, PassContext pc) {
+        return KillAfterLastUseMutator::Rewrite(f, m);
+      };
+  return CreateFunctionPass(pass_func, 0, "KillAfterLastUse", {});
+}
+
+TVM_REGISTER_GLOBAL("relax.transform.KillAfterLastUse").set_body_typed(KillAfterLastUse);
+
+}  // namespace transform
+}  // namespace relax
+}  // namespace tvm
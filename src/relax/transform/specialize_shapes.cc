@@ -0,0 +1,217 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * \file src/relax/transform/specialize_shapes.cc
+ * \brief Specialize a dynamic-shape Relax function to concrete values of its symbolic shape vars.
+ */
+#include <tvm/arith/analyzer.h>
+#include <tvm/relax/expr_functor.h>
+#include <tvm/relax/struct_info.h>
+#include <tvm/relax/transform.h>
+#include <tvm/tir/function.h>
+#include <tvm/tir/op.h>
+#include <tvm/tir/stmt_functor.h>
+
+#include <unordered_map>
+#include <utility>
+
+namespace tvm {
+namespace relax {
+
+// ==================
+// SpecializeShapes
+// Substitute the symbolic shape vars of a function by the given values, and specialize the
+// PrimFuncs called through call_tir whose arguments become statically shaped, so that the
+// shape computations, kernels and memory plan of the function are all static.
+// Example (shape_vars = {n: 16}):
+// def main(x: R.Tensor((n, 4), "float32")):
+//   gv = R.call_tir(exp, (x,), (n, 4), dtype="float32")
+// -->
+// def main(x: R.Tensor((16, 4), "float32")):
+//   gv = R.call_tir(exp1, (x,), (16, 4), dtype="float32")
+//
+// where exp1 is exp specialized with its buffers of shape (16, 4). The generic PrimFuncs are
+// kept in the module, since other functions may still call them.
+
+class ShapeSpecializer : public ExprMutator {
+ public:
+  static IRModule Specialize(const IRModule& mod, const String& func_name,
+                             const Map<tir::Var, PrimExpr>& shape_vars) {
+    ShapeSpecializer specializer(mod, shape_vars);
+    for (const auto& kv : mod->functions) {
+      const auto* func = kv.second.as<FunctionNode>();
+      if (func == nullptr) continue;
+      Optional<String> gsymbol = func->GetAttr<String>(tvm::attr::kGlobalSymbol);
+      String name = gsymbol.defined() ? gsymbol.value() : kv.first->name_hint;
+      if (name != func_name) continue;
+      Function new_func = Downcast<Function>(specializer.VisitExpr(GetRef<Function>(func)));
+      StructInfo ret_struct_info =
+          specializer.VisitExprDepStructInfoField(new_func->ret_struct_info);
+      if (!ret_struct_info.same_as(new_func->ret_struct_info)) {
+        new_func = Function(new_func->params, new_func->body, ret_struct_info, new_func->attrs);
+      }
+      specializer.builder_->UpdateFunction(kv.first, new_func);
+    }
+    return specializer.builder_->GetContextIRModule();
+  }
+
+ private:
+  ShapeSpecializer(const IRModule& mod, const Map<tir::Var, PrimExpr>& shape_vars)
+      : ExprMutator(mod), mod_(mod), shape_vars_(shape_vars) {}
+
+  using ExprMutator::VisitExpr_;
+
+  PrimExpr VisitPrimExpr(const PrimExpr& expr) final {
+    PrimExpr new_expr = tir::Substitute(expr, [this](const tir::Var& var) -> Optional<PrimExpr> {
+      auto it = shape_vars_.find(var);
+      if (it == shape_vars_.end()) return NullOpt;
+      return cast(var->dtype, (*it).second);
+    });
+    if (new_expr.same_as(expr)) return expr;
+    return analyzer_.Simplify(new_expr);
+  }
+
+  void VisitBinding_(const MatchCastNode* binding) final {
+    StructInfo struct_info = this->VisitExprDepStructInfoField(binding->struct_info);
+    if (struct_info.same_as(binding->struct_info)) {
+      ExprMutator::VisitBinding_(binding);
+      return;
+    }
+    Var new_var = this->VisitVarDef(binding->var);
+    Expr new_value = builder_->NormalizeArgument(this->VisitExpr(binding->value));
+    builder_->EmitNormalized(MatchCast(new_var, new_value, struct_info, binding->span));
+  }
+
+  Expr VisitExpr_(const CallNode* op) final {
+    Call call = Downcast<Call>(ExprMutator::VisitExpr_(op));
+    if (call->op != call_tir_op_) return std::move(call);
+    Optional<GlobalVar> kernel = SpecializeKernel(call);
+    if (!kernel.defined()) return std::move(call);
+    return Call(call_tir_op_, {kernel.value(), call->args[1], call->args[2]}, call->attrs,
+                call->type_args);
+  }
+
+  /*!
+   * \brief Specialize the PrimFunc called by a call_tir to the static shapes of its arguments.
+   * \return The global var of the specialized PrimFunc, or NullOpt if the call is not static.
+   */
+  Optional<GlobalVar> SpecializeKernel(const Call& call) {
+    const auto* gv = call->args[0].as<GlobalVarNode>();
+    if (gv == nullptr || !mod_->ContainGlobalVar(gv->name_hint)) return NullOpt;
+    const auto* prim_func = mod_->Lookup(gv->name_hint).as<tir::PrimFuncNode>();
+    if (prim_func == nullptr) return NullOpt;
+
+    // The shapes of the buffer params, inputs followed by outputs.
+    Array<Array<PrimExpr>> shapes;
+    Array<Expr> inputs;
+    if (const auto* tuple = call->args[1].as<TupleNode>()) {
+      inputs = tuple->fields;
+    } else {
+      inputs = {call->args[1]};
+    }
+    for (const Expr& input : inputs) {
+      const auto* sinfo = GetStructInfoAs<TensorStructInfoNode>(input);
+      if (sinfo == nullptr || !sinfo->shape.defined()) return NullOpt;
+      const auto* shape = sinfo->shape.as<ShapeExprNode>();
+      if (shape == nullptr) return NullOpt;
+      shapes.push_back(shape->values);
+    }
+    if (const auto* tuple = call->args[2].as<TupleNode>()) {
+      for (const Expr& field : tuple->fields) {
+        const auto* shape = field.as<ShapeExprNode>();
+        if (shape == nullptr) return NullOpt;
+        shapes.push_back(shape->values);
+      }
+    } else if (const auto* shape = call->args[2].as<ShapeExprNode>()) {
+      shapes.push_back(shape->values);
+    } else {
+      return NullOpt;
+    }
+    Array<PrimExpr> packed_ints;
+    if (call->args.size() == 4) {
+      const auto* shape = call->args[3].as<ShapeExprNode>();
+      if (shape == nullptr) return NullOpt;
+      packed_ints = shape->values;
+    }
+    if (prim_func->params.size() != shapes.size() + packed_ints.size()) return NullOpt;
+
+    Map<tir::Var, ObjectRef> param_map;
+    std::unordered_map<const tir::VarNode*, int64_t> var_values;
+    for (size_t i = 0; i < shapes.size(); ++i) {
+      const tir::Var& param = prim_func->params[i];
+      auto it = prim_func->buffer_map.find(param);
+      if (it == prim_func->buffer_map.end()) return NullOpt;
+      const tir::Buffer& buffer = (*it).second;
+      if (buffer->shape.size() != shapes[i].size()) return NullOpt;
+      Array<PrimExpr> static_shape;
+      for (size_t j = 0; j < shapes[i].size(); ++j) {
+        const auto* dim = shapes[i][j].as<IntImmNode>();
+        if (dim == nullptr) return NullOpt;
+        const PrimExpr& old_dim = buffer->shape[j];
+        if (const auto* old_var = old_dim.as<tir::VarNode>()) {
+          auto var_it = var_values.emplace(old_var, dim->value).first;
+          if (var_it->second != dim->value) return NullOpt;
+        } else {
+          const auto* old_int = old_dim.as<IntImmNode>();
+          if (old_int == nullptr || old_int->value != dim->value) return NullOpt;
+        }
+        static_shape.push_back(IntImm(old_dim.dtype(), dim->value));
+      }
+      tir::Buffer specific_buffer = buffer;
+      specific_buffer.CopyOnWrite()->shape = static_shape;
+      param_map.Set(param, specific_buffer);
+    }
+    for (size_t i = 0; i < packed_ints.size(); ++i) {
+      const tir::Var& param = prim_func->params[shapes.size() + i];
+      const auto* value = packed_ints[i].as<IntImmNode>();
+      if (value == nullptr || prim_func->buffer_map.count(param)) return NullOpt;
+      param_map.Set(param, IntImm(param.dtype(), value->value));
+    }
+
+    tir::PrimFunc specialized = tir::Specialize(GetRef<tir::PrimFunc>(prim_func), param_map);
+    // A param that could not be specialized (e.g. an unbound scalar) keeps the kernel dynamic.
+    if (specialized->params.size() != shapes.size()) return NullOpt;
+    return builder_->AddFunction(specialized, gv->name_hint);
+  }
+
+  /*! \brief The input IRModule. */
+  IRModule mod_;
+  /*! \brief Map from a symbolic shape var to its value. */
+  Map<tir::Var, PrimExpr> shape_vars_;
+  /*! \brief The analyzer used to simplify the substituted shapes. */
+  arith::Analyzer analyzer_;
+  /*! \brief Cache ops that need to be frequently used later to reduce lookup overhead. */
+  const Op& call_tir_op_ = Op::Get("relax.call_tir");
+};
+
+namespace transform {
+
+Pass SpecializeShapes(String func_name, Map<tir::Var, PrimExpr> shape_vars) {
+  runtime::TypedPackedFunc<IRModule(IRModule, PassContext)> pass_func =
+      [=](IRModule mod, PassContext pc) {
+        return ShapeSpecializer::Specialize(mod, func_name, shape_vars);
+      };
+  return CreateModulePass(pass_func, 0, "SpecializeShapes", {});
+}
+
+TVM_REGISTER_GLOBAL("relax.transform.SpecializeShapes").set_body_typed(SpecializeShapes);
+
+}  // namespace transform
+}  // namespace relax
+}  // namespace tvm
@@ -0,0 +1,248 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * \file src/relax/transform/static_plan_block_memory.cc
+ * \brief Statically plan the memory of the tensors allocated by relax.builtin.alloc_tensor.
+ */
+#include <tvm/relax/attrs/memory.h>
+#include <tvm/relax/expr_functor.h>
+#include <tvm/relax/struct_info.h>
+#include <tvm/relax/transform.h>
+#include <tvm/runtime/device_api.h>
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "storage_liveness.h"
+
+namespace tvm {
+namespace relax {
+
+// ==================
+// StaticPlanBlockMemory
+// Linearize the bindings of a function body, compute the live interval of every
+// static-shaped relax.builtin.alloc_tensor, and place the tensors whose intervals
+// do not overlap into one shared arena storage per (device, dtype).
+// Example:
+// alloc0 = relax.builtin.alloc_tensor((256,), dtype="float32", runtime_device_index=0)
+// _ = f(x, alloc0)
+// alloc1 = relax.builtin.alloc_tensor((256,), dtype="float32", runtime_device_index=0)
+// _ = f(alloc0, alloc1)
+// alloc2 = relax.builtin.alloc_tensor((256,), dtype="float32", runtime_device_index=0)
+// _ = f(alloc1, alloc2)
+// -->
+// storage = relax.memory.alloc_storage((2048,), 0, "global", "float32")
+// alloc0 = relax.memory.alloc_tensor(storage, (256,), 0, "float32")
+// _ = f(x, alloc0)
+// alloc1 = relax.memory.alloc_tensor(storage, (256,), 1024, "float32")
+// _ = f(alloc0, alloc1)
+// alloc2 = relax.memory.alloc_tensor(storage, (256,), 0, "float32")
+// _ = f(alloc1, alloc2)
+//
+// Tensors that may outlive the function or be referenced from places the analysis does not
+// model (returned, captured by closures, passed to Relax functions, used under control flow)
+// are left as relax.builtin.alloc_tensor and lowered individually by VMMemoryLower.
+
+/*! \brief A storage shared by several planned tensors. */
+struct StorageArena {
+  /*! \brief The runtime device index of the storage. */
+  int64_t device_index;
+  /*! \brief The dtype hint of the storage. */
+  DataType dtype;
+  /*! \brief The size of the storage in bytes. */
+  int64_t bytes{0};
+};
+
+/*! \brief The placement of a planned tensor. */
+struct TensorPlacement {
+  /*! \brief The index of the arena the tensor is placed in. */
+  int arena;
+  /*! \brief The byte offset of the tensor inside its arena. */
+  int64_t offset;
+};
+
+/*! \brief The memory plan of a function. */
+struct MemoryPlan {
+  /*! \brief The arenas backing the planned tensors. */
+  std::vector<StorageArena> arenas;
+  /*! \brief Map from the var bound to a planned alloc_tensor to its placement. */
+  std::unordered_map<const VarNode*, TensorPlacement> placements;
+};
+
+/*!
+ * \brief Assign arena offsets to the static-shaped alloc_tensor tokens that do not escape.
+ *
+ * Tokens are grouped by (device, dtype). In each group, tokens are placed in decreasing size
+ * order at the lowest aligned offset that does not collide with any already placed token whose
+ * live interval overlaps.
+ */
+MemoryPlan AssignOffsets(const StorageLiveness& liveness) {
+  const int64_t alignment = runtime::kAllocAlignment;
+  // The offset attribute of memory.alloc_tensor is an int.
+  const int64_t max_offset = std::numeric_limits<int>::max();
+  auto align_up = [alignment](int64_t value) {
+    return (value + alignment - 1) / alignment * alignment;
+  };
+  auto overlap = [](const StorageToken& lhs, const StorageToken& rhs) {
+    return lhs.def_pos <= rhs.last_use_pos && rhs.def_pos <= lhs.last_use_pos;
+  };
+  const std::vector<StorageToken>& tokens = liveness.tokens;
+
+  std::vector<std::vector<int>> groups;
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    const StorageToken& token = tokens[i];
+    if (token.kind != StorageTokenKind::kAllocTensor || !token.static_size || token.escaped) {
+      continue;
+    }
+    auto it = std::find_if(groups.begin(), groups.end(), [&](const std::vector<int>& group) {
+      const StorageToken& head = tokens[group[0]];
+      return head.device_index == token.device_index && head.dtype == token.dtype;
+    });
+    if (it == groups.end()) {
+      groups.push_back({static_cast<int>(i)});
+    } else {
+      it->push_back(static_cast<int>(i));
+    }
+  }
+
+  MemoryPlan plan;
+  std::vector<int64_t> offsets(tokens.size(), 0);
+  for (std::vector<int>& group : groups) {
+    std::stable_sort(group.begin(), group.end(),
+                     [&](int lhs, int rhs) { return tokens[lhs].bytes > tokens[rhs].bytes; });
+    StorageArena arena;
+    arena.device_index = tokens[group[0]].device_index;
+    arena.dtype = tokens[group[0]].dtype;
+
+    std::vector<int> placed;
+    for (int token_index : group) {
+      const StorageToken& token = tokens[token_index];
+      std::vector<int> conflicts;
+      for (int other : placed) {
+        if (overlap(token, tokens[other])) conflicts.push_back(other);
+      }
+      std::sort(conflicts.begin(), conflicts.end(),
+                [&](int lhs, int rhs) { return offsets[lhs] < offsets[rhs]; });
+      int64_t offset = 0;
+      for (int other : conflicts) {
+        if (offset + token.bytes <= offsets[other]) break;
+        offset = std::max(offset, align_up(offsets[other] + tokens[other].bytes));
+      }
+      if (offset + token.bytes > max_offset) continue;
+      offsets[token_index] = offset;
+      placed.push_back(token_index);
+      arena.bytes = std::max(arena.bytes, offset + token.bytes);
+    }
+    if (placed.empty()) continue;
+    int arena_index = plan.arenas.size();
+    plan.arenas.push_back(arena);
+    for (int token_index : placed) {
+      plan.placements[tokens[token_index].var.get()] =
+          TensorPlacement{arena_index, offsets[token_index]};
+    }
+  }
+  return plan;
+}
+
+/*! \brief Rewrite the planned alloc_tensor bindings into memory.alloc_storage/alloc_tensor. */
+class StorageAllocationRewriter : public ExprMutator {
+ public:
+  static Function Rewrite(const Function& func, const IRModule& mod, const MemoryPlan& plan) {
+    if (plan.arenas.empty()) return func;
+    StorageAllocationRewriter rewriter(mod, plan);
+    rewriter.top_level_body_ = func->body.get();
+    return Downcast<Function>(rewriter.VisitExpr(func));
+  }
+
+ private:
+  StorageAllocationRewriter(const IRModule& mod, const MemoryPlan& plan)
+      : ExprMutator(mod), plan_(plan) {}
+
+  using ExprMutator::VisitExpr_;
+
+  Expr VisitExpr_(const SeqExprNode* op) final {
+    if (op != top_level_body_) {
+      return ExprMutator::VisitExpr_(op);
+    }
+    // Allocate all the arenas up front in a block of their own, so that
+    // the storages are visible to every subsequent block.
+    builder_->BeginBindingBlock();
+    for (const StorageArena& arena : plan_.arenas) {
+      auto attrs = make_object<MemAllocStorageAttrs>();
+      attrs->virtual_device_index = arena.device_index;
+      attrs->storage_scope = "global";
+      attrs->dtype = arena.dtype;
+      Expr size = ShapeExpr({IntImm(DataType::Int(64), arena.bytes)});
+      storages_.push_back(
+          builder_->Emit(Call(mem_alloc_storage_op_, {size}, Attrs(attrs)), "storage"));
+    }
+    BindingBlock prologue = builder_->EndBlock();
+
+    SeqExpr seq = Downcast<SeqExpr>(ExprMutator::VisitExpr_(op));
+    Array<BindingBlock> blocks{prologue};
+    blocks.insert(blocks.end(), seq->blocks.begin(), seq->blocks.end());
+    return SeqExpr(blocks, seq->body);
+  }
+
+  void VisitBinding_(const VarBindingNode* binding, const CallNode* call) final {
+    auto it = plan_.placements.find(binding->var.get());
+    if (it == plan_.placements.end()) {
+      ExprMutator::VisitBinding_(binding, call);
+      return;
+    }
+    const TensorPlacement& placement = it->second;
+    auto attrs = make_object<MemAllocTensorAttrs>();
+    attrs->offset = static_cast<int>(placement.offset);
+    attrs->dtype = call->attrs.as<AllocTensorAttrs>()->dtype;
+    Expr new_value = builder_->Normalize(
+        Call(mem_alloc_tensor_op_, {storages_[placement.arena], call->args[0]}, Attrs(attrs)));
+    ReEmitBinding(binding, new_value);
+  }
+
+  /*! \brief The memory plan of the function. */
+  const MemoryPlan& plan_;
+  /*! \brief The body of the function being rewritten. */
+  const Object* top_level_body_ = nullptr;
+  /*! \brief The vars bound to the arena storages. */
+  std::vector<Var> storages_;
+  /*! \brief Cache ops that need to be frequently used later to reduce lookup overhead. */
+  const Op& mem_alloc_storage_op_ = Op::Get("relax.memory.alloc_storage");
+  const Op& mem_alloc_tensor_op_ = Op::Get("relax.memory.alloc_tensor");
+};
+
+Function StaticPlanBlockMemory(const Function& func, const IRModule& mod) {
+  MemoryPlan plan = AssignOffsets(AnalyzeStorageLiveness(func, mod));
+  return StorageAllocationRewriter::Rewrite(func, mod, plan);
+}
+
+namespace transform {
+
+Pass StaticPlanBlockMemory() {
+  runtime::TypedPackedFunc<Function(Function, IRModule, PassContext)> pass_func =
+      [=](Function f, IRModule m, PassContext pc) { return relax::StaticPlanBlockMemory(f, m); };
+  return CreateFunctionPass(pass_func, 0, "StaticPlanBlockMemory", {});
+}
+
+TVM_REGISTER_GLOBAL("relax.transform.StaticPlanBlockMemory").set_body_typed(StaticPlanBlockMemory);
+
+}  // namespace transform
+}  // namespace relax
+}  // namespace tvm
@@ -0,0 +1,249 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * \file src/relax/transform/storage_liveness.cc
+ * \brief Liveness analysis of the tensors and storages allocated in a Relax function.
+ */
+#include "storage_liveness.h"
+
+#include <tvm/relax/attrs/memory.h>
+#include <tvm/relax/expr_functor.h>
+#include <tvm/tir/function.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace tvm {
+namespace relax {
+
+class StorageLivenessAnalyzer : public ExprVisitor {
+ public:
+  explicit StorageLivenessAnalyzer(IRModule mod) : mod_(std::move(mod)) {}
+
+  StorageLiveness Analyze(const Function& func) {
+    const auto* seq = func->body.as<SeqExprNode>();
+    if (seq == nullptr) return std::move(result_);
+    for (const BindingBlock& block : seq->blocks) {
+      for (const Binding& binding : block->bindings) {
+        AnalyzeBinding(binding);
+        result_.binding_vars.push_back(binding->var);
+        ++pos_;
+      }
+    }
+    // The function output outlives the function.
+    this->VisitExpr(seq->body);
+    // A storage lives as long as the tensors allocated from it. Tensors hold a reference to
+    // their storage, so an escaping tensor does not prevent releasing the storage register.
+    for (const StorageToken& token : result_.tokens) {
+      if (token.storage == -1) continue;
+      StorageToken& storage = result_.tokens[token.storage];
+      storage.last_use_pos = std::max(storage.last_use_pos, token.last_use_pos);
+    }
+    return std::move(result_);
+  }
+
+ private:
+  void AnalyzeBinding(const Binding& binding) {
+    const auto* var_binding = binding.as<VarBindingNode>();
+    if (var_binding == nullptr) {
+      // MatchCast binds its var to the matched value, we do not track such aliases.
+      this->VisitExpr(Downcast<MatchCast>(binding)->value);
+      return;
+    }
+    const Var& var = var_binding->var;
+    const Expr& value = var_binding->value;
+
+    if (const auto* call = value.as<CallNode>()) {
+      if (call->op == alloc_tensor_op_) {
+        CreateAllocTensorToken(var, call);
+        return;
+      }
+      if (call->op == mem_alloc_storage_op_) {
+        CreateMemAllocStorageToken(var, call);
+        return;
+      }
+      if (call->op == mem_alloc_tensor_op_) {
+        CreateMemAllocTensorToken(var, call);
+        return;
+      }
+      if (IsPrimFuncCall(call)) {
+        // PrimFuncs write to the destination arguments and return nothing.
+        for (const Expr& arg : call->args) {
+          Use(arg, nullptr);
+        }
+        return;
+      }
+      if (call->op->IsInstance<ExternFuncNode>()) {
+        // Packed functions are assumed not to retain their arguments, but they may
+        // return one of them, so the result aliases every tensor passed in.
+        std::vector<int> alias;
+        for (const Expr& arg : call->args) {
+          Use(arg, &alias);
+        }
+        SetAlias(var, std::move(alias));
+        return;
+      }
+    } else if (value->IsInstance<VarNode>() || value->IsInstance<TupleNode>()) {
+      std::vector<int> alias;
+      Use(value, &alias);
+      SetAlias(var, std::move(alias));
+      return;
+    } else if (const auto* get_item = value.as<TupleGetItemNode>()) {
+      std::vector<int> alias;
+      Use(get_item->tuple, &alias);
+      SetAlias(var, std::move(alias));
+      return;
+    }
+    // Unknown consumer, conservatively treat every allocation referenced as escaped.
+    this->VisitExpr(value);
+  }
+
+  bool IsPrimFuncCall(const CallNode* call) const {
+    if (call->op == call_tir_dyn_op_) return true;
+    if (const auto* gv = call->op.as<GlobalVarNode>()) {
+      return mod_->ContainGlobalVar(gv->name_hint) &&
+             mod_->Lookup(gv->name_hint)->IsInstance<tir::PrimFuncNode>();
+    }
+    return false;
+  }
+
+  int CreateToken(StorageTokenKind kind, const Var& var) {
+    StorageToken token;
+    token.kind = kind;
+    token.var = var;
+    token.def_pos = pos_;
+    token.last_use_pos = pos_;
+    int token_index = result_.tokens.size();
+    result_.tokens.push_back(token);
+    SetAlias(var, {token_index});
+    return token_index;
+  }
+
+  void CreateAllocTensorToken(const Var& var, const CallNode* call) {
+    const auto* attrs = call->attrs.as<AllocTensorAttrs>();
+    ICHECK(attrs != nullptr) << "must be AllocTensorAttrs";
+    StorageToken& token = result_.tokens[CreateToken(StorageTokenKind::kAllocTensor, var)];
+    token.dtype = attrs->dtype;
+    token.device_index = attrs->runtime_device_index;
+    const auto* shape = call->args[0].as<ShapeExprNode>();
+    if (shape == nullptr) return;
+    int64_t num_elem = 1;
+    for (const PrimExpr& dim : shape->values) {
+      const auto* int_dim = dim.as<IntImmNode>();
+      if (int_dim == nullptr) return;
+      num_elem *= int_dim->value;
+    }
+    token.static_size = true;
+    token.bytes = num_elem * ((attrs->dtype.bits() * attrs->dtype.lanes() + 7) / 8);
+  }
+
+  void CreateMemAllocStorageToken(const Var& var, const CallNode* call) {
+    const auto* attrs = call->attrs.as<MemAllocStorageAttrs>();
+    ICHECK(attrs != nullptr) << "must be MemAllocStorageAttrs";
+    this->VisitExpr(call->args[0]);
+    StorageToken& token = result_.tokens[CreateToken(StorageTokenKind::kMemAllocStorage, var)];
+    token.dtype = attrs->dtype;
+    token.device_index = attrs->virtual_device_index;
+  }
+
+  void CreateMemAllocTensorToken(const Var& var, const CallNode* call) {
+    const auto* attrs = call->attrs.as<MemAllocTensorAttrs>();
+    ICHECK(attrs != nullptr) << "must be MemAllocTensorAttrs";
+    // The storage argument is not an alias of the tensor, the tensor is linked to it instead.
+    std::vector<int> storage_alias;
+    Use(call->args[0], &storage_alias);
+    this->VisitExpr(call->args[1]);
+    StorageToken& token = result_.tokens[CreateToken(StorageTokenKind::kMemAllocTensor, var)];
+    token.dtype = attrs->dtype;
+    if (storage_alias.size() == 1 &&
+        result_.tokens[storage_alias[0]].kind == StorageTokenKind::kMemAllocStorage) {
+      token.storage = storage_alias[0];
+    }
+  }
+
+  void SetAlias(const Var& var, std::vector<int> alias) {
+    if (alias.empty()) return;
+    for (int token_index : alias) {
+      StorageToken& token = result_.tokens[token_index];
+      if (token.var.same_as(var)) continue;
+      if (token.aliases.empty() || !token.aliases.back().same_as(var)) {
+        token.aliases.push_back(var);
+      }
+    }
+    var_alias_[var.get()] = std::move(alias);
+  }
+
+  /*!
+   * \brief Record a use of \p expr at the current position.
+   * \param expr The used expression.
+   * \param alias If not null, the tokens aliased by \p expr are appended to it.
+   */
+  void Use(const Expr& expr, std::vector<int>* alias) {
+    if (const auto* tuple = expr.as<TupleNode>()) {
+      for (const Expr& field : tuple->fields) {
+        Use(field, alias);
+      }
+      return;
+    }
+    if (!expr->IsInstance<VarNode>()) {
+      this->VisitExpr(expr);
+      return;
+    }
+    auto it = var_alias_.find(expr.as<VarNode>());
+    if (it == var_alias_.end()) return;
+    for (int token_index : it->second) {
+      StorageToken& token = result_.tokens[token_index];
+      token.last_use_pos = std::max(token.last_use_pos, pos_);
+      if (alias != nullptr) alias->push_back(token_index);
+    }
+  }
+
+  void MarkEscaped(const VarNode* var) {
+    auto it = var_alias_.find(var);
+    if (it == var_alias_.end()) return;
+    for (int token_index : it->second) {
+      result_.tokens[token_index].escaped = true;
+    }
+  }
+
+  void VisitExpr_(const VarNode* op) final { MarkEscaped(op); }
+
+  void VisitExpr_(const DataflowVarNode* op) final { MarkEscaped(op); }
+
+  /*! \brief The context IRModule. */
+  IRModule mod_;
+  /*! \brief The position of the binding being analyzed. */
+  int pos_ = 0;
+  /*! \brief The analysis result. */
+  StorageLiveness result_;
+  /*! \brief Map from a var to the tokens it may alias. */
+  std::unordered_map<const VarNode*, std::vector<int>> var_alias_;
+  /*! \brief Cache ops that need to be frequently used later to reduce lookup overhead. */
+  const Op& alloc_tensor_op_ = Op::Get("relax.builtin.alloc_tensor");
+  const Op& mem_alloc_storage_op_ = Op::Get("relax.memory.alloc_storage");
+  const Op& mem_alloc_tensor_op_ = Op::Get("relax.memory.alloc_tensor");
+  const Op& call_tir_dyn_op_ = Op::Get("relax.vm.call_tir_dyn");
+};
+
+StorageLiveness AnalyzeStorageLiveness(const Function& func, const IRModule& mod) {
+  return StorageLivenessAnalyzer(mod).Analyze(func);
+}
+
+}  // namespace relax
+}  // namespace tvm
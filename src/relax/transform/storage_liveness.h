@@ -0,0 +1,97 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * \file src/relax/transform/storage_liveness.h
+ * \brief Liveness analysis of the tensors and storages allocated in a Relax function.
+ */
+#ifndef TVM_RELAX_TRANSFORM_STORAGE_LIVENESS_H_
+#define TVM_RELAX_TRANSFORM_STORAGE_LIVENESS_H_
+
+#include <tvm/ir/module.h>
+#include <tvm/relax/expr.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace tvm {
+namespace relax {
+
+/*! \brief The allocation intrinsic a storage token comes from. */
+enum class StorageTokenKind : int {
+  /*! \brief relax.builtin.alloc_tensor */
+  kAllocTensor = 0,
+  /*! \brief relax.memory.alloc_tensor */
+  kMemAllocTensor = 1,
+  /*! \brief relax.memory.alloc_storage */
+  kMemAllocStorage = 2,
+};
+
+/*! \brief The liveness record of one allocation in a function body. */
+struct StorageToken {
+  /*! \brief The allocation intrinsic. */
+  StorageTokenKind kind;
+  /*! \brief The var bound to the allocation. */
+  Var var;
+  /*! \brief The other vars that may alias the allocation, in the order of their definition. */
+  std::vector<Var> aliases;
+  /*! \brief The binding position at which the allocation happens. */
+  int def_pos;
+  /*! \brief The binding position of the last use of the allocation. */
+  int last_use_pos;
+  /*! \brief Whether the allocation may be referenced outside of the analyzed scope. */
+  bool escaped{false};
+  /*! \brief Whether the size of the allocation is known at compile time. */
+  bool static_size{false};
+  /*! \brief The size of the allocation in bytes, valid when static_size is true. */
+  int64_t bytes{0};
+  /*! \brief The dtype of the allocation. */
+  DataType dtype;
+  /*! \brief The runtime device index of the allocation. */
+  int64_t device_index{-1};
+  /*! \brief The token of the storage a relax.memory.alloc_tensor is allocated from, or -1. */
+  int storage{-1};
+};
+
+/*! \brief The liveness of the allocations in a function body. */
+struct StorageLiveness {
+  /*! \brief The tokens, in the order of their definition. */
+  std::vector<StorageToken> tokens;
+  /*! \brief The binding var at each position of the linearized function body. */
+  std::vector<Var> binding_vars;
+};
+
+/*!
+ * \brief Compute the live interval of the allocations in the body of a function.
+ *
+ * The bindings of all the top-level blocks of the function body are linearized. A var carries
+ * the set of tokens it may alias through var bindings, tuples, tuple projections and packed
+ * function results. Using a var as an argument of a PrimFunc or a packed function extends the
+ * lifetime of the tokens it aliases; any other occurrence (function output, control flow,
+ * closures, calls to Relax functions, match_cast) marks them as escaped.
+ *
+ * \param func The function to analyze.
+ * \param mod The context IRModule, used to tell PrimFunc calls from Relax function calls.
+ * \return The liveness of the allocations.
+ */
+StorageLiveness AnalyzeStorageLiveness(const Function& func, const IRModule& mod);
+
+}  // namespace relax
+}  // namespace tvm
+
+#endif  // TVM_RELAX_TRANSFORM_STORAGE_LIVENESS_H_
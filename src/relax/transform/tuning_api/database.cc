@@ -23,9 +23,15 @@
  */
 #include <tvm/relax/tuning_api.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <set>
+#include <string>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "../../../meta_schedule/utils.h"
 
@@ -316,6 +322,450 @@ Database Database::JSONDatabase(String path_workload, String path_tuning_record,
   return Database(n);
 }
 
+/*! \brief The kinds of the entries of an indexed database. */
+enum class IndexedEntryKind : uint32_t {
+  kWorkload = 0,
+  kTuningRecord = 1,
+  kMeasurementRecord = 2,
+  kTarget = 3,
+};
+
+/*!
+ * \brief The header of both files of an indexed database. Compacting the database writes new
+ *  files of the next generation, so that a data file is never read through the index of another
+ *  generation.
+ */
+struct IndexedFileHeader {
+  /*! \brief The magic number of the files, which also identifies the version of the format. */
+  uint64_t magic;
+  /*! \brief The number of times the database has been compacted. */
+  uint64_t generation;
+};
+
+/*! \brief The magic number of the version 1 of the format of the indexed database files. */
+constexpr uint64_t kIndexedDatabaseMagic = 0x3130424458444e49;  // "INDXDB01"
+
+/*!
+ * \brief A fixed-size entry of the index file of an indexed database, which locates one payload
+ *  in the data file. The index file is read as a whole when the database is opened, without
+ *  parsing any of the payloads.
+ */
+struct IndexedEntry {
+  /*! \brief The kind of the entry, one of IndexedEntryKind. */
+  uint32_t kind;
+  /*! \brief The size of the payload in bytes. */
+  uint32_t size;
+  /*! \brief The offset of the payload in the data file. */
+  uint64_t offset;
+  /*! \brief The structural hash of a workload, or the index of the target of a record. */
+  uint64_t hash;
+  /*! \brief The index of the workload the entry belongs to. */
+  int64_t workload_idx;
+  /*! \brief The mean run seconds of a tuning record, which ranks it without loading it. */
+  double mean_run_secs;
+};
+
+/*!
+ * \brief A database which keeps an on-disk index keyed by workload and target next to an
+ *  append-only data file of compact JSON payloads. Opening the database only reads the index, and
+ *  a workload or record is parsed the first time it is queried. Only the top K tuning records of
+ *  each key are kept, in memory as well as on disk once the database is compacted.
+ */
+class IndexedDatabaseNode : public DatabaseNode {
+ public:
+  /*! \brief The directory holding the index and data files */
+  String path;
+  /*! \brief The number of tuning records kept for each pair of workload and target */
+  int top_k;
+
+  void VisitAttrs(tvm::AttrVisitor* v) {
+    v->Visit("path", &path);
+    v->Visit("top_k", &top_k);
+    // `workload_entries_` is not visited
+    // `workloads_` is not visited
+    // `target_entries_` is not visited
+    // `tuning_index_` is not visited
+    // `measurement_index_` is not visited
+  }
+
+  static constexpr const char* _type_key = "relax.tuning_api.IndexedDatabase";
+  TVM_DECLARE_FINAL_OBJECT_INFO(IndexedDatabaseNode, DatabaseNode);
+
+ public:
+  bool HasWorkload(const IRModule& mod) {
+    return FindWorkload(mod, tvm::StructuralHash()(mod)) != -1;
+  }
+
+  bool HasMeasurementRecord(const meta_schedule::Workload& workload, const Target& target) {
+    return measurement_index_.count(FindKey(workload, target)) > 0;
+  }
+
+  bool HasTuningRecord(const meta_schedule::Workload& workload, const Target& target) {
+    return tuning_index_.count(FindKey(workload, target)) > 0;
+  }
+
+  meta_schedule::Workload CommitWorkload(const IRModule& mod) {
+    size_t shash = tvm::StructuralHash()(mod);
+    int64_t workload_idx = FindWorkload(mod, shash);
+    if (workload_idx != -1) {
+      return workloads_[workload_idx].value();
+    }
+    meta_schedule::Workload workload(mod, shash);
+    workload_idx = static_cast<int64_t>(workloads_.size());
+    std::string payload = meta_schedule::JSONDumps(workload->AsJSON());
+    AddWorkloadEntry(Append(IndexedEntryKind::kWorkload, payload, shash, workload_idx, 0.0));
+    workloads_.back() = workload;
+    return workload;
+  }
+
+  void CommitMeasurementRecord(const meta_schedule::Workload& workload, const Target& target,
+                               const Array<FloatImm>& run_secs) {
+    int64_t target_idx = CommitTarget(target);
+    std::string key = GetKey(GetWorkloadIdx(workload), target_idx);
+    if (measurement_index_.count(key)) {
+      LOG(WARNING) << "Measurement record for " << key
+                   << " already exists. Use the existing one instead.";
+      return;
+    }
+    measurement_index_[key] =
+        Append(IndexedEntryKind::kMeasurementRecord, meta_schedule::JSONDumps(run_secs),
+               target_idx, GetWorkloadIdx(workload), 0.0);
+  }
+
+  void CommitTuningRecord(const meta_schedule::Workload& workload, const Target& target,
+                          const TuningRecord& record) {
+    double mean_run_secs = SortTuningRecordByMeanRunSecs::Mean(record->run_secs.value_or({}));
+    IndexedEntry entry = Append(IndexedEntryKind::kTuningRecord,
+                                meta_schedule::JSONDumps(record->AsJSON()), CommitTarget(target),
+                                GetWorkloadIdx(workload), mean_run_secs);
+    AddTuningEntry(entry);
+  }
+
+  Array<TuningRecord> GetTopK(const meta_schedule::Workload& workload, const Target& target,
+                              int top_k) {
+    CHECK_GE(top_k, 0) << "ValueError: top_k must be non-negative";
+    if (top_k == 0) {
+      return {};
+    }
+    auto it = tuning_index_.find(FindKey(workload, target));
+    if (it == tuning_index_.end()) {
+      return {};
+    }
+    const std::vector<IndexedEntry>& entries = it->second;
+    Array<TuningRecord> results;
+    results.reserve(std::min<size_t>(top_k, entries.size()));
+    for (size_t i = 0; i < entries.size() && static_cast<int>(i) < top_k; ++i) {
+      results.push_back(TuningRecord::FromJSON(ReadPayload(entries[i])));
+    }
+    return results;
+  }
+
+  Array<FloatImm> GetMeasurementRecord(const meta_schedule::Workload& workload,
+                                       const Target target) {
+    auto it = measurement_index_.find(FindKey(workload, target));
+    if (it == measurement_index_.end()) {
+      return {};
+    }
+    return meta_schedule::AsFloatArray(ReadPayload(it->second));
+  }
+
+  /*!
+   * \brief Rewrite the index and data files with only the entries still in use, i.e. the
+   *  targets, the workloads, the measurement records and the top K tuning records of each key.
+   */
+  void Compact() {
+    std::string data_path = DataPath(), index_path = IndexPath();
+    std::string tmp_data_path = data_path + ".tmp", tmp_index_path = index_path + ".tmp";
+    IndexedFileHeader header{kIndexedDatabaseMagic, generation_ + 1};
+    uint64_t offset = sizeof(IndexedFileHeader);
+    {
+      std::ifstream old_data(data_path, std::ios::in | std::ios::binary);
+      std::ofstream new_data(tmp_data_path, std::ios::out | std::ios::binary | std::ios::trunc);
+      std::ofstream new_index(tmp_index_path, std::ios::out | std::ios::binary | std::ios::trunc);
+      CHECK(new_data.good() && new_index.good())
+          << "ValueError: Cannot open the file to write: " << tmp_data_path;
+      new_data.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      new_index.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      std::string payload;
+      // Payloads are copied as raw bytes, none of them is parsed.
+      auto copy = [&](IndexedEntry* entry) {
+        payload.resize(entry->size);
+        old_data.seekg(entry->offset);
+        old_data.read(&payload[0], entry->size);
+        CHECK(old_data.good()) << "ValueError: Cannot read the file: " << data_path;
+        entry->offset = offset;
+        offset += entry->size;
+        new_data.write(payload.data(), entry->size);
+        new_index.write(reinterpret_cast<const char*>(entry), sizeof(IndexedEntry));
+      };
+      for (IndexedEntry& entry : target_entries_) {
+        copy(&entry);
+      }
+      for (IndexedEntry& entry : workload_entries_) {
+        copy(&entry);
+      }
+      for (auto& kv : tuning_index_) {
+        for (IndexedEntry& entry : kv.second) {
+          copy(&entry);
+        }
+      }
+      for (auto& kv : measurement_index_) {
+        copy(&kv.second);
+      }
+      CHECK(new_data.good() && new_index.good())
+          << "ValueError: Cannot write the file: " << tmp_data_path;
+    }
+    // The files of the new generation replace the old ones one after the other. If the process
+    // stops in between, LoadIndex finds the new index next to the new data file and completes it.
+    CHECK_EQ(std::rename(tmp_data_path.c_str(), data_path.c_str()), 0)
+        << "ValueError: Cannot write the file: " << data_path;
+    CHECK_EQ(std::rename(tmp_index_path.c_str(), index_path.c_str()), 0)
+        << "ValueError: Cannot write the file: " << index_path;
+    data_size_ = offset;
+    generation_ = header.generation;
+  }
+
+  /*!
+   * \brief Load the index of the database, without loading any workload or record.
+   * \param allow_missing Whether to create new files when they are not found.
+   */
+  void LoadIndex(bool allow_missing) {
+    std::ifstream data(DataPath(), std::ios::in | std::ios::binary | std::ios::ate);
+    std::ifstream index(IndexPath(), std::ios::in | std::ios::binary);
+    if (!data.good() || !index.good()) {
+      CHECK(allow_missing) << "ValueError: Database not found in: " << path;
+      IndexedFileHeader header{kIndexedDatabaseMagic, 0};
+      std::ofstream new_data(DataPath(), std::ios::out | std::ios::binary | std::ios::trunc);
+      std::ofstream new_index(IndexPath(), std::ios::out | std::ios::binary | std::ios::trunc);
+      CHECK(new_data.good() && new_index.good())
+          << "ValueError: Cannot create the database in: " << path;
+      new_data.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      new_index.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      data_size_ = sizeof(header);
+      generation_ = 0;
+      return;
+    }
+    data_size_ = static_cast<uint64_t>(data.tellg());
+    data.seekg(0);
+    IndexedFileHeader data_header = ReadHeader(&data, DataPath());
+    IndexedFileHeader index_header = ReadHeader(&index, IndexPath());
+    if (index_header.generation != data_header.generation) {
+      // A compaction stopped between the replacement of the data file and the one of the index.
+      std::string tmp_index_path = IndexPath() + ".tmp";
+      std::ifstream tmp_index(tmp_index_path, std::ios::in | std::ios::binary);
+      CHECK(tmp_index.good() &&
+            ReadHeader(&tmp_index, tmp_index_path).generation == data_header.generation)
+          << "ValueError: The index and data files of the database do not match in: " << path;
+      tmp_index.close();
+      index.close();
+      CHECK_EQ(std::rename(tmp_index_path.c_str(), IndexPath().c_str()), 0)
+          << "ValueError: Cannot write the file: " << IndexPath();
+      index.open(IndexPath(), std::ios::in | std::ios::binary);
+      index_header = ReadHeader(&index, IndexPath());
+    }
+    generation_ = data_header.generation;
+    IndexedEntry entry;
+    uint64_t index_size = sizeof(IndexedFileHeader);
+    uint64_t data_size = sizeof(IndexedFileHeader);
+    // A commit writes its payload before its index entry, so an interrupted commit leaves at most
+    // a torn last entry, an entry whose payload is incomplete, or a payload without an entry.
+    while (index.read(reinterpret_cast<char*>(&entry), sizeof(IndexedEntry))) {
+      if (entry.offset + entry.size > data_size_) break;
+      index_size += sizeof(IndexedEntry);
+      data_size = std::max<uint64_t>(data_size, entry.offset + entry.size);
+      switch (static_cast<IndexedEntryKind>(entry.kind)) {
+        case IndexedEntryKind::kTarget:
+          AddTargetEntry(entry, ReadBytes(entry));
+          break;
+        case IndexedEntryKind::kWorkload:
+          AddWorkloadEntry(entry);
+          break;
+        case IndexedEntryKind::kTuningRecord:
+          AddTuningEntry(entry);
+          break;
+        case IndexedEntryKind::kMeasurementRecord:
+          measurement_index_.emplace(GetKey(entry.workload_idx, entry.hash), entry);
+          break;
+        default:
+          LOG(FATAL) << "ValueError: Unknown entry kind " << entry.kind << " in " << IndexPath();
+      }
+    }
+    index.close();
+    data.close();
+    // Cut such a tail off both files. Otherwise the next commits are appended after it, which
+    // misaligns the following index entries, and the stale entry would read newer payloads.
+    TruncateFile(IndexPath(), index_size);
+    if (data_size != data_size_) {
+      TruncateFile(DataPath(), data_size);
+      data_size_ = data_size;
+    }
+  }
+
+ private:
+  std::string DataPath() const { return std::string(path) + "/data.bin"; }
+  std::string IndexPath() const { return std::string(path) + "/index.bin"; }
+
+  static void TruncateFile(const std::string& file_path, uint64_t size) {
+    std::error_code ec;
+    if (std::filesystem::file_size(file_path, ec) == size && !ec) return;
+    std::filesystem::resize_file(file_path, size, ec);
+    CHECK(!ec) << "ValueError: Cannot write the file: " << file_path << ": " << ec.message();
+  }
+
+  static IndexedFileHeader ReadHeader(std::istream* is, const std::string& file_path) {
+    IndexedFileHeader header;
+    is->read(reinterpret_cast<char*>(&header), sizeof(header));
+    CHECK(is->good() && header.magic == kIndexedDatabaseMagic)
+        << "ValueError: Not an indexed database file of a supported version: " << file_path;
+    return header;
+  }
+
+  // As in JSONDatabase, each target is treated separately. The records refer to their target by
+  // its index in the table of the target strings, so that the key can be built from the index.
+  static std::string GetKey(int64_t workload_idx, uint64_t target_idx) {
+    return std::to_string(workload_idx) + "/" + std::to_string(target_idx);
+  }
+
+  /*! \return The key of a workload and target, or an empty key if they have no record. */
+  std::string FindKey(const meta_schedule::Workload& workload, const Target& target) {
+    auto it = target2idx_.find(target->str());
+    if (it == target2idx_.end()) {
+      return "";
+    }
+    return GetKey(GetWorkloadIdx(workload), it->second);
+  }
+
+  /*! \return The index of the target, which is added to the database if it is not in it. */
+  int64_t CommitTarget(const Target& target) {
+    std::string target_str = target->str();
+    auto it = target2idx_.find(target_str);
+    if (it != target2idx_.end()) {
+      return it->second;
+    }
+    int64_t target_idx = static_cast<int64_t>(target_entries_.size());
+    AddTargetEntry(Append(IndexedEntryKind::kTarget, target_str, target_idx, -1, 0.0), target_str);
+    return target_idx;
+  }
+
+  void AddTargetEntry(const IndexedEntry& entry, const std::string& target_str) {
+    ICHECK_EQ(entry.hash, target_entries_.size());
+    target2idx_.emplace(target_str, static_cast<int64_t>(entry.hash));
+    target_entries_.push_back(entry);
+  }
+
+  /*! \return The index of the workload, or -1 if it is not in the database. */
+  int64_t FindWorkload(const IRModule& mod, size_t shash) {
+    auto range = workload_hash2idx_.equal_range(shash);
+    for (auto it = range.first; it != range.second; ++it) {
+      const meta_schedule::Workload& workload = LoadWorkload(it->second);
+      if (tvm::StructuralEqual()(workload->mod, mod)) {
+        return it->second;
+      }
+    }
+    return -1;
+  }
+
+  int64_t GetWorkloadIdx(const meta_schedule::Workload& workload) {
+    int64_t workload_idx = FindWorkload(workload->mod, workload->shash);
+    CHECK_NE(workload_idx, -1) << "ValueError: The workload is not in the database";
+    return workload_idx;
+  }
+
+  const meta_schedule::Workload& LoadWorkload(int64_t workload_idx) {
+    Optional<meta_schedule::Workload>& workload = workloads_[workload_idx];
+    if (!workload.defined()) {
+      workload = meta_schedule::Workload::FromJSON(ReadPayload(workload_entries_[workload_idx]));
+    }
+    return workload.value();
+  }
+
+  void AddWorkloadEntry(const IndexedEntry& entry) {
+    ICHECK_EQ(entry.workload_idx, static_cast<int64_t>(workload_entries_.size()));
+    workload_hash2idx_.emplace(entry.hash, entry.workload_idx);
+    workload_entries_.push_back(entry);
+    workloads_.push_back(NullOpt);
+  }
+
+  /*! \brief Insert a tuning record into the top K of its key, evicting the slowest one. */
+  void AddTuningEntry(const IndexedEntry& entry) {
+    std::vector<IndexedEntry>& entries = tuning_index_[GetKey(entry.workload_idx, entry.hash)];
+    auto it = std::upper_bound(entries.begin(), entries.end(), entry,
+                               [](const IndexedEntry& a, const IndexedEntry& b) {
+                                 return a.mean_run_secs < b.mean_run_secs;
+                               });
+    if (it - entries.begin() >= top_k) return;
+    entries.insert(it, entry);
+    if (static_cast<int>(entries.size()) > top_k) {
+      entries.pop_back();
+    }
+  }
+
+  IndexedEntry Append(IndexedEntryKind kind, const std::string& payload, uint64_t hash,
+                      int64_t workload_idx, double mean_run_secs) {
+    IndexedEntry entry;
+    entry.kind = static_cast<uint32_t>(kind);
+    entry.size = static_cast<uint32_t>(payload.size());
+    entry.offset = data_size_;
+    entry.hash = hash;
+    entry.workload_idx = workload_idx;
+    entry.mean_run_secs = mean_run_secs;
+    {
+      std::ofstream data(DataPath(), std::ios::out | std::ios::binary | std::ios::app);
+      CHECK(data.good()) << "ValueError: Cannot open the file to write: " << DataPath();
+      data.write(payload.data(), payload.size());
+    }
+    {
+      std::ofstream index(IndexPath(), std::ios::out | std::ios::binary | std::ios::app);
+      CHECK(index.good()) << "ValueError: Cannot open the file to write: " << IndexPath();
+      index.write(reinterpret_cast<const char*>(&entry), sizeof(IndexedEntry));
+    }
+    data_size_ += payload.size();
+    return entry;
+  }
+
+  std::string ReadBytes(const IndexedEntry& entry) {
+    std::ifstream data(DataPath(), std::ios::in | std::ios::binary);
+    CHECK(data.good()) << "ValueError: Cannot open the file: " << DataPath();
+    std::string payload(entry.size, '\0');
+    data.seekg(entry.offset);
+    data.read(&payload[0], entry.size);
+    CHECK(data.good()) << "ValueError: Cannot read the file: " << DataPath();
+    return payload;
+  }
+
+  ObjectRef ReadPayload(const IndexedEntry& entry) {
+    return meta_schedule::JSONLoads(ReadBytes(entry));
+  }
+
+  /*! \brief The size of the data file in bytes, header included */
+  uint64_t data_size_{0};
+  /*! \brief The generation of the files, incremented by each compaction */
+  uint64_t generation_{0};
+  /*! \brief The index entries of the target strings, by target index */
+  std::vector<IndexedEntry> target_entries_;
+  /*! \brief The target indices by target string */
+  std::unordered_map<std::string, int64_t> target2idx_;
+  /*! \brief The index entries of the workloads, by workload index */
+  std::vector<IndexedEntry> workload_entries_;
+  /*! \brief The workloads loaded so far, by workload index */
+  std::vector<Optional<meta_schedule::Workload>> workloads_;
+  /*! \brief The workload indices by structural hash */
+  std::unordered_multimap<uint64_t, int64_t> workload_hash2idx_;
+  /*! \brief The top K tuning records of each key, sorted by mean run seconds */
+  std::unordered_map<std::string, std::vector<IndexedEntry>> tuning_index_;
+  /*! \brief The measurement record of each key */
+  std::unordered_map<std::string, IndexedEntry> measurement_index_;
+};
+
+Database Database::IndexedDatabase(String path, int top_k, bool allow_missing) {
+  CHECK_GT(top_k, 0) << "ValueError: top_k must be positive";
+  ObjectPtr<IndexedDatabaseNode> n = make_object<IndexedDatabaseNode>();
+  n->path = path;
+  n->top_k = top_k;
+  n->LoadIndex(allow_missing);
+  return Database(n);
+}
+
 /**************** FFI ****************/
 TVM_REGISTER_NODE_TYPE(TuningRecordNode);
 TVM_REGISTER_GLOBAL("relax.tuning_api.TuningRecord")
@@ -346,5 +796,16 @@ TVM_REGISTER_GLOBAL("relax.tuning_api.DatabaseGetMeasurementRecord")
 
 TVM_REGISTER_NODE_TYPE(JSONDatabaseNode);
 TVM_REGISTER_GLOBAL("relax.tuning_api.DatabaseJSONDatabase").set_body_typed(Database::JSONDatabase);
+
+TVM_REGISTER_NODE_TYPE(IndexedDatabaseNode);
+TVM_REGISTER_GLOBAL("relax.tuning_api.DatabaseIndexedDatabase")
+    .set_body_typed(Database::IndexedDatabase);
+TVM_REGISTER_GLOBAL("relax.tuning_api.IndexedDatabaseCompact")
+    .set_body_typed([](Database db) {
+      auto* node = const_cast<IndexedDatabaseNode*>(db.as<IndexedDatabaseNode>());
+      CHECK(node != nullptr) << "TypeError: Expect an IndexedDatabase, but gets "
+                             << db->GetTypeKey();
+      node->Compact();
+    });
 }  // namespace relax
 }  // namespace tvm
@@ -31,12 +31,18 @@
 #include <tvm/runtime/profiling.h>
 #include <tvm/runtime/registry.h>
 #include <tvm/runtime/serializer.h>
+#include <tvm/runtime/threading_backend.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <numeric>
 #include <string>
+#include <thread>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -56,15 +62,179 @@ constexpr auto Is2DStorage = IsTextureStorage;
 }  // namespace details
 
 /*!
- * \brief Run all the operations one by one.
+ * \brief Run the operators on a fixed set of threads, each operator as soon as all the
+ *  operators it depends on are done.
+ */
+class GraphExecutor::InterOpScheduler {
+ public:
+  /*!
+   * \param cpus The ids of the cores the operators may use, split between the threads.
+   * \param num_groups The number of threads running the operators.
+   * \param threads_per_group The number of cores used by the operators run on each thread.
+   */
+  InterOpScheduler(const std::vector<unsigned int>& cpus, int num_groups, int threads_per_group) {
+    for (int i = 0; i < num_groups; ++i) {
+      std::vector<unsigned int> group_cpus;
+      for (int j = 0; j < threads_per_group; ++j) {
+        group_cpus.push_back(cpus[(i * threads_per_group + j) % cpus.size()]);
+      }
+      threads_.emplace_back([this, group_cpus] { this->RunWorker(group_cpus); });
+    }
+  }
+
+  ~InterOpScheduler() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      shutdown_ = true;
+    }
+    ready_cv_.notify_all();
+    for (std::thread& t : threads_) {
+      t.join();
+    }
+  }
+
+  /*!
+   * \brief Run the operators and wait for them to finish.
+   * \param op_execs The operator of each node, null for the nodes without operator.
+   * \param consumers The operators which depend on the operator of each node.
+   * \param num_producers The number of operators the operator of each node depends on.
+   */
+  void Run(const std::vector<std::function<void()>>& op_execs,
+           const std::vector<std::vector<uint32_t>>& consumers,
+           const std::vector<uint32_t>& num_producers) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    op_execs_ = &op_execs;
+    consumers_ = &consumers;
+    pending_producers_ = num_producers;
+    num_remaining_ = 0;
+    error_ = nullptr;
+    for (uint32_t nid = 0; nid < op_execs.size(); ++nid) {
+      if (!op_execs[nid]) continue;
+      ++num_remaining_;
+      if (num_producers[nid] == 0) ready_.push_back(nid);
+    }
+    ready_cv_.notify_all();
+    done_cv_.wait(lock, [this] {
+      return num_remaining_ == 0 || (error_ != nullptr && num_running_ == 0);
+    });
+    ready_.clear();
+    op_execs_ = nullptr;
+    consumers_ = nullptr;
+    if (error_ != nullptr) {
+      std::rethrow_exception(error_);
+    }
+  }
+
+ private:
+  void RunWorker(std::vector<unsigned int> cpus) {
+    // The thread pool of the intra-operator parallelism is local to each thread,
+    // restrict the one of this thread to its own cores.
+    threading::Configure(threading::ThreadGroup::kSpecifyOneCorePerThread, 0, cpus);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      ready_cv_.wait(lock, [this] { return shutdown_ || !ready_.empty(); });
+      if (shutdown_) return;
+      uint32_t nid = ready_.front();
+      ready_.pop_front();
+      ++num_running_;
+      lock.unlock();
+      std::exception_ptr error = nullptr;
+      try {
+        (*op_execs_)[nid]();
+      } catch (...) {
+        error = std::current_exception();
+      }
+      lock.lock();
+      --num_running_;
+      if (error != nullptr && error_ == nullptr) {
+        error_ = error;
+      }
+      if (error_ != nullptr) {
+        // Stop scheduling, and wait for the running operators to finish.
+        ready_.clear();
+        if (num_running_ == 0) done_cv_.notify_all();
+        continue;
+      }
+      for (uint32_t consumer : (*consumers_)[nid]) {
+        if (--pending_producers_[consumer] == 0) {
+          ready_.push_back(consumer);
+          ready_cv_.notify_one();
+        }
+      }
+      if (--num_remaining_ == 0) {
+        done_cv_.notify_all();
+      }
+    }
+  }
+
+  /*! \brief The threads running the operators. */
+  std::vector<std::thread> threads_;
+  /*! \brief Protects all the states below. */
+  std::mutex mutex_;
+  /*! \brief Notified when an operator is ready to run, or on shutdown. */
+  std::condition_variable ready_cv_;
+  /*! \brief Notified when all the operators are done, or when the run failed. */
+  std::condition_variable done_cv_;
+  /*! \brief The operators of the current run. */
+  const std::vector<std::function<void()>>* op_execs_{nullptr};
+  /*! \brief The consumers of each operator of the current run. */
+  const std::vector<std::vector<uint32_t>>* consumers_{nullptr};
+  /*! \brief The number of producers of each operator which are not done yet. */
+  std::vector<uint32_t> pending_producers_;
+  /*! \brief The operators ready to run. */
+  std::deque<uint32_t> ready_;
+  /*! \brief The number of operators which are not done yet. */
+  size_t num_remaining_{0};
+  /*! \brief The number of operators which are running. */
+  size_t num_running_{0};
+  /*! \brief The first error thrown by an operator of the current run. */
+  std::exception_ptr error_{nullptr};
+  /*! \brief Whether the threads should exit. */
+  bool shutdown_{false};
+};
+
+GraphExecutor::~GraphExecutor() = default;
+
+/*!
+ * \brief Run all the operations one by one, or concurrently when the inter-operator
+ *  parallelism is enabled.
  */
 void GraphExecutor::Run() {
+  if (inter_op_scheduler_ != nullptr) {
+    inter_op_scheduler_->Run(op_execs_, op_consumers_, op_num_producers_);
+    return;
+  }
   // setup the array and requirements.
   for (size_t i = 0; i < op_execs_.size(); ++i) {
     if (op_execs_[i]) op_execs_[i]();
   }
 }
 
+void GraphExecutor::SetInterOpParallelism(int num_groups) {
+  inter_op_scheduler_.reset();
+  if (num_groups <= 1) return;
+  for (const Device& dev : devices_) {
+    if (dev.device_type != kDLCPU) {
+      // The operators only enqueue the kernels on the other devices, the order of their
+      // streams is not preserved across threads.
+      LOG(WARNING) << "The inter-operator parallelism is only supported on CPU, "
+                   << "running the operators in order";
+      return;
+    }
+  }
+  // Split the cores the threading backend uses for this thread, which follow the affinity mask
+  // of the process and the configuration of the thread pool.
+  std::vector<unsigned int> cpus = threading::GetCpuIds();
+  int num_cpus = static_cast<int>(cpus.size());
+  num_groups = std::min(num_groups, num_cpus);
+  if (num_groups <= 1) return;
+  int threads_per_group = num_cpus / num_groups;
+  if (op_consumers_.empty()) {
+    this->SetupOpDependencies();
+  }
+  inter_op_scheduler_ = std::make_unique<InterOpScheduler>(cpus, num_groups, threads_per_group);
+}
+
 /*!
  * \brief Initialize the graph executor with graph and device.
  * \param graph_json The execution graph.
@@ -521,6 +691,50 @@ void GraphExecutor::SetupOpExecs() {
   }
 }
 
+void GraphExecutor::SetupOpDependencies() {
+  op_consumers_.assign(this->GetNumOfNodes(), {});
+  op_num_producers_.assign(this->GetNumOfNodes(), 0);
+  // The last operator which wrote each storage, and the operators which read it since.
+  std::unordered_map<int, uint32_t> last_writer;
+  std::unordered_map<int, std::vector<uint32_t>> readers;
+  std::vector<uint32_t> producers;
+  for (uint32_t nid = 0; nid < this->GetNumOfNodes(); ++nid) {
+    if (!op_execs_[nid]) continue;
+    const auto& inode = nodes_[nid];
+    producers.clear();
+    for (const auto& e : inode.inputs) {
+      if (op_execs_[e.node_id]) producers.push_back(e.node_id);
+      int sid = attrs_.storage_id[this->entry_id(e)];
+      auto it = last_writer.find(sid);
+      if (it != last_writer.end()) producers.push_back(it->second);
+    }
+    for (uint32_t index = 0; index < inode.param.num_outputs; ++index) {
+      int sid = attrs_.storage_id[this->entry_id(nid, index)];
+      auto it = last_writer.find(sid);
+      if (it != last_writer.end()) producers.push_back(it->second);
+      for (uint32_t reader : readers[sid]) {
+        producers.push_back(reader);
+      }
+    }
+    // Register the reads after the writes, an operator may read and write the same storage.
+    for (const auto& e : inode.inputs) {
+      readers[attrs_.storage_id[this->entry_id(e)]].push_back(nid);
+    }
+    for (uint32_t index = 0; index < inode.param.num_outputs; ++index) {
+      int sid = attrs_.storage_id[this->entry_id(nid, index)];
+      last_writer[sid] = nid;
+      readers[sid].clear();
+    }
+    std::sort(producers.begin(), producers.end());
+    producers.erase(std::unique(producers.begin(), producers.end()), producers.end());
+    for (uint32_t producer : producers) {
+      if (producer == nid) continue;
+      op_consumers_[producer].push_back(nid);
+      ++op_num_producers_[nid];
+    }
+  }
+}
+
 std::pair<std::function<void()>, std::shared_ptr<GraphExecutor::OpArgs>> GraphExecutor::CreateTVMOp(
     const TVMOpParam& param, const std::vector<DLTensor>& args) {
   std::shared_ptr<GraphExecutor::OpArgs> arg_ptr = std::make_shared<GraphExecutor::OpArgs>();
@@ -629,6 +843,10 @@ PackedFunc GraphExecutor::GetFunction(const std::string& name,
         [sptr_to_self, this](TVMArgs args, TVMRetValue* rv) { *rv = this->NumInputs(); });
   } else if (name == "run") {
     return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) { this->Run(); });
+  } else if (name == "set_inter_op_parallelism") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      this->SetInterOpParallelism(args[0]);
+    });
   } else if (name == "run_from_inputs") {
     return PackedFunc(
         [sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
@@ -71,10 +71,13 @@ class TVM_DLL GraphExecutor : public ModuleNode {
     std::vector<int> arg_tcodes;
     std::vector<int64_t> shape_data;
   };
+  class InterOpScheduler;
 
  public:
   using ShapeInfo = Map<String, ObjectRef>;
   using DtypeInfo = Map<String, ObjectRef>;
+
+  ~GraphExecutor();
   /*!
    * \brief Get member function to front-end
    * \param name The name of the function.
@@ -89,6 +92,19 @@ class TVM_DLL GraphExecutor : public ModuleNode {
   const char* type_key() const final { return "GraphExecutor"; }
   void Run();
 
+  /*!
+   * \brief Set the number of operators which can run concurrently in Run.
+   *
+   *  Operators are scheduled as soon as all of their producers are done, on one of
+   *  num_groups threads. Each of these threads uses its own group of cores for the
+   *  intra-operator parallelism, so that the groups do not compete with each other. The
+   *  groups split the cores of threading::GetCpuIds, i.e. the ones given to config_threadpool
+   *  or else the cores of the affinity mask of the process.
+   *
+   * \param num_groups The number of thread groups, 0 or 1 to run the operators in order.
+   */
+  void SetInterOpParallelism(int num_groups);
+
   /*!
    * \brief Initialize the graph executor with graph and device.
    * \param graph_json The execution graph.
@@ -415,6 +431,13 @@ class TVM_DLL GraphExecutor : public ModuleNode {
   void SetupStorage();
   /*! \brief Setup the executors. */
   void SetupOpExecs();
+  /*!
+   * \brief Setup the dependencies between the operators, for the inter-operator parallelism.
+   *
+   *  Besides the data dependencies, an operator writing a storage shared with other entries
+   *  must wait for the operators which read or write the previous entries of this storage.
+   */
+  void SetupOpDependencies();
   /*!
    * \brief Check the legality of external DLTensor*.
    * \param external The external DLTensor*.
@@ -469,6 +492,12 @@ class TVM_DLL GraphExecutor : public ModuleNode {
   std::vector<size_t> data_alignment_;
   /*! \brief Operator on each node. */
   std::vector<std::function<void()>> op_execs_;
+  /*! \brief The operators which depend on the operator of each node. */
+  std::vector<std::vector<uint32_t>> op_consumers_;
+  /*! \brief The number of operators the operator of each node depends on. */
+  std::vector<uint32_t> op_num_producers_;
+  /*! \brief The scheduler of the operators when running them concurrently. */
+  std::unique_ptr<InterOpScheduler> inter_op_scheduler_;
   /*! \brief Linked parameter lookup function. */
   PackedFunc lookup_linked_param_;
   /*! \brief Module's _lookup_linked_param function, used by DefaultLookupLinkedParam. */
@@ -31,20 +31,73 @@
 #include <tvm/runtime/relax_vm/memory_manager.h>
 #include <tvm/runtime/relax_vm/vm.h>
 
+#include <deque>
+#include <vector>
+
 namespace tvm {
 namespace runtime {
 namespace relax_vm {
 
 using tvm::runtime::NDArray;
 
+/*!
+ * \brief Argument buffers reused by the calls of a builtin on a thread, so that forwarding
+ *  the arguments does not allocate. One buffer is kept per nesting depth, a call re-entering
+ *  the builtin does not clobber the arguments of the outer call.
+ */
+class ArgBufferStack {
+ private:
+  struct Buffer {
+    std::vector<TVMValue> values;
+    std::vector<int> tcodes;
+  };
+
+ public:
+  /*! \brief A buffer in use until the scope is destroyed. */
+  class Scope {
+   public:
+    Scope(ArgBufferStack* stack, size_t num_args) : stack_(stack) {
+      if (stack_->depth_ == stack_->buffers_.size()) {
+        stack_->buffers_.emplace_back();
+      }
+      buffer_ = &stack_->buffers_[stack_->depth_++];
+      buffer_->values.resize(num_args);
+      buffer_->tcodes.resize(num_args);
+    }
+    ~Scope() { --stack_->depth_; }
+
+    TVMValue* values() { return buffer_->values.data(); }
+    int* tcodes() { return buffer_->tcodes.data(); }
+    TVMArgs args() const {
+      return TVMArgs(buffer_->values.data(), buffer_->tcodes.data(), buffer_->values.size());
+    }
+
+   private:
+    ArgBufferStack* stack_;
+    Buffer* buffer_;
+  };
+
+ private:
+  /*! \brief The buffers, a deque so that growing it keeps the buffers in use in place. */
+  std::deque<Buffer> buffers_;
+  /*! \brief The number of buffers in use. */
+  size_t depth_{0};
+};
+
 TVM_REGISTER_GLOBAL("vm.builtin.shape_of").set_body_method(&NDArray::Shape);
 
 TVM_REGISTER_GLOBAL("vm.builtin.copy").set_body_typed([](NDArray src) { return src; });
 
+// Used to clear the register of a killed storage or tensor, releasing its reference.
+TVM_REGISTER_GLOBAL("vm.builtin.null_value").set_body([](TVMArgs args, TVMRetValue* rv) {
+  *rv = nullptr;
+});
+
 TVM_REGISTER_GLOBAL("vm.builtin.alloc_shape_heap")
     .set_body_typed([](void* vm_ptr, ShapeTuple size) {
       VirtualMachine* vm = static_cast<VirtualMachine*>(vm_ptr);
-      return NDArray::Empty(size, DLDataType{kDLInt, 64, 1}, vm->devices[0]);
+      // The heap is only accessed by the host, through the shape functions and the builtins.
+      return NDArray::Empty(size, DLDataType{kDLInt, 64, 1}, vm->GetDevice(-1));
     });
 
 TVM_REGISTER_GLOBAL("vm.builtin.alloc_closure").set_body([](TVMArgs args, TVMRetValue* rv) {
@@ -63,46 +116,46 @@ TVM_REGISTER_GLOBAL("vm.builtin.invoke_closure").set_body([](TVMArgs args, TVMRe
   void* vm_ptr = args[0];
   VirtualMachine* vm = static_cast<VirtualMachine*>(vm_ptr);
   VMClosure vm_closure = args[1];
-  runtime::String func_name = vm_closure->func_name;
+  const runtime::String& func_name = vm_closure->func_name;
 
-  PackedFunc func{nullptr};
-  func = vm->GetFunction(func_name, GetObjectPtr<Object>(vm));
+  PackedFunc func = vm->GetFuncByName(func_name);
   ICHECK(func != nullptr) << "cannot find closure " << func_name;
 
   // get closure free_vars
-  Array<ObjectRef> cap_vars = vm_closure->free_vars;
+  const Array<ObjectRef>& cap_vars = vm_closure->free_vars;
   size_t num_tensor_args = args.size() - 2;
-  std::vector<TVMValue> values(num_tensor_args + cap_vars.size());
-  std::vector<int> tcodes(num_tensor_args + cap_vars.size());
+  static thread_local ArgBufferStack arg_buffers;
+  ArgBufferStack::Scope buffer(&arg_buffers, num_tensor_args + cap_vars.size());
 
-  runtime::TVMArgsSetter setter(values.data(), tcodes.data());
+  // The arguments are forwarded as is, they outlive the call.
   for (size_t i = 0; i < num_tensor_args; i++) {
-    NDArray arg = args[i + 2];
-    setter(i, arg);
+    buffer.values()[i] = args.values[i + 2];
+    buffer.tcodes()[i] = args.type_codes[i + 2];
   }
+  runtime::TVMArgsSetter setter(buffer.values(), buffer.tcodes());
   for (size_t i = 0; i < cap_vars.size(); i++) {
     setter(i + num_tensor_args, cap_vars[i]);
   }
-  TVMArgs func_args(values.data(), tcodes.data(), values.size());
-  func.CallPacked(func_args, rv);
+  func.CallPacked(buffer.args(), rv);
 });
 
 TVM_REGISTER_GLOBAL("vm.builtin.store_shape")
     .set_body_typed([](ShapeTuple shape, NDArray heap, ShapeTuple indexes) {
-      int64_t* heap_data = reinterpret_cast<int64_t*>(heap.ToDLPack()->dl_tensor.data);
+      int64_t* heap_data = static_cast<int64_t*>(heap->data);
       for (size_t i = 0; i < indexes.size(); ++i) {
         int64_t heap_idx = indexes[i];
-        ICHECK(heap_idx >= 0 && heap_idx < heap.Shape()[0]);
+        ICHECK(heap_idx >= 0 && heap_idx < heap->shape[0]);
         heap_data[heap_idx] = shape[i];
       }
     });
 
 TVM_REGISTER_GLOBAL("vm.builtin.load_shape").set_body_typed([](NDArray heap, ShapeTuple indexes) {
-  int64_t* heap_data = reinterpret_cast<int64_t*>(heap.ToDLPack()->dl_tensor.data);
+  const int64_t* heap_data = static_cast<const int64_t*>(heap->data);
   std::vector<int64_t> shape;
+  shape.reserve(indexes.size());
   for (size_t i = 0; i < indexes.size(); ++i) {
     int64_t heap_idx = indexes[i];
-    ICHECK(heap_idx >= 0 && heap_idx < heap.Shape()[0]);
+    ICHECK(heap_idx >= 0 && heap_idx < heap->shape[0]);
     shape.push_back(heap_data[heap_idx]);
   }
   return ShapeTuple(shape);
@@ -114,13 +167,12 @@ TVM_REGISTER_GLOBAL("vm.builtin.alloc_storage")
       ICHECK_EQ(buffer_size.size(), 1);
       int alignment = runtime::kAllocAlignment;
       VirtualMachine* vm = static_cast<VirtualMachine*>(vm_ptr);
-      ICHECK_LT(device_index, vm->devices.size())
-          << "The device index is out of VM physical devices list";
-
       if (device_index == -1) {
         // Allocate on host. Host is always the last element of vm->devices.
         device_index = vm->devices.size() - 1;
       }
+      ICHECK(device_index >= 0 && device_index < static_cast<Index>(vm->devices.size()))
+          << "The device index " << device_index << " is out of VM physical devices list";
 
       int64_t size_imm = buffer_size[0];
 
@@ -134,6 +186,33 @@ TVM_REGISTER_GLOBAL("vm.builtin.alloc_storage")
 
 TVM_REGISTER_GLOBAL("vm.builtin.alloc_tensor").set_body_method<Storage>(&StorageObj::AllocNDArray);
 
+TVM_REGISTER_GLOBAL("vm.builtin.to_device")
+    .set_body_typed([](void* vm_ptr, NDArray data, Index device_index) {
+      VirtualMachine* vm = static_cast<VirtualMachine*>(vm_ptr);
+      Device dev = vm->GetDevice(device_index);
+      Device src = data->device;
+      if (src.device_type == dev.device_type && src.device_id == dev.device_id) {
+        return data;
+      }
+      NDArray out = NDArray::Empty(data.Shape(), data->dtype, dev);
+      if (src.device_type == kDLCPU) {
+        // Enqueued after the work of the destination device, the host data is ready.
+        NDArray::CopyFromTo(data.operator->(), out.operator->(), vm->GetStream(dev));
+        return out;
+      }
+      TVMStreamHandle src_stream = vm->GetStream(src);
+      NDArray::CopyFromTo(data.operator->(), out.operator->(), src_stream);
+      TVMStreamHandle dst_stream = vm->GetStream(dev);
+      if (src.device_type == dev.device_type && (src_stream != nullptr || dst_stream != nullptr)) {
+        // The destination stream waits for the copy through an event, the host does not.
+        DeviceAPI::Get(src)->SyncStreamFromTo(src, src_stream, dst_stream);
+      } else {
+        // The host, or another type of device, reads the copy.
+        DeviceAPI::Get(src)->StreamSync(src, src_stream);
+      }
+      return out;
+    });
+
 TVM_REGISTER_GLOBAL("vm.binary_broadcast_shape_infer")
     .set_body_typed([](ShapeTuple lhs_shape, ShapeTuple rhs_shape) {
       std::vector<int64_t> output_shape;
@@ -159,31 +238,24 @@ TVM_REGISTER_GLOBAL("vm.call_tir_dyn").set_body([](TVMArgs args, TVMRetValue* rv
   VirtualMachine* vm = static_cast<VirtualMachine*>(vm_ptr);
   runtime::String func_name = args[1];
 
-  PackedFunc func{nullptr};
-  if (vm->lib.defined()) {
-    func = vm->lib.value()->GetFunction(func_name, true);
-  }
-  if (!func.defined()) {
-    const PackedFunc* p_func = Registry::Get(func_name);
-    CHECK(p_func != nullptr);
-    func = *(p_func);
-  }
+  PackedFunc func = vm->GetFuncByName(func_name);
+  CHECK(func != nullptr) << "cannot find kernel " << func_name;
 
   ShapeTuple to_unpack = args[args.size() - 1];
   size_t num_tensor_args = args.size() - 3;
-  std::vector<TVMValue> values(num_tensor_args + to_unpack.size());
-  std::vector<int> tcodes(num_tensor_args + to_unpack.size());
-  runtime::TVMArgsSetter setter(values.data(), tcodes.data());
+  static thread_local ArgBufferStack arg_buffers;
+  ArgBufferStack::Scope buffer(&arg_buffers, num_tensor_args + to_unpack.size());
+
+  // The tensors are forwarded as is, they outlive the call.
   for (size_t i = 0; i < num_tensor_args; i++) {
-    NDArray arg = args[i + 2];
-    setter(i, arg);
+    buffer.values()[i] = args.values[i + 2];
+    buffer.tcodes()[i] = args.type_codes[i + 2];
   }
+  runtime::TVMArgsSetter setter(buffer.values(), buffer.tcodes());
   for (size_t i = 0; i < to_unpack.size(); i++) {
     setter(i + num_tensor_args, to_unpack[i]);
   }
-
-  TVMArgs func_args(values.data(), tcodes.data(), values.size());
-  func.CallPacked(func_args, rv);
+  func.CallPacked(buffer.args(), rv);
 });
 
 TVM_REGISTER_GLOBAL("vm.runtime.TupleGetItem")
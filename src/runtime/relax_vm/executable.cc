@@ -22,14 +22,20 @@
  */
 
 #include <dmlc/memory_io.h>
+#include <tvm/runtime/device_api.h>
 #include <tvm/runtime/logging.h>
+#include <tvm/runtime/ndarray.h>
 #include <tvm/runtime/relax_vm/executable.h>
 #include <tvm/runtime/relax_vm/vm.h>
 
+#include <cstring>
+#include <fstream>
 #include <functional>
+#include <memory>
 #include <sstream>
 
 #include "../file_utils.h"
+#include "./mapped_file.h"
 
 namespace tvm {
 namespace runtime {
@@ -37,6 +43,13 @@ namespace relax_vm {
 
 /*! \brief The magic number for the serialized VM bytecode file  */
 constexpr uint64_t kTVMVMBytecodeMagic = 0xD225DE2F4214151D;
+/*!
+ * \brief The version of the layout of the sections, saved after the magic number. It is bumped
+ *  whenever the layout changes, the VM only loads the executables saved in its own layout.
+ */
+constexpr uint64_t kTVMVMBytecodeFormatVersion = 1;
+/*! \brief The alignment of the constant data section in the file, a page. */
+constexpr size_t kConstantSectionAlignment = 4096;
 
 /*! \brief Possible types in the constant pool */
 enum ConstantType : int {
@@ -45,8 +58,41 @@ enum ConstantType : int {
   kShapeTuple = 2,
   kString = 3,
   kInt = 4,
+  // An NDArray whose data is stored in the constant data section of the file.
+  kNDArrayRef = 5,
+};
+
+inline size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+/*! \brief An NDArray constant viewing a mapped file, which stays mapped while it is alive. */
+struct MappedNDArray {
+  DLManagedTensor managed;
+  std::vector<int64_t> shape;
+  std::shared_ptr<MappedFile> file;
 };
 
+NDArray MapNDArray(const std::shared_ptr<MappedFile>& file, size_t offset, DLDataType dtype,
+                   std::vector<int64_t> shape) {
+  MappedNDArray* view = new MappedNDArray();
+  view->shape = std::move(shape);
+  view->file = file;
+  DLTensor& tensor = view->managed.dl_tensor;
+  tensor.data = file->data() + offset;
+  tensor.device = Device{kDLCPU, 0};
+  tensor.ndim = static_cast<int>(view->shape.size());
+  tensor.dtype = dtype;
+  tensor.shape = view->shape.data();
+  tensor.strides = nullptr;
+  tensor.byte_offset = 0;
+  view->managed.manager_ctx = view;
+  view->managed.deleter = [](DLManagedTensor* self) {
+    delete static_cast<MappedNDArray*>(self->manager_ctx);
+  };
+  return NDArray::FromDLPack(&view->managed);
+}
+
 #define STREAM_CHECK(val, section)                                          \
   ICHECK(val) << "Invalid VM file format in the " << section << " section." \
               << "\n";
@@ -193,6 +239,8 @@ Instruction Executable::GetInstruction(Index i) const {
 void SaveHeader(dmlc::Stream* strm) {
   uint64_t header = kTVMVMBytecodeMagic;
   strm->Write(header);
+  uint64_t format_version = kTVMVMBytecodeFormatVersion;
+  strm->Write(format_version);
   std::string version = TVM_VERSION;
   strm->Write(version);
 }
@@ -203,6 +251,14 @@ void LoadHeader(dmlc::Stream* strm) {
   STREAM_CHECK(strm->Read(&header), "header");
   STREAM_CHECK(header == kTVMVMBytecodeMagic, "header");
 
+  // Check format version.
+  uint64_t format_version;
+  STREAM_CHECK(strm->Read(&format_version), "format version");
+  CHECK_EQ(format_version, kTVMVMBytecodeFormatVersion)
+      << "The VM executable was saved in format version " << format_version
+      << ", but this VM loads format version " << kTVMVMBytecodeFormatVersion
+      << ". Please build the executable again.";
+
   // Check version.
   std::string version;
   STREAM_CHECK(strm->Read(&version), "version");
@@ -233,11 +289,40 @@ void Executable::SaveToBinary(dmlc::Stream* stream) {
 }
 
 void Executable::SaveToFile(const std::string& file_name, const std::string& format) {
+#if DMLC_IO_NO_ENDIAN_SWAP
+  // Layout: magic, size of the metadata, the metadata (the sections of SaveToBinary with the
+  // NDArray data left out), padding to a page, and the data section of the NDArray constants.
+  // The binary of SaveToBinary starts with its size instead of the magic.
+  std::string meta;
+  std::string data_section;
+  dmlc::MemoryStringStream strm(&meta);
+  SaveHeader(&strm);
+  SaveGlobalSection(&strm);
+  SaveConstantSection(&strm, &data_section);
+  SavePackedFuncNames(&strm);
+  SaveCodeSection(&strm);
+
+  std::ofstream fs(file_name, std::ios::out | std::ios::binary);
+  ICHECK(!fs.fail()) << "Cannot open " << file_name;
+  uint64_t magic = kTVMVMBytecodeMagic;
+  uint64_t meta_size = meta.size();
+  fs.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+  fs.write(reinterpret_cast<const char*>(&meta_size), sizeof(meta_size));
+  fs.write(meta.data(), meta.size());
+  size_t meta_end = sizeof(magic) + sizeof(meta_size) + meta.size();
+  std::string padding(AlignUp(meta_end, kConstantSectionAlignment) - meta_end, '\0');
+  fs.write(padding.data(), padding.size());
+  fs.write(data_section.data(), data_section.size());
+  ICHECK(!fs.fail()) << "Cannot write " << file_name;
+#else
+  // The constant data section is in the host byte order, which big-endian hosts do not share
+  // with the serialized format.
   std::string data;
   dmlc::MemoryStringStream writer(&data);
   dmlc::SeekStream* strm = &writer;
   Executable::SaveToBinary(strm);
   runtime::SaveBinaryToFile(file_name, data);
+#endif
 }
 
 Module Executable::LoadFromBinary(void* stream) {
@@ -269,11 +354,45 @@ TVM_REGISTER_GLOBAL("runtime.module.loadbinary_relax.Executable")
     .set_body_typed(Executable::LoadFromBinary);
 
 Module Executable::LoadFromFile(const std::string& file_name) {
-  std::string data;
-  runtime::LoadBinaryFromFile(file_name, &data);
-  dmlc::MemoryStringStream reader(&data);
-  dmlc::Stream* strm = &reader;
-  return Executable::LoadFromBinary(reinterpret_cast<void*>(strm));
+  std::shared_ptr<MappedFile> file = MappedFile::Open(file_name);
+  uint64_t magic = 0;
+  if (file->size() >= sizeof(magic)) {
+    std::memcpy(&magic, file->data(), sizeof(magic));
+  }
+  if (magic != kTVMVMBytecodeMagic) {
+    // The file holds the binary written by SaveToBinary.
+    std::string data(file->data(), file->size());
+    dmlc::MemoryStringStream reader(&data);
+    dmlc::Stream* strm = &reader;
+    return Executable::LoadFromBinary(reinterpret_cast<void*>(strm));
+  }
+
+  uint64_t meta_size;
+  size_t meta_begin = sizeof(magic) + sizeof(meta_size);
+  STREAM_CHECK(file->size() >= meta_begin, "header");
+  std::memcpy(&meta_size, file->data() + sizeof(magic), sizeof(meta_size));
+  STREAM_CHECK(meta_size <= file->size() - meta_begin, "header");
+  dmlc::MemoryFixedSizeStream strm(file->data() + meta_begin, meta_size);
+
+  ObjectPtr<Executable> exec = make_object<Executable>();
+
+  // Load header.
+  LoadHeader(&strm);
+
+  // Global section.
+  exec->LoadGlobalSection(&strm);
+
+  // Constant section, the NDArray constants view the mapped data section.
+  exec->LoadConstantSection(&strm, file,
+                            AlignUp(meta_begin + meta_size, kConstantSectionAlignment));
+
+  // Packedfunc names section.
+  exec->LoadPackedFuncNames(&strm);
+
+  // Code section.
+  exec->LoadCodeSection(&strm);
+
+  return Module(exec);
 }
 
 TVM_REGISTER_GLOBAL("runtime.module.loadfile_relax.Executable")
@@ -285,6 +404,7 @@ void SerializeVMFunc(const VMFunction& func, dmlc::Stream* strm) {
   strm->Write(func.num_args);
   strm->Write(func.register_file_size);
   strm->Write(func.param_names);
+  strm->Write(func.param_device_indexes);
 }
 
 VMFunction DeserializeVMFunc(dmlc::Stream* strm) {
@@ -294,6 +414,9 @@ VMFunction DeserializeVMFunc(dmlc::Stream* strm) {
   STREAM_CHECK(strm->Read(&func.num_args), "vmfunc num_args");
   STREAM_CHECK(strm->Read(&func.register_file_size), "vmfunc register_file_size");
   STREAM_CHECK(strm->Read(&func.param_names), "vmfunc params");
+  STREAM_CHECK(strm->Read(&func.param_device_indexes), "vmfunc param device indexes");
+  STREAM_CHECK(func.param_device_indexes.size() == func.param_names.size(),
+               "vmfunc param device indexes");
   return func;
 }
 
@@ -304,10 +427,23 @@ void Executable::SaveGlobalSection(dmlc::Stream* strm) {
   }
 }
 
-void Executable::SaveConstantSection(dmlc::Stream* strm) {
+void Executable::SaveConstantSection(dmlc::Stream* strm, std::string* data_section) {
   strm->Write(static_cast<uint64_t>(this->constants.size()));
   for (const auto& it : this->constants) {
-    if (it.IsObjectRef<runtime::NDArray>()) {
+    if (it.IsObjectRef<runtime::NDArray>() && data_section != nullptr) {
+      runtime::NDArray array = it.operator runtime::NDArray();
+      size_t nbytes = GetDataSize(*array.operator->());
+      // Align the data as the allocations of NDArray, so that it can be viewed in place.
+      size_t offset = AlignUp(data_section->size(), kAllocAlignment);
+      data_section->resize(offset + nbytes);
+      array.CopyToBytes(&(*data_section)[offset], nbytes);
+      ShapeTuple shape = array.Shape();
+      strm->Write(ConstantType::kNDArrayRef);
+      strm->Write(array->dtype);
+      strm->Write(std::vector<int64_t>(shape.begin(), shape.end()));
+      strm->Write(static_cast<uint64_t>(offset));
+      strm->Write(static_cast<uint64_t>(nbytes));
+    } else if (it.IsObjectRef<runtime::NDArray>()) {
       strm->Write(ConstantType::kNDArray);
       runtime::SaveDLTensor(strm, it.operator DLTensor*());
     } else if (it.IsObjectRef<ShapeTuple>()) {
@@ -337,6 +473,8 @@ void Executable::SaveConstantSection(dmlc::Stream* strm) {
       }
     }
   }
+  ICHECK_EQ(this->const_device_indexes.size(), this->constants.size());
+  strm->Write(this->const_device_indexes);
 }
 
 void Executable::SavePackedFuncNames(dmlc::Stream* strm) { strm->Write(func_names); }
@@ -359,7 +497,8 @@ void Executable::LoadGlobalSection(dmlc::Stream* strm) {
   }
 }
 
-void Executable::LoadConstantSection(dmlc::Stream* strm) {
+void Executable::LoadConstantSection(dmlc::Stream* strm, const std::shared_ptr<MappedFile>& file,
+                                     size_t data_section_offset) {
   uint64_t sz;
   // Load the number of constants.
   STREAM_CHECK(strm->Read(&sz, sizeof(sz)), "constant");
@@ -376,6 +515,18 @@ void Executable::LoadConstantSection(dmlc::Stream* strm) {
       TVMRetValue cell;
       cell = ndarray;
       this->constants.push_back(cell);
+    } else if (constant_type == ConstantType::kNDArrayRef) {
+      std::vector<int64_t> shape;
+      uint64_t offset, nbytes;
+      STREAM_CHECK(strm->Read(&dtype), "constant");
+      STREAM_CHECK(strm->Read(&shape), "constant");
+      STREAM_CHECK(strm->Read(&offset), "constant");
+      STREAM_CHECK(strm->Read(&nbytes), "constant");
+      STREAM_CHECK(file != nullptr, "constant");
+      STREAM_CHECK(data_section_offset + offset + nbytes <= file->size(), "constant");
+      TVMRetValue cell;
+      cell = MapNDArray(file, data_section_offset + offset, dtype, std::move(shape));
+      this->constants.push_back(cell);
     } else if (constant_type == ConstantType::kShapeTuple) {
       uint64_t size;
       strm->Read(&size);
@@ -412,6 +563,8 @@ void Executable::LoadConstantSection(dmlc::Stream* strm) {
                  << ArgTypeCode2Str(constant_type) << " when loading the VM constant pool.";
     }
   }
+  STREAM_CHECK(strm->Read(&(this->const_device_indexes)), "constant");
+  STREAM_CHECK(this->const_device_indexes.size() == this->constants.size(), "constant");
 }
 
 void Executable::LoadPackedFuncNames(dmlc::Stream* strm) {
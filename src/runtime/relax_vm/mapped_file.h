@@ -0,0 +1,119 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file tvm/runtime/relax_vm/mapped_file.h
+ * \brief A read-only file mapped in memory, backing the constants of a loaded executable.
+ */
+#ifndef TVM_RUNTIME_RELAX_VM_MAPPED_FILE_H_
+#define TVM_RUNTIME_RELAX_VM_MAPPED_FILE_H_
+
+#include <tvm/runtime/device_api.h>
+#include <tvm/runtime/logging.h>
+
+#include <memory>
+#include <string>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tvm {
+namespace runtime {
+namespace relax_vm {
+
+/*!
+ * \brief A read-only file mapped in memory. The pages are only read from the file when they
+ *  are first accessed. Where mmap is not available, the file is read into memory instead.
+ */
+class MappedFile {
+ public:
+  /*!
+   * \brief Map a file.
+   * \param file_name The name of the file.
+   * \return The mapped file, shared by the objects that refer to its content.
+   */
+  static std::shared_ptr<MappedFile> Open(const std::string& file_name) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+#ifndef _WIN32
+    int fd = open(file_name.c_str(), O_RDONLY);
+    ICHECK_GE(fd, 0) << "Cannot open " << file_name;
+    struct stat st;
+    ICHECK_EQ(fstat(fd, &st), 0) << "Cannot stat " << file_name;
+    file->size_ = static_cast<size_t>(st.st_size);
+    if (file->size_ != 0) {
+      // A private writable mapping, writes go to copies of the pages and never to the file.
+      void* addr = mmap(nullptr, file->size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      ICHECK(addr != MAP_FAILED) << "Cannot mmap " << file_name;
+      file->data_ = static_cast<char*>(addr);
+    }
+    close(fd);
+#else
+    std::ifstream fs(file_name, std::ios::in | std::ios::binary);
+    ICHECK(!fs.fail()) << "Cannot open " << file_name;
+    fs.seekg(0, std::ios::end);
+    file->size_ = static_cast<size_t>(fs.tellg());
+    fs.seekg(0, std::ios::beg);
+    // Align the content as a mapping would be, so that the constants can be viewed in place.
+    file->content_.resize(file->size_ + kAllocAlignment);
+    size_t misalign = reinterpret_cast<uintptr_t>(file->content_.data()) % kAllocAlignment;
+    file->data_ = &file->content_[0] + (misalign == 0 ? 0 : kAllocAlignment - misalign);
+    fs.read(file->data_, file->size_);
+#endif
+    return file;
+  }
+
+  ~MappedFile() {
+#ifndef _WIN32
+    if (data_ != nullptr) {
+      munmap(data_, size_);
+    }
+#endif
+  }
+
+  /*! \return The content of the file. */
+  char* data() const { return data_; }
+  /*! \return The size of the file in bytes. */
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /*! \brief The content of the file. */
+  char* data_{nullptr};
+  /*! \brief The size of the file in bytes. */
+  size_t size_{0};
+#ifdef _WIN32
+  /*! \brief The content read from the file. */
+  std::string content_;
+#endif
+};
+
+}  // namespace relax_vm
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_RELAX_VM_MAPPED_FILE_H_
@@ -21,6 +21,9 @@
  * \file tvm/runtime/relax_vm/memory_manager.cc
  * \brief Allocate and manage memory for the Relay VM.
  */
+#include <tvm/runtime/container/map.h>
+#include <tvm/runtime/profiling.h>
+#include <tvm/runtime/registry.h>
 #include <tvm/runtime/relax_vm/memory_manager.h>
 
 #include <memory>
@@ -176,6 +179,47 @@ runtime::NDArray Allocator::Empty(std::vector<int64_t> shape, DLDataType dtype,
   return runtime::NDArray(runtime::GetObjectPtr<Object>(container));
 }
 
+static PooledAllocator* GetPooledAllocator(int device_type, int device_id) {
+  Device dev{static_cast<DLDeviceType>(device_type), device_id};
+  Allocator* alloc = MemoryManager::GetAllocator(dev);
+  ICHECK_EQ(alloc->type(), kPooled) << "The allocator of " << runtime::DeviceName(dev.device_type)
+                                    << "(" << dev.device_id << ") is not a pooled allocator";
+  return static_cast<PooledAllocator*>(alloc);
+}
+
+TVM_REGISTER_GLOBAL("vm.memory_manager.pooled_allocator_stats")
+    .set_body_typed([](int device_type, int device_id) {
+      PooledAllocatorStats stats = GetPooledAllocator(device_type, device_id)->Stats();
+      double hit_rate = stats.num_allocs ? static_cast<double>(stats.num_hits) / stats.num_allocs
+                                         : 0.0;
+      Map<String, ObjectRef> ret;
+      ret.Set("bytes_in_use", ObjectRef(make_object<profiling::CountNode>(
+                                  static_cast<int64_t>(stats.bytes_in_use))));
+      ret.Set("bytes_cached", ObjectRef(make_object<profiling::CountNode>(
+                                  static_cast<int64_t>(stats.bytes_cached))));
+      ret.Set("num_allocs", ObjectRef(make_object<profiling::CountNode>(
+                                static_cast<int64_t>(stats.num_allocs))));
+      ret.Set("num_hits", ObjectRef(make_object<profiling::CountNode>(
+                              static_cast<int64_t>(stats.num_hits))));
+      ret.Set("hit_rate", ObjectRef(make_object<profiling::RatioNode>(hit_rate)));
+      return ret;
+    });
+
+TVM_REGISTER_GLOBAL("vm.memory_manager.pooled_allocator_trim")
+    .set_body_typed([](int device_type, int device_id, int64_t max_cached_bytes) {
+      GetPooledAllocator(device_type, device_id)->Trim(max_cached_bytes);
+    });
+
+TVM_REGISTER_GLOBAL("vm.memory_manager.pooled_allocator_set_limit")
+    .set_body_typed([](int device_type, int device_id, int64_t limit) {
+      GetPooledAllocator(device_type, device_id)->SetMemoryLimit(limit);
+    });
+
+TVM_REGISTER_GLOBAL("vm.memory_manager.pooled_allocator_set_idle_trim")
+    .set_body_typed([](int device_type, int device_id, int64_t timeout_ms) {
+      GetPooledAllocator(device_type, device_id)->SetIdleTrimTimeout(timeout_ms);
+    });
+
 }  // namespace relax_vm
 }  // namespace runtime
 }  // namespace tvm
@@ -26,34 +26,90 @@
 #include <tvm/runtime/device_api.h>
 #include <tvm/runtime/relax_vm/memory_manager.h>
 
-#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iterator>
+#include <map>
 #include <mutex>
-#include <unordered_map>
-#include <vector>
+#include <thread>
 
 namespace tvm {
 namespace runtime {
 namespace relax_vm {
 
+/*! \brief The statistics of a pooled allocator. */
+struct PooledAllocatorStats {
+  /*! \brief The bytes held by the buffers handed out and not freed yet. */
+  size_t bytes_in_use{0};
+  /*! \brief The bytes held by the free buffers kept for reuse. */
+  size_t bytes_cached{0};
+  /*! \brief The number of allocation requests. */
+  size_t num_allocs{0};
+  /*! \brief The number of allocation requests served from the cached buffers. */
+  size_t num_hits{0};
+};
+
+/*!
+ * \brief An allocator caching the freed buffers for reuse.
+ *
+ * Requests are rounded up to size classes, which are kSizeClassesPerDoubling per power of two
+ * (and at least one page), so that tensors of slightly different dynamic shapes share buffers.
+ * A request is served by the smallest cached buffer that fits it (best fit), as long as the
+ * buffer is at most kMaxReuseRatio times the request.
+ *
+ * The total of the bytes in use and cached can be capped: when a new allocation would exceed
+ * the cap, cached buffers are released first, and the allocation fails if the buffers in use
+ * alone still exceed it. Cached buffers can be trimmed explicitly, or automatically once no
+ * buffer was allocated or freed for an idle timeout.
+ */
 class PooledAllocator final : public Allocator {
  public:
   static constexpr size_t kDefaultPageSize = 4096;
+  /*! \brief The number of size classes between two powers of two. */
+  static constexpr size_t kSizeClassesPerDoubling = 4;
+  /*! \brief A cached buffer is only reused for requests at least 1/kMaxReuseRatio its size. */
+  static constexpr size_t kMaxReuseRatio = 2;
 
   explicit PooledAllocator(Device dev, size_t page_size = kDefaultPageSize)
-      : Allocator(kPooled), page_size_(page_size), used_memory_(0), device_(dev) {}
+      : Allocator(kPooled), page_size_(page_size), device_(dev) {}
 
-  ~PooledAllocator() { ReleaseAll(); }
+  ~PooledAllocator() {
+    {
+      std::lock_guard<std::recursive_mutex> lock(mu_);
+      stop_idle_trim_ = true;
+    }
+    idle_cv_.notify_all();
+    if (idle_trim_thread_.joinable()) idle_trim_thread_.join();
+    ReleaseAll();
+  }
 
   Buffer Alloc(size_t nbytes, size_t alignment, DLDataType type_hint) override {
     std::lock_guard<std::recursive_mutex> lock(mu_);
-    size_t size = ((nbytes + page_size_ - 1) / page_size_) * page_size_;
-    auto&& it = memory_pool_.find(size);
-    if (it != memory_pool_.end() && !it->second.empty()) {
-      auto&& pool = it->second;
-      auto ret = pool.back();
-      pool.pop_back();
+    size_t size = RoundToSizeClass(nbytes);
+    ++stats_.num_allocs;
+    last_active_ = std::chrono::steady_clock::now();
+    auto it = free_buffers_.lower_bound(size);
+    if (it != free_buffers_.end() && it->first <= size * kMaxReuseRatio) {
+      Buffer ret = it->second;
+      free_buffers_.erase(it);
+      stats_.bytes_cached -= ret.size;
+      stats_.bytes_in_use += ret.size;
+      ++stats_.num_hits;
       return ret;
     }
+    if (memory_limit_ != 0 && stats_.bytes_in_use + stats_.bytes_cached + size > memory_limit_) {
+      size_t budget = memory_limit_ > stats_.bytes_in_use + size
+                          ? memory_limit_ - stats_.bytes_in_use - size
+                          : 0;
+      TrimLocked(budget);
+      if (stats_.bytes_in_use + size > memory_limit_) {
+        LOG(FATAL) << "PooledAllocator cannot allocate " << size << " B on "
+                   << runtime::DeviceName(device_.device_type) << "(" << device_.device_id
+                   << "): " << stats_.bytes_in_use << " B are in use and the memory limit is "
+                   << memory_limit_ << " B";
+      }
+    }
     Buffer buf;
     buf.device = device_;
     buf.size = size;
@@ -68,40 +124,128 @@ class PooledAllocator final : public Allocator {
           runtime::DeviceAPI::Get(device_)->AllocDataSpace(device_, size, alignment, type_hint);
     }
 
-    used_memory_.fetch_add(size, std::memory_order_relaxed);
-    DLOG(INFO) << "allocate " << size << " B, used memory " << used_memory_ << " B";
+    stats_.bytes_in_use += size;
+    DLOG(INFO) << "allocate " << size << " B, used memory " << stats_.bytes_in_use << " B";
     return buf;
   }
 
   void Free(const Buffer& buffer) override {
     std::lock_guard<std::recursive_mutex> lock(mu_);
-    if (memory_pool_.find(buffer.size) == memory_pool_.end()) {
-      memory_pool_.emplace(buffer.size, std::vector<Buffer>{});
-    }
-    memory_pool_.at(buffer.size).push_back(buffer);
+    free_buffers_.emplace(buffer.size, buffer);
+    stats_.bytes_in_use -= buffer.size;
+    stats_.bytes_cached += buffer.size;
+    last_active_ = std::chrono::steady_clock::now();
+    if (idle_trim_timeout_.count() != 0) idle_cv_.notify_one();
     DLOG(INFO) << "reclaim buffer " << buffer.size;
   }
 
- private:
-  void ReleaseAll() {
+  /*!
+   * \brief Release cached buffers to the device, largest first, until at most
+   *  \p max_cached_bytes remain cached.
+   * \param max_cached_bytes The number of cached bytes to keep.
+   */
+  void Trim(size_t max_cached_bytes) {
     std::lock_guard<std::recursive_mutex> lock(mu_);
-    for (auto const& it : memory_pool_) {
-      auto const& pool = it.second;
-      for (auto const& buf : pool) {
-        runtime::DeviceAPI::Get(buf.device)->FreeDataSpace(buf.device, buf.data);
+    TrimLocked(max_cached_bytes);
+  }
+
+  /*!
+   * \brief Set the cap on the bytes in use plus the bytes cached. An allocation that would
+   *  exceed the cap once all cached buffers are released fails.
+   * \param limit The cap in bytes, 0 means unlimited.
+   * \note Live buffers are never released, so lowering the cap below the bytes in use only
+   *  makes the following allocations fail.
+   */
+  void SetMemoryLimit(size_t limit) {
+    std::lock_guard<std::recursive_mutex> lock(mu_);
+    memory_limit_ = limit;
+    if (limit != 0 && stats_.bytes_in_use + stats_.bytes_cached > limit) {
+      TrimLocked(limit > stats_.bytes_in_use ? limit - stats_.bytes_in_use : 0);
+    }
+  }
+
+  /*!
+   * \brief Release all cached buffers once no buffer was allocated or freed for a timeout.
+   * \param timeout_ms The idle timeout in milliseconds, 0 disables the idle trim.
+   */
+  void SetIdleTrimTimeout(int64_t timeout_ms) {
+    {
+      std::lock_guard<std::recursive_mutex> lock(mu_);
+      idle_trim_timeout_ = std::chrono::milliseconds(timeout_ms);
+      if (timeout_ms != 0 && !idle_trim_thread_.joinable()) {
+        idle_trim_thread_ = std::thread([this]() { IdleTrimLoop(); });
       }
     }
-    memory_pool_.clear();
-    used_memory_ = 0;
+    idle_cv_.notify_all();
+  }
+
+  /*! \return The statistics of the allocator. */
+  PooledAllocatorStats Stats() {
+    std::lock_guard<std::recursive_mutex> lock(mu_);
+    return stats_;
+  }
+
+ private:
+  size_t RoundToSizeClass(size_t nbytes) const {
+    size_t size = std::max(page_size_, (nbytes + page_size_ - 1) / page_size_ * page_size_);
+    // The largest power of two not greater than size.
+    size_t pow2 = 1;
+    while (pow2 <= size / 2) pow2 *= 2;
+    size_t step = std::max(page_size_, pow2 / kSizeClassesPerDoubling);
+    return (size + step - 1) / step * step;
+  }
+
+  void TrimLocked(size_t max_cached_bytes) {
+    while (stats_.bytes_cached > max_cached_bytes && !free_buffers_.empty()) {
+      auto it = std::prev(free_buffers_.end());
+      const Buffer& buf = it->second;
+      runtime::DeviceAPI::Get(buf.device)->FreeDataSpace(buf.device, buf.data);
+      stats_.bytes_cached -= buf.size;
+      free_buffers_.erase(it);
+    }
+    DLOG(INFO) << "trim cached buffers to " << stats_.bytes_cached << " B";
+  }
+
+  void IdleTrimLoop() {
+    std::unique_lock<std::recursive_mutex> lock(mu_);
+    while (!stop_idle_trim_) {
+      if (idle_trim_timeout_.count() == 0 || stats_.bytes_cached == 0) {
+        // Woken up by Free or when the timeout changes.
+        idle_cv_.wait(lock);
+        continue;
+      }
+      auto deadline = last_active_ + idle_trim_timeout_;
+      if (std::chrono::steady_clock::now() >= deadline) {
+        TrimLocked(0);
+      } else {
+        idle_cv_.wait_until(lock, deadline);
+      }
+    }
+  }
+
+  void ReleaseAll() {
+    std::lock_guard<std::recursive_mutex> lock(mu_);
+    TrimLocked(0);
     DLOG(INFO) << "release all buffers";
   }
 
  private:
   size_t page_size_;
-  std::atomic<size_t> used_memory_;
-  std::unordered_map<size_t, std::vector<Buffer> > memory_pool_;
+  /*! \brief The cap on the bytes in use plus the bytes cached, 0 means unlimited. */
+  size_t memory_limit_{0};
+  PooledAllocatorStats stats_;
+  /*! \brief The cached free buffers, ordered by size. */
+  std::multimap<size_t, Buffer> free_buffers_;
   std::recursive_mutex mu_;
   Device device_;
+  /*! \brief The last time a buffer was allocated or freed. */
+  std::chrono::steady_clock::time_point last_active_{std::chrono::steady_clock::now()};
+  /*! \brief The idle timeout after which cached buffers are released, 0 means never. */
+  std::chrono::milliseconds idle_trim_timeout_{0};
+  /*! \brief The thread releasing cached buffers when idle, started on the first timeout set. */
+  std::thread idle_trim_thread_;
+  std::condition_variable_any idle_cv_;
+  bool stop_idle_trim_{false};
 };
 
 }  // namespace relax_vm
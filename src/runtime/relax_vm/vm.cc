@@ -22,9 +22,17 @@
  */
 
 #include <tvm/runtime/container/adt.h>
+#include <tvm/runtime/device_api.h>
 #include <tvm/runtime/packed_func.h>
 #include <tvm/runtime/relax_vm/vm.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <utility>
+
+#include "../file_utils.h"
+
 namespace tvm {
 namespace runtime {
 namespace relax_vm {
@@ -51,12 +59,33 @@ VMFunction VirtualMachine::LookupVMFunction(const std::string& func_name) {
   return vm_func;
 }
 
+std::shared_ptr<const VirtualMachine::BoundParams> VirtualMachine::LookupBoundParams(
+    Index gf_idx) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = bound_params_.find(gf_idx);
+  return it == bound_params_.end() ? nullptr : it->second;
+}
+
+std::vector<RegType> VirtualMachine::WithBoundParams(const BoundParams& bound,
+                                                     const std::string& func_name,
+                                                     std::vector<RegType> args) {
+  CHECK_EQ(args.size(), bound.free_indices.size())
+      << "ValueError: " << func_name << " expects " << bound.free_indices.size()
+      << " arguments once its params are bound, but gets " << args.size();
+  std::vector<RegType> inputs = bound.values;
+  for (size_t i = 0; i < args.size(); ++i) {
+    inputs[bound.free_indices[i]] = std::move(args[i]);
+  }
+  return inputs;
+}
+
 RegType VirtualMachine::LookupVMOutput(const std::string& func_name) {
-  if (!outputs_.count(func_name)) {
+  VMExecutionContext* ctx = GetContext();
+  if (!ctx->outputs.count(func_name)) {
     LOG(FATAL) << "ValueError: No output saved for call of \"" << func_name
                << "\"; use `invoke_stateful` to call it first.";
   }
-  return outputs_[func_name];
+  return ctx->outputs[func_name];
 }
 
 // Use the args after `starting_arg_idx` as a series of indices into `obj`,
@@ -99,15 +128,18 @@ PackedFunc VirtualMachine::GetFunction(const std::string& name,
       }
       this->Init(devices, alloc_types);
 
-      // Copy NDArray constants to the devices
-      // TODO(tvm-team): support multiple devices
-      this->constants.reserve(exec_->constants.size());
-      for (const auto& constant : exec_->constants) {
-        if (constant.type_code() != kTVMNDArrayHandle) {
-          this->constants.push_back(constant);
-        } else {
-          this->constants.push_back(CopyConstantTo(constant, devices[0]));
+      // NDArray constants on another device than the one they are placed on are copied to
+      // their device on their first use.
+      this->constants = exec_->constants;
+      this->constant_pending_.reset(new std::atomic<bool>[constants.size()]);
+      for (size_t i = 0; i < constants.size(); ++i) {
+        bool pending = false;
+        if (constants[i].type_code() == kTVMNDArrayHandle) {
+          const DLDevice& dev = constants[i].operator DLTensor*()->device;
+          Device target = GetDevice(exec_->const_device_indexes[i]);
+          pending = dev.device_type != target.device_type || dev.device_id != target.device_id;
         }
+        constant_pending_[i].store(pending, std::memory_order_relaxed);
       }
     });
   } else if (name == "save_function") {
@@ -130,6 +162,7 @@ PackedFunc VirtualMachine::GetFunction(const std::string& name,
           SetInputTensorWithIndex(inputs, args[i], i - 3, devices[0]);
         }
       }
+      std::lock_guard<std::mutex> lock(mutex_);
       if (include_return) {
         saved_closures_[closure_name] =
             PackedFunc([this, gf_idx, inputs](TVMArgs args, TVMRetValue* rv) {
@@ -142,6 +175,50 @@ PackedFunc VirtualMachine::GetFunction(const std::string& name,
             });
       }
     });
+  } else if (name == "bind_params" || name == "load_params") {
+    // bind_params(func_name, params) / load_params(func_name, param_bytes): bind the params of
+    // a function by name, e.g. the weights lifted by PrepackParams. The function is then called,
+    // queried and given its inputs with its remaining params only, in their order.
+    bool from_bytes = name == "load_params";
+    return PackedFunc([sptr_to_self, this, from_bytes](TVMArgs args, TVMRetValue* rv) {
+      std::string func_name = args[0];
+      Map<String, NDArray> params;
+      if (from_bytes) {
+        std::string param_bytes = args[1];
+        params = runtime::LoadParams(param_bytes);
+      } else {
+        params = args[1];
+      }
+      const auto& m = exec_->global_map;
+      if (m.find(func_name) == m.end()) {
+        LOG(FATAL) << "ValueError: Unknown function: " << func_name;
+      }
+      Index gf_idx = m.at(func_name);
+      const VMFunction& vm_func = exec_->global_funcs[gf_idx];
+      auto bound = std::make_shared<BoundParams>();
+      bound->values.resize(vm_func.param_names.size());
+      size_t num_bound = 0;
+      for (size_t i = 0; i < vm_func.param_names.size(); ++i) {
+        auto it = params.find(vm_func.param_names[i]);
+        if (it == params.end()) {
+          bound->free_indices.push_back(i);
+          continue;
+        }
+        // Place the param once on the device the function expects it on.
+        NDArray param = (*it).second;
+        Device dev = GetDevice(vm_func.param_device_indexes[i]);
+        if (param->device.device_type != dev.device_type ||
+            param->device.device_id != dev.device_id) {
+          param = param.CopyTo(dev);
+        }
+        bound->values[i] = param;
+        ++num_bound;
+      }
+      CHECK_EQ(num_bound, params.size())
+          << "ValueError: Some of the params do not match a param of " << func_name;
+      std::lock_guard<std::mutex> lock(mutex_);
+      bound_params_[gf_idx] = std::move(bound);
+    });
   } else if (name == "invoke_closure") {
     return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
       ICHECK(exec_) << "The executable is not created yet.";
@@ -165,7 +242,60 @@ PackedFunc VirtualMachine::GetFunction(const std::string& name,
       auto it = exec_->global_map.find(func_name);
       ICHECK(it != exec_->global_map.end()) << "No such function " << func_name;
       Index func_idx = it->second;
-      *rv = Invoke(func_idx, new_args);
+      *rv = Invoke(func_idx, std::move(new_args));
+    });
+  } else if (name == "profile") {
+    // profile(func_name, *args): invoke a function once to warm it up, then again under the
+    // profiler, and return the profiling::Report of the calls it made.
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      ICHECK_GE(args.size(), 1) << "profile expects the function name as first argument";
+      std::string func_name = args[0];
+      const auto& m = exec_->global_map;
+      auto it = m.find(func_name);
+      if (it == m.end()) {
+        LOG(FATAL) << "ValueError: Unknown function: " << func_name;
+      }
+      Index gf_idx = it->second;
+      std::shared_ptr<const BoundParams> bound = LookupBoundParams(gf_idx);
+      auto make_inputs = [&args, &bound, &func_name]() {
+        std::vector<RegType> inputs(args.size() - 1);
+        for (int i = 1; i < args.size(); ++i) {
+          inputs[i - 1] = args[i];
+        }
+        if (bound) {
+          inputs = WithBoundParams(*bound, func_name, std::move(inputs));
+        }
+        return inputs;
+      };
+      this->Invoke(gf_idx, make_inputs());
+
+      std::vector<Device> profiled_devices;
+      for (const Device& dev : devices) {
+        if (std::find_if(profiled_devices.begin(), profiled_devices.end(), [&](const Device& d) {
+              return d.device_type == dev.device_type && d.device_id == dev.device_id;
+            }) == profiled_devices.end()) {
+          profiled_devices.push_back(dev);
+        }
+      }
+      profiling::Profiler prof(profiled_devices, {}, {{String("Executor"), String("Relax VM")}});
+      VMExecutionContext* ctx = GetContext();
+      ICHECK(ctx->profiler == nullptr) << "The function is already being profiled";
+      ctx->profiler = &prof;
+      prof.Start();
+      try {
+        this->Invoke(gf_idx, make_inputs());
+      } catch (...) {
+        ctx->profiler = nullptr;
+        throw;
+      }
+      prof.Stop();
+      ctx->profiler = nullptr;
+      *rv = prof.Report();
+    });
+  } else if (name == "set_async_execution") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      bool enable = args[0];
+      this->SetAsyncExecution(enable);
     });
   } else if (name == "invoke_stateful") {
     return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
@@ -175,12 +305,13 @@ PackedFunc VirtualMachine::GetFunction(const std::string& name,
         LOG(FATAL) << "ValueError: Unknown function: " << func_name;
       }
       Index gf_idx = m.at(func_name);
-      if (!inputs_.count(func_name)) {
+      VMExecutionContext* ctx = GetContext();
+      if (!ctx->inputs.count(func_name)) {
         LOG(FATAL) << "ValueError: No inputs set for stateful call of " << func_name
                    << "; use `set_input` first.";
         return;
       }
-      outputs_[func_name] = this->Invoke(gf_idx, inputs_[func_name]);
+      ctx->outputs[func_name] = this->Invoke(gf_idx, ctx->inputs[func_name]);
     });
   } else if (name == "get_output_arity") {
     return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
@@ -215,40 +346,57 @@ PackedFunc VirtualMachine::GetFunction(const std::string& name,
     return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
       std::string func_name = args[0];
       const VMFunction& vm_func = LookupVMFunction(func_name);
-      *rv = static_cast<int>(vm_func.param_names.size());
+      std::shared_ptr<const BoundParams> bound = LookupBoundParams(exec_->global_map.at(func_name));
+      *rv = static_cast<int>(bound ? bound->free_indices.size() : vm_func.param_names.size());
     });
   } else if (name == "get_function_param_name") {
     return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
       std::string func_name = args[0];
       int index = args[1];
       const VMFunction& vm_func = LookupVMFunction(func_name);
-      if (static_cast<size_t>(index) >= vm_func.param_names.size()) {
+      std::shared_ptr<const BoundParams> bound = LookupBoundParams(exec_->global_map.at(func_name));
+      size_t num_params = bound ? bound->free_indices.size() : vm_func.param_names.size();
+      if (static_cast<size_t>(index) >= num_params) {
         LOG(FATAL) << "ValueError: Invalid index for " << func_name << " (" << index << " out of "
-                   << vm_func.param_names.size() << ")";
+                   << num_params << ")";
       }
-      *rv = vm_func.param_names[index];
+      *rv = vm_func.param_names[bound ? bound->free_indices[index] : index];
     });
   }
 
   // check if this is a function we saved
-  if (saved_closures_.count(name)) {
-    return saved_closures_[name];
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = saved_closures_.find(name);
+    if (it != saved_closures_.end()) {
+      return it->second;
+    }
   }
 
   const auto& m = exec_->global_map;
   if (m.find(name) != m.end()) {
     Index gf_idx = m.at(name);
+    if (std::shared_ptr<const BoundParams> bound = LookupBoundParams(gf_idx)) {
+      return PackedFunc([sptr_to_self, this, gf_idx, name, bound](TVMArgs args, TVMRetValue* rv) {
+        if (GetContext()->inputs.count(name)) {
+          LOG(FATAL) << "ValueError: If inputs have been set, `invoke_stateful`"
+                     << " must be used to invoke a function!";
+          return;
+        }
+        std::vector<RegType> inputs(args.size());
+        for (int i = 0; i < args.size(); ++i) {
+          inputs[i] = args[i];
+        }
+        *rv = this->Invoke(gf_idx, WithBoundParams(*bound, name, std::move(inputs)));
+      });
+    }
     return PackedFunc([sptr_to_self, this, gf_idx, name](TVMArgs args, TVMRetValue* rv) {
-      if (inputs_.count(name)) {
+      if (GetContext()->inputs.count(name)) {
         LOG(FATAL) << "ValueError: If inputs have been set, `invoke_stateful`"
                    << " must be used to invoke a function!";
         return;
       } else {
-        std::vector<RegType> inputs(args.size());
-        for (int i = 0; i < args.size(); ++i) {
-          inputs[i] = args[i];
-        }
-        *rv = this->Invoke(gf_idx, inputs);
+        *rv = this->Invoke(gf_idx, args);
       }
     });
   } else {
@@ -261,37 +409,346 @@ void VirtualMachine::LoadExecutable(ObjectPtr<Executable> exec) {
   this->exec_ = exec;
   CHECK_LE(exec_->imports().size(), 1);
   this->lib = exec_->imports().empty() ? Optional<Module>(NullOpt) : exec_->imports()[0];
+  // The functions of the executable, called by the bytecode and the builtins. They are owned by
+  // the VM and only run while it runs, so they do not hold a reference to it, which would form
+  // a cycle. The functions handed out by GetFunction hold one.
+  vm_func_table_.clear();
+  vm_func_table_.reserve(exec_->global_funcs.size());
+  for (size_t i = 0; i < exec_->global_funcs.size(); ++i) {
+    Index gf_idx = i;
+    vm_func_table_.push_back(PackedFunc(
+        [this, gf_idx](TVMArgs args, TVMRetValue* rv) { *rv = this->Invoke(gf_idx, args); }));
+  }
+  this->DecodeInstructions();
+  // Resolve the functions named by string constants, e.g. the kernels of vm.call_tir_dyn and
+  // the functions of closures, so that the builtins calling them skip the lookup by name.
+  const_func_table_.clear();
+  for (const TVMRetValue& constant : exec_->constants) {
+    if (!constant.IsObjectRef<String>()) continue;
+    String func_name = constant.AsObjectRef<String>();
+    PackedFunc func = LookupPackedFunc(func_name);
+    if (func != nullptr) {
+      const_func_table_[func_name.get()] = std::move(func);
+    }
+  }
+  // Frames are pooled, size them for any function of the executable.
+  max_register_file_size_ = 0;
+  for (const VMFunction& func : exec_->global_funcs) {
+    max_register_file_size_ = std::max(max_register_file_size_, func.register_file_size);
+  }
+}
+
+namespace {
+/*! \brief The source of the VM ids. */
+std::atomic<uint64_t> next_vm_id{1};
+
+/*!
+ * \brief The owner of the execution contexts of a thread, which erases them from the tables of
+ *  the VMs still alive when the thread exits.
+ */
+struct ThreadContextOwner {
+  ~ThreadContextOwner() {
+    for (const std::weak_ptr<VMContextTable>& weak_table : tables) {
+      if (std::shared_ptr<VMContextTable> table = weak_table.lock()) {
+        std::unique_ptr<VMExecutionContext> ctx;
+        {
+          std::lock_guard<std::mutex> lock(table->mutex);
+          auto it = table->contexts.find(this);
+          if (it == table->contexts.end()) continue;
+          ctx = std::move(it->second);
+          table->contexts.erase(it);
+        }
+      }
+    }
+  }
+
+  /*! \brief Register a table holding a context of the thread. */
+  void Add(const std::shared_ptr<VMContextTable>& table) {
+    // Forget the tables of the destroyed VMs.
+    tables.erase(std::remove_if(tables.begin(), tables.end(),
+                                [](const std::weak_ptr<VMContextTable>& t) { return t.expired(); }),
+                 tables.end());
+    tables.push_back(table);
+  }
+
+  /*! \brief The tables of the VMs the thread invoked. */
+  std::vector<std::weak_ptr<VMContextTable>> tables;
+};
+}  // namespace
+
+VirtualMachine::VirtualMachine() : id_(next_vm_id.fetch_add(1)) {}
+
+VirtualMachine::~VirtualMachine() { SetAsyncExecution(false); }
+
+VMExecutionContext* VirtualMachine::GetContext() {
+  // Cache the context of the last VM used by the thread. The VM id is never reused, so a
+  // cache entry of a destroyed VM can not match.
+  struct ContextCache {
+    uint64_t vm_id{0};
+    VMExecutionContext* ctx{nullptr};
+  };
+  static thread_local ContextCache cache;
+  if (cache.vm_id == id_) return cache.ctx;
+
+  // The context lives as long as both the thread and the VM.
+  static thread_local ThreadContextOwner owner;
+  VMExecutionContext* ctx;
+  {
+    std::lock_guard<std::mutex> lock(contexts_->mutex);
+    std::unique_ptr<VMExecutionContext>& entry = contexts_->contexts[&owner];
+    if (entry == nullptr) {
+      entry = std::make_unique<VMExecutionContext>();
+      owner.Add(contexts_);
+    }
+    ctx = entry.get();
+  }
+  cache.vm_id = id_;
+  cache.ctx = ctx;
+  return ctx;
 }
 
-RegType VirtualMachine::Invoke(Index gf_idx, const std::vector<RegType>& args) {
+void VirtualMachine::DecodeInstructions() {
+  const Index num_instrs = static_cast<Index>(exec_->instr_offset.size());
+  // The register file size of the function each instruction belongs to.
+  std::vector<const VMFunction*> funcs;
+  for (const VMFunction& func : exec_->global_funcs) {
+    funcs.push_back(&func);
+  }
+  std::sort(funcs.begin(), funcs.end(), [](const VMFunction* lhs, const VMFunction* rhs) {
+    return lhs->start_instr < rhs->start_instr;
+  });
+  std::vector<Index> register_file_size(num_instrs, 0);
+  for (size_t i = 0; i < funcs.size(); ++i) {
+    Index begin = funcs[i]->start_instr;
+    Index end = i + 1 < funcs.size() ? funcs[i + 1]->start_instr : num_instrs;
+    ICHECK(begin >= 0 && begin <= num_instrs)
+        << "Function " << funcs[i]->name << " starts at an invalid instruction " << begin;
+    std::fill(register_file_size.begin() + begin, register_file_size.begin() + end,
+              funcs[i]->register_file_size);
+  }
+  auto check_register = [&](Index pc, RegName reg) {
+    ICHECK(reg >= 0 && reg < register_file_size[pc])
+        << "Instruction " << pc << " accesses an invalid register " << reg;
+  };
+  auto check_target = [&](Index pc, Index target) {
+    ICHECK(target >= 0 && target <= num_instrs)
+        << "Instruction " << pc << " jumps to an invalid instruction " << target;
+  };
+
+  decoded_instrs_.clear();
+  decoded_args_.clear();
+  decoded_instrs_.reserve(num_instrs + 1);
+  for (Index pc = 0; pc < num_instrs; ++pc) {
+    Instruction instr = exec_->GetInstruction(pc);
+    DecodedInstruction decoded;
+    switch (instr.op) {
+      case Opcode::Call: {
+        ICHECK(instr.func_idx >= 0 &&
+               instr.func_idx < static_cast<Index>(exec_->func_names.size()))
+            << "Instruction " << pc << " calls an invalid function " << instr.func_idx;
+        if (instr.dst != Instruction::kVoidArg) check_register(pc, instr.dst);
+        decoded.op = DecodedInstruction::kCall;
+        decoded.dst = instr.dst;
+        decoded.func_idx = instr.func_idx;
+        decoded.num_args = static_cast<int32_t>(instr.num_args);
+        decoded.args_begin = decoded_args_.size();
+        for (Index i = 0; i < instr.num_args; ++i) {
+          Instruction::Arg arg = instr.args[i];
+          switch (arg.kind()) {
+            case Instruction::kRegister: {
+              if (arg.value() == Instruction::kVMRegister) {
+                decoded_args_.push_back({DecodedInstruction::kVMPointer, 0});
+              } else {
+                check_register(pc, arg.value());
+                decoded_args_.push_back({DecodedInstruction::kRegister, arg.value()});
+              }
+              break;
+            }
+            case Instruction::kImmediate: {
+              decoded_args_.push_back({DecodedInstruction::kImmediate, arg.value()});
+              break;
+            }
+            case Instruction::kConstIdx: {
+              ICHECK_LT(static_cast<size_t>(arg.value()), exec_->constants.size())
+                  << "Instruction " << pc << " uses an invalid constant " << arg.value();
+              decoded_args_.push_back({DecodedInstruction::kConstIdx, arg.value()});
+              break;
+            }
+            default: {
+              LOG(FATAL) << "ValueError: Unknown argument kind: " << int(arg.kind());
+            }
+          }
+        }
+        break;
+      }
+      case Opcode::Ret: {
+        check_register(pc, instr.result);
+        decoded.op = DecodedInstruction::kRet;
+        decoded.reg = instr.result;
+        break;
+      }
+      case Opcode::Goto: {
+        decoded.op = DecodedInstruction::kGoto;
+        decoded.target_pc = pc + instr.pc_offset;
+        check_target(pc, decoded.target_pc);
+        break;
+      }
+      case Opcode::If: {
+        ICHECK_GT(instr.false_offset, 1);
+        check_register(pc, instr.cond);
+        decoded.op = DecodedInstruction::kIf;
+        decoded.reg = instr.cond;
+        decoded.target_pc = pc + instr.false_offset;
+        check_target(pc, decoded.target_pc);
+        break;
+      }
+    }
+    decoded_instrs_.push_back(decoded);
+  }
+  // Falling through the last instruction or jumping past it lands on the sentinel.
+  DecodedInstruction end_of_code;
+  end_of_code.op = DecodedInstruction::kEndOfCode;
+  decoded_instrs_.push_back(end_of_code);
+
+  // Resolve the callees up front. The functions that cannot be found yet are looked up
+  // again when they are called, which reports the error.
+  func_table_.assign(exec_->func_names.size(), nullptr);
+  for (size_t i = 0; i < exec_->func_names.size(); ++i) {
+    func_table_[i] = LookupPackedFunc(exec_->func_names[i]);
+  }
+}
+
+/*!
+ * \brief Make the streams of the VM current for the devices while it runs an outermost
+ *  function call in asynchronous execution, and restore the default streams afterwards.
+ */
+class VMStreamScope {
+ public:
+  VMStreamScope(const std::vector<Device>& devices, const std::vector<TVMStreamHandle>& streams)
+      : devices_(devices), streams_(streams) {
+    for (size_t i = 0; i < streams_.size(); ++i) {
+      if (streams_[i] != nullptr) DeviceAPI::Get(devices_[i])->SetStream(devices_[i], streams_[i]);
+    }
+  }
+
+  ~VMStreamScope() {
+    for (size_t i = 0; i < streams_.size(); ++i) {
+      if (streams_[i] != nullptr) DeviceAPI::Get(devices_[i])->SetStream(devices_[i], nullptr);
+    }
+  }
+
+  /*! \brief Wait for the work enqueued on the streams. */
+  void Sync() {
+    for (size_t i = 0; i < streams_.size(); ++i) {
+      if (streams_[i] != nullptr) DeviceAPI::Get(devices_[i])->StreamSync(devices_[i], streams_[i]);
+    }
+  }
+
+ private:
+  const std::vector<Device>& devices_;
+  const std::vector<TVMStreamHandle>& streams_;
+};
+
+template <typename ArgsType>
+RegType VirtualMachine::InvokeImpl(Index gf_idx, ArgsType args) {
   const VMFunction& gfunc = exec_->global_funcs[gf_idx];
+  VMExecutionContext* ctx = GetContext();
+  if (!streams_.empty() && ctx->frames.empty()) {
+    // The outermost call returns its results once the devices have produced them.
+    VMStreamScope scope(devices, streams_);
+    RegType ret = InvokeFrame(ctx, gfunc, std::move(args));
+    scope.Sync();
+    return ret;
+  }
+  return InvokeFrame(ctx, gfunc, std::move(args));
+}
+
+RegType VirtualMachine::Invoke(Index gf_idx, std::vector<RegType> args) {
+  return InvokeImpl(gf_idx, std::move(args));
+}
+
+RegType VirtualMachine::Invoke(Index gf_idx, TVMArgs args) { return InvokeImpl(gf_idx, args); }
+
+RegType VirtualMachine::InvokeFrame(VMExecutionContext* ctx, const VMFunction& gfunc,
+                                    std::vector<RegType> args) {
+  VMFrame* curr_frame = EnterFrame(ctx, gfunc, args.size());
+  for (size_t i = 0; i < args.size(); ++i) {
+    WriteRegister(curr_frame, i, std::move(args[i]));
+  }
+  return RunFrame(ctx, gfunc);
+}
+
+RegType VirtualMachine::InvokeFrame(VMExecutionContext* ctx, const VMFunction& gfunc,
+                                    TVMArgs args) {
+  VMFrame* curr_frame = EnterFrame(ctx, gfunc, args.size());
+  for (int i = 0; i < args.size(); ++i) {
+    RegType arg;
+    arg = args[i];
+    WriteRegister(curr_frame, i, std::move(arg));
+  }
+  return RunFrame(ctx, gfunc);
+}
+
+VMFrame* VirtualMachine::EnterFrame(VMExecutionContext* ctx, const VMFunction& gfunc,
+                                    size_t num_args) {
   // Get the curr instr which might be a potential caller.
-  Instruction curr_instr = exec_->GetInstruction(pc_);
-  PushFrame(this->pc_, gfunc);
+  const DecodedInstruction& curr_instr = decoded_instrs_[ctx->pc];
+  PushFrame(ctx, ctx->pc, gfunc);
   // Get new frame and set the caller info.
-  VMFrame* curr_frame = frames_.back().get();
-  if (curr_instr.op == Opcode::Call) {
+  VMFrame* curr_frame = ctx->frames.back().get();
+  if (curr_instr.op == DecodedInstruction::kCall) {
     curr_frame->caller_return_register = curr_instr.dst;
   }
-
-  // load arguments to the register file
-  ICHECK_EQ(static_cast<size_t>(gfunc.num_args), args.size())
+  ICHECK_EQ(static_cast<size_t>(gfunc.num_args), num_args)
       << "ValueError: Invoking function " << gfunc.name << " requires " << gfunc.num_args
-      << " inputs but only " << args.size() << " inputs are provided.";
-  for (size_t i = 0; i < args.size(); ++i) {
-    WriteRegister(frames_.back().get(), i, args[i]);
-  }
+      << " inputs but only " << num_args << " inputs are provided.";
+  return curr_frame;
+}
+
+RegType VirtualMachine::RunFrame(VMExecutionContext* ctx, const VMFunction& gfunc) {
   // set program counter
-  pc_ = gfunc.start_instr;
-  RunLoop();
-  return return_value_;
+  ctx->pc = gfunc.start_instr;
+  RunLoop(ctx);
+  return std::move(ctx->return_value);
+}
+
+void VirtualMachine::SetAsyncExecution(bool enable) {
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (streams_[i] == nullptr ||
+        std::find(streams_.begin(), streams_.begin() + i, streams_[i]) != streams_.begin() + i) {
+      continue;
+    }
+    DeviceAPI::Get(devices[i])->FreeStream(devices[i], streams_[i]);
+  }
+  streams_.clear();
+  if (!enable) return;
+  streams_.resize(devices.size(), nullptr);
+  for (size_t i = 0; i < devices.size(); ++i) {
+    // The host runs the calls on CPU devices itself.
+    if (devices[i].device_type == kDLCPU) continue;
+    // The devices listed several times share a stream.
+    for (size_t j = 0; j < i; ++j) {
+      if (devices[j].device_type == devices[i].device_type &&
+          devices[j].device_id == devices[i].device_id) {
+        streams_[i] = streams_[j];
+      }
+    }
+    if (streams_[i] == nullptr) streams_[i] = DeviceAPI::Get(devices[i])->CreateStream(devices[i]);
+  }
+}
+
+TVMStreamHandle VirtualMachine::GetStream(Device dev) const {
+  for (size_t i = 0; i < streams_.size(); ++i) {
+    if (devices[i].device_type == dev.device_type && devices[i].device_id == dev.device_id) {
+      return streams_[i];
+    }
+  }
+  return nullptr;
 }
 
 void VirtualMachine::Init(const std::vector<Device>& devices,
                           const std::vector<AllocatorType>& alloc_types) {
-  // TODO(@yuchen): support multi-device heterogeneous execution
-  ICHECK_LT(devices.size(), 3)
-      << "Currently relax vm only supports at most 2 devices (host + device)";
+  ICHECK(!devices.empty()) << "The VM needs at least the host device";
   ICHECK_EQ(devices.size(), alloc_types.size());
 
   this->devices.reserve(devices.size());
@@ -303,41 +760,93 @@ void VirtualMachine::Init(const std::vector<Device>& devices,
   }
 }
 
-void VirtualMachine::PrepareFuncTable(Index func_index) {
-  // fast path, function already in cache;
+PackedFunc VirtualMachine::LookupExternFunc(const std::string& func_name) {
+  PackedFunc func{nullptr};
+  if (this->lib.defined()) {
+    func = this->lib.value()->GetFunction(func_name, true);
+  }
+  if (func.defined()) return func;
+  if (const PackedFunc* p_func = Registry::Get(func_name)) {
+    return *p_func;
+  }
+  return func;
+}
 
-  if (static_cast<Index>(func_table_.size()) > func_index && func_table_[func_index] != nullptr)
-    return;
+PackedFunc VirtualMachine::LookupPackedFunc(const std::string& func_name) {
+  PackedFunc func = LookupExternFunc(func_name);
+  if (func.defined()) return func;
+  const auto& m = exec_->global_map;
+  auto it = m.find(func_name);
+  if (it == m.end()) return func;
+  return vm_func_table_[it->second];
+}
 
-  if (static_cast<Index>(func_table_.size()) <= func_index) {
-    func_table_.resize(func_index + 1, nullptr);
+void VirtualMachine::ProfileCall(profiling::Profiler* prof, const DecodedInstruction& instr,
+                                 const PackedFunc& func, TVMArgs args, TVMRetValue* rv) {
+  const std::string& func_name = exec_->func_names[instr.func_idx];
+  if (exec_->global_map.count(func_name)) {
+    // The calls made by a VM function are profiled on their own.
+    func.CallPacked(args, rv);
+    return;
+  }
+  // Report the kernels called through vm.call_tir_dyn under their own name.
+  String name = func_name;
+  if (func_name == "vm.call_tir_dyn" && args.size() > 1 && args[1].IsObjectRef<String>()) {
+    name = args[1].operator String();
+  }
+  // The calls without tensor arguments run on the host, the last device.
+  Device dev = devices.back();
+  std::vector<NDArray> arrays;
+  for (int i = 0; i < args.size(); ++i) {
+    if (args.type_codes[i] != kTVMNDArrayHandle) continue;
+    NDArray array = args[i];
+    if (arrays.empty()) dev = array->device;
+    arrays.push_back(array);
+  }
+  std::unordered_map<std::string, ObjectRef> metrics;
+  if (!arrays.empty()) {
+    metrics["Argument Shapes"] = profiling::ShapeString(arrays);
   }
 
-  const std::string& func_name = exec_->func_names[func_index];
-
-  // lookup function and populate
-  PackedFunc func{nullptr};
-  if (this->lib.defined()) {
-    func = this->lib.value()->GetFunction(func_name, true);
+  prof->StartCall(name, dev, metrics);
+  func.CallPacked(args, rv);
+  auto sync_begin = std::chrono::high_resolution_clock::now();
+  DeviceAPI::Get(dev)->StreamSync(dev, GetStream(dev));
+  std::chrono::duration<double, std::micro> sync_time =
+      std::chrono::high_resolution_clock::now() - sync_begin;
+  std::unordered_map<std::string, ObjectRef> stop_metrics;
+  stop_metrics["Device Sync"] = ObjectRef(make_object<profiling::DurationNode>(sync_time.count()));
+  if (rv->IsObjectRef<Storage>()) {
+    Storage storage = rv->AsObjectRef<Storage>();
+    stop_metrics["Allocated Bytes"] =
+        ObjectRef(make_object<profiling::CountNode>(static_cast<int64_t>(storage->buffer.size)));
   }
-  if (!func.defined()) {
-    const PackedFunc* p_func = Registry::Get(func_name);
-    if (p_func == nullptr) {
-      const auto& m = exec_->global_map;
-      ICHECK(m.find(func_name) != m.end())
-          << "Error: Cannot find function " << func_name
-          << " in either Relax VM kernel library, or in TVM runtime PackedFunc registry, or in "
-             "global Relax functions of the VM executable";
-      func = this->GetFunction(func_name, GetObjectPtr<Object>(this));
-    } else {
-      func = *(p_func);
-    }
+  prof->StopCall(stop_metrics);
+}
+
+inline const TVMRetValue& VirtualMachine::GetConstant(Index idx) {
+  if (constant_pending_[idx].load(std::memory_order_acquire)) {
+    MaterializeConstant(idx);
   }
-  func_table_[func_index] = func;
+  return constants[idx];
+}
+
+void VirtualMachine::MaterializeConstant(Index idx) {
+  std::lock_guard<std::mutex> lock(constant_mutex_);
+  if (!constant_pending_[idx].load(std::memory_order_relaxed)) return;
+  constants[idx] = CopyConstantTo(constants[idx], GetDevice(exec_->const_device_indexes[idx]));
+  constant_pending_[idx].store(false, std::memory_order_release);
 }
 
-void VirtualMachine::RunInstrCall(VMFrame* curr_frame, Instruction instr) {
-  DLOG(INFO) << "\n  pc = " << pc_ << ", execute: " << exec_->func_names[instr.func_idx];
+PackedFunc VirtualMachine::GetFuncByName(const String& func_name) {
+  auto it = const_func_table_.find(func_name.get());
+  if (it != const_func_table_.end()) return it->second;
+  return LookupPackedFunc(func_name);
+}
+
+void VirtualMachine::RunInstrCall(VMExecutionContext* ctx, VMFrame* curr_frame,
+                                  const DecodedInstruction& instr) {
+  DLOG(INFO) << "\n  pc = " << ctx->pc << ", execute: " << exec_->func_names[instr.func_idx];
 
   // Use the call arg stack from the current frame to increase reuse
   // and avoid re-allocation
@@ -349,140 +858,215 @@ void VirtualMachine::RunInstrCall(VMFrame* curr_frame, Instruction instr) {
   std::vector<TVMValue>& values = curr_frame->call_arg_values;
   std::vector<int>& tcodes = curr_frame->call_arg_tcodes;
 
+  // The argument kinds and indices were validated by DecodeInstructions.
+  const DecodedInstruction::Arg* args = decoded_args_.data() + instr.args_begin;
   runtime::TVMArgsSetter setter(values.data(), tcodes.data());
-  for (Index i = 0; i < instr.num_args; ++i) {
-    Instruction::Arg arg = instr.args[i];
-    switch (arg.kind()) {
-      case Instruction::kRegister: {
-        if (arg.value() == Instruction::kVMRegister) {
-          setter(i, this);
-        } else {
-          setter(i, ReadRegister(curr_frame, arg.value()));
-        }
+  for (int32_t i = 0; i < instr.num_args; ++i) {
+    switch (args[i].kind) {
+      case DecodedInstruction::kRegister: {
+        setter(i, ReadRegister(curr_frame, args[i].value));
         break;
       }
-      case Instruction::kImmediate: {
-        setter(i, arg.value());
+      case DecodedInstruction::kVMPointer: {
+        setter(i, this);
         break;
       }
-      case Instruction::kConstIdx: {
-        setter(i, this->constants[arg.value()]);
+      case DecodedInstruction::kImmediate: {
+        setter(i, args[i].value);
         break;
       }
-      default: {
-        LOG(FATAL) << "ValueError: Unknown argument kind: " << int(arg.kind());
+      case DecodedInstruction::kConstIdx: {
+        setter(i, GetConstant(args[i].value));
+        break;
       }
     }
   }
-  TVMArgs args(values.data(), tcodes.data(), values.size());
+  TVMArgs call_args(values.data(), tcodes.data(), instr.num_args);
   TVMRetValue ret;
-  // prepare and invoke
-  this->PrepareFuncTable(instr.func_idx);
-  func_table_[instr.func_idx].CallPacked(args, &ret);
+  const PackedFunc* func = &func_table_[instr.func_idx];
+  PackedFunc looked_up_func;
+  if (*func == nullptr) {
+    // The function was not available when the executable was loaded. The function table is
+    // shared by all the threads and left untouched, so look it up on every call.
+    const std::string& func_name = exec_->func_names[instr.func_idx];
+    looked_up_func = LookupPackedFunc(func_name);
+    ICHECK(looked_up_func != nullptr)
+        << "Error: Cannot find function " << func_name
+        << " in either Relax VM kernel library, or in TVM runtime PackedFunc registry, or in "
+           "global Relax functions of the VM executable";
+    func = &looked_up_func;
+  }
+  if (ctx->profiler == nullptr) {
+    func->CallPacked(call_args, &ret);
+  } else {
+    ProfileCall(ctx->profiler, instr, *func, call_args, &ret);
+  }
 
   // save the return value to the register
   if (instr.dst != Instruction::kVoidArg) {
-    WriteRegister(curr_frame, instr.dst, ret);
+    WriteRegister(curr_frame, instr.dst, std::move(ret));
   }
   // increment pc
-  pc_++;
+  ctx->pc++;
 }
 
-int64_t VirtualMachine::LoadScalarInt(RegName reg) const {
+int64_t VirtualMachine::LoadScalarInt(VMFrame* curr_frame, RegName reg) const {
   int64_t result = 0;
-  VMFrame* curr_frame = frames_.back().get();
   const RegType& obj = ReadRegister(curr_frame, reg);
   NDArray ndarray = obj.operator tvm::runtime::NDArray();
-  NDArray ndarray_host = ndarray.CopyTo(devices[0]);
+  const DLTensor* tensor = ndarray.operator->();
+  // Read a scalar on the host in place. Otherwise copy only the scalar to the host, which is
+  // where the host waits for the work of the device producing it.
+  int64_t host_scalar = 0;
+  const void* data = static_cast<const char*>(tensor->data) + tensor->byte_offset;
+  if (tensor->device.device_type != kDLCPU) {
+    DLTensor from = *tensor;
+    from.ndim = 0;
+    from.shape = nullptr;
+    from.strides = nullptr;
+    DLTensor to = from;
+    to.data = &host_scalar;
+    to.byte_offset = 0;
+    to.device = Device{kDLCPU, 0};
+    TVMStreamHandle stream = GetStream(tensor->device);
+    NDArray::CopyFromTo(&from, &to, stream);
+    DeviceAPI::Get(tensor->device)->StreamSync(tensor->device, stream);
+    data = &host_scalar;
+  }
 
-  switch (ndarray_host->dtype.bits) {
+  switch (tensor->dtype.bits) {
     case 1: {
-      result = reinterpret_cast<bool*>(ndarray_host->data)[0];
+      result = static_cast<const bool*>(data)[0];
       break;
     }
     case 8: {
-      result = reinterpret_cast<int8_t*>(ndarray_host->data)[0];
+      result = static_cast<const int8_t*>(data)[0];
       break;
     }
     case 16: {
-      result = reinterpret_cast<int16_t*>(ndarray_host->data)[0];
+      result = static_cast<const int16_t*>(data)[0];
       break;
     }
     case 32: {
-      result = reinterpret_cast<int32_t*>(ndarray_host->data)[0];
+      result = static_cast<const int32_t*>(data)[0];
       break;
     }
     case 64: {
-      result = reinterpret_cast<int64_t*>(ndarray_host->data)[0];
+      result = static_cast<const int64_t*>(data)[0];
       break;
     }
     default:
-      LOG(FATAL) << "Unknown scalar int type: " << DLDataType2String(ndarray_host->dtype);
+      LOG(FATAL) << "Unknown scalar int type: " << DLDataType2String(tensor->dtype);
   }
   return result;
 }
 
-void VirtualMachine::RunLoop() {
-  VMFrame* curr_frame = frames_.back().get();
+// Use direct threading (computed goto) for the dispatch loop when the compiler supports it:
+// every handler jumps to the next one through its own indirect branch, which is easier for the
+// branch predictor than the single indirect jump of a switch.
+#if defined(__GNUC__) || defined(__clang__)
+#define TVM_RELAX_VM_THREADED_DISPATCH 1
+#endif
+
+void VirtualMachine::RunLoop(VMExecutionContext* ctx) {
+  VMFrame* curr_frame = ctx->frames.back().get();
+  Index& pc = ctx->pc;
+  // The instructions and the jump targets were validated by DecodeInstructions, and the
+  // stream ends with a kEndOfCode sentinel, so the program counter needs no bounds check.
+  const DecodedInstruction* code = decoded_instrs_.data();
 
+#ifdef TVM_RELAX_VM_THREADED_DISPATCH
+  static void* const dispatch_table[] = {&&op_call, &&op_ret, &&op_goto, &&op_if,
+                                         &&op_end_of_code};
+#define RELAX_VM_DISPATCH() goto* dispatch_table[code[pc].op]
+#define RELAX_VM_HANDLER(label, op) label:
+  RELAX_VM_DISPATCH();
+  {
+#else
+#define RELAX_VM_DISPATCH() break
+#define RELAX_VM_HANDLER(label, op) case DecodedInstruction::op:
   while (true) {
-    ICHECK_LT(static_cast<size_t>(pc_), exec_->instr_offset.size()) << "run into invalide section";
-    Instruction instr = exec_->GetInstruction(pc_);
-    switch (instr.op) {
-      case Opcode::Call: {
-        this->RunInstrCall(curr_frame, instr);
-        break;
-      }
-      case Opcode::Ret: {
-        // If we have hit the point from which we started
-        // running, we should return to the caller breaking
-        // the dispatch loop.
-        return_value_ = ReadRegister(curr_frame, instr.result);
-        RegName caller_return_register = curr_frame->caller_return_register;
-        PopFrame();
-        if (frames_.size() == 0) {
-          // directly return if no frame in the call stack.
-        } else {
-          // return from a local call.
-          // Update the current frame to be the parent frame.
-          curr_frame = frames_.back().get();
-          WriteRegister(curr_frame, caller_return_register, return_value_);
-        }
-        return;
-      }
-      case Opcode::Goto: {
-        pc_ += instr.pc_offset;
-        break;
+    switch (code[pc].op) {
+#endif
+    RELAX_VM_HANDLER(op_call, kCall) {
+      this->RunInstrCall(ctx, curr_frame, code[pc]);
+      RELAX_VM_DISPATCH();
+    }
+    RELAX_VM_HANDLER(op_ret, kRet) {
+      // If we have hit the point from which we started
+      // running, we should return to the caller breaking
+      // the dispatch loop.
+      // The frame is popped right after, so the returned register can be moved from.
+      ctx->return_value = std::move(curr_frame->register_file[code[pc].reg]);
+      RegName caller_return_register = curr_frame->caller_return_register;
+      PopFrame(ctx);
+      if (ctx->frames.size() == 0) {
+        // directly return if no frame in the call stack.
+      } else {
+        // return from a local call.
+        // Update the current frame to be the parent frame.
+        curr_frame = ctx->frames.back().get();
+        WriteRegister(curr_frame, caller_return_register, ctx->return_value);
       }
-      case Opcode::If: {
-        int64_t cond_val = LoadScalarInt(instr.cond);
-        if (cond_val != 0) {
-          pc_++;
-        } else {
-          ICHECK_GT(instr.false_offset, 1);
-          pc_ += instr.false_offset;
-        }
-        break;
+      return;
+    }
+    RELAX_VM_HANDLER(op_goto, kGoto) {
+      pc = code[pc].target_pc;
+      RELAX_VM_DISPATCH();
+    }
+    RELAX_VM_HANDLER(op_if, kIf) {
+      int64_t cond_val = LoadScalarInt(curr_frame, code[pc].reg);
+      if (cond_val != 0) {
+        pc++;
+      } else {
+        pc = code[pc].target_pc;
       }
+      RELAX_VM_DISPATCH();
+    }
+    RELAX_VM_HANDLER(op_end_of_code, kEndOfCode) {
+      LOG(FATAL) << "run into invalide section";
+      return;
+    }
+#ifdef TVM_RELAX_VM_THREADED_DISPATCH
+  }
+#else
     }
   }
+#endif
+#undef RELAX_VM_DISPATCH
+#undef RELAX_VM_HANDLER
 }
 
-void VirtualMachine::PushFrame(Index ret_pc, const VMFunction& vm_func) {
-  frames_.emplace_back(std::make_unique<VMFrame>(ret_pc, vm_func.register_file_size));
+void VirtualMachine::PushFrame(VMExecutionContext* ctx, Index ret_pc, const VMFunction& vm_func) {
+  if (ctx->frame_free_list.empty()) {
+    auto frame = std::make_unique<VMFrame>(ret_pc, vm_func.register_file_size);
+    frame->register_file.reserve(max_register_file_size_);
+    ctx->frames.emplace_back(std::move(frame));
+  } else {
+    ctx->frames.emplace_back(std::move(ctx->frame_free_list.back()));
+    ctx->frame_free_list.pop_back();
+    ctx->frames.back()->ResetForReuse(ret_pc, vm_func.register_file_size);
+  }
 }
 
-void VirtualMachine::PopFrame() {
-  ICHECK_GT(frames_.size(), 0);
-  pc_ = frames_.back()->return_pc;
-  frames_.pop_back();
+void VirtualMachine::PopFrame(VMExecutionContext* ctx) {
+  ICHECK_GT(ctx->frames.size(), 0);
+  ctx->pc = ctx->frames.back()->return_pc;
+  // Release the registers now, but keep the frame space for the next call.
+  ctx->frames.back()->Clear();
+  ctx->frame_free_list.emplace_back(std::move(ctx->frames.back()));
+  ctx->frames.pop_back();
 }
 
 inline void VirtualMachine::WriteRegister(VMFrame* frame, Index r, const RegType& val) {
   frame->register_file[r] = val;
 }
 
-inline RegType VirtualMachine::ReadRegister(VMFrame* frame, Index r) const {
+inline void VirtualMachine::WriteRegister(VMFrame* frame, Index r, RegType&& val) {
+  frame->register_file[r] = std::move(val);
+}
+
+inline const RegType& VirtualMachine::ReadRegister(VMFrame* frame, Index r) const {
   return frame->register_file[r];
 }
 
@@ -491,7 +1075,8 @@ void VirtualMachine::SetInput(std::string func_name, TVMArgs args, int offset) {
   if (m.find(func_name) != m.end()) {
     Index gf_idx = m.at(func_name);
     const VMFunction& vm_func = exec_->global_funcs[gf_idx];
-    size_t params_num = vm_func.num_args;
+    std::shared_ptr<const BoundParams> bound = LookupBoundParams(gf_idx);
+    size_t params_num = bound ? bound->free_indices.size() : vm_func.num_args;
     ICHECK_EQ(args.size() - offset, params_num)
         << "The number of provided parameters doesn't match the number of arguments for";
     std::vector<RegType> func_args(params_num);
@@ -499,7 +1084,10 @@ void VirtualMachine::SetInput(std::string func_name, TVMArgs args, int offset) {
       int index = i - offset;
       SetInputTensorWithIndex(func_args, args[i], index, devices[0]);
     }
-    inputs_.emplace(func_name, func_args);
+    if (bound) {
+      func_args = WithBoundParams(*bound, func_name, std::move(func_args));
+    }
+    GetContext()->inputs.emplace(func_name, func_args);
   } else {
     LOG(FATAL) << "ValueError: Unknown function: " << func_name;
   }
@@ -33,6 +33,8 @@
 #include <array>
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <deque>
 #include <memory>
 #include <string>
 #include <utility>
@@ -46,6 +48,11 @@
 namespace tvm {
 namespace runtime {
 
+/*! \brief The default size of the chunks of the copies between the client and the remote. */
+constexpr uint64_t kRPCCopyChunkBytesDefault = 4 << 20;
+/*! \brief The default number of chunks of a copy which can be in flight. */
+constexpr uint64_t kRPCCopyMaxInFlightDefault = 4;
+
 /*!
  * Event-driven state-machine based handlers for RPCEndpoint.
  *
@@ -649,16 +656,18 @@ RPCCode RPCEndpoint::HandleUntilReturnEvent(bool client_mode, RPCSession::FEncod
   return code;
 }
 
+void RPCEndpoint::FlushWriter() {
+  while (writer_.bytes_available() != 0) {
+    size_t n = writer_.ReadWithCallback(
+        [this](const void* data, size_t size) { return channel_->Send(data, size); },
+        writer_.bytes_available());
+    if (n == 0) break;
+  }
+}
+
 void RPCEndpoint::Init() {
   // callback to flush the writer.
-  auto flush_writer = [this]() {
-    while (writer_.bytes_available() != 0) {
-      size_t n = writer_.ReadWithCallback(
-          [this](const void* data, size_t size) { return channel_->Send(data, size); },
-          writer_.bytes_available());
-      if (n == 0) break;
-    }
-  };
+  auto flush_writer = [this]() { this->FlushWriter(); };
 
   // Event handler
   handler_ = std::make_shared<EventHandler>(&reader_, &writer_, name_, &remote_key_, flush_writer);
@@ -747,6 +756,10 @@ int RPCEndpoint::ServerAsyncIOEventHandler(const std::string& in_bytes, int even
   RPCCode code = RPCCode::kNone;
   if (in_bytes.length() != 0) {
     reader_.Write(in_bytes.c_str(), in_bytes.length());
+  }
+  // A client may pipeline several copy packets, so packets that arrived while an async
+  // callback was pending are handled once the event loop calls back in.
+  if (reader_.bytes_available() != 0) {
     code = handler_->HandleNextEvent(false, true, [](TVMArgs) {});
   }
   if ((event_flag & 2) != 0 && writer_.bytes_available() != 0) {
@@ -846,6 +859,101 @@ void RPCEndpoint::CopyFromRemote(DLTensor* from, void* to_bytes, uint64_t nbytes
   handler_->FinishCopyAck();
 }
 
+void RPCEndpoint::CopyToRemoteChunked(void* from_bytes, DLTensor* to, uint64_t nbytes,
+                                      uint64_t chunk_bytes, int max_in_flight) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  RPCCode code = RPCCode::kCopyToRemote;
+
+  uint64_t tensor_total_size_bytes = static_cast<uint64_t>(GetDataSize(*to));
+  ICHECK_LE(to->byte_offset + nbytes, tensor_total_size_bytes)
+      << "CopyToRemote: overflow in tensor size: (byte_offset=" << to->byte_offset
+      << ", nbytes=" << nbytes << ", tensor_total_size=" << tensor_total_size_bytes << ")";
+  ICHECK_GT(chunk_bytes, 0U);
+  ICHECK_GT(max_in_flight, 0);
+
+  int num_in_flight = 0;
+  auto wait_for_ack = [&]() {
+    --num_in_flight;
+    ICHECK(HandleUntilReturnEvent(true, [](TVMArgs) {}) == RPCCode::kReturn);
+  };
+  try {
+    DLTensor chunk = *to;
+    for (uint64_t offset = 0; offset < nbytes; offset += chunk_bytes) {
+      uint64_t chunk_nbytes = std::min(chunk_bytes, nbytes - offset);
+      chunk.byte_offset = to->byte_offset + offset;
+      uint64_t overhead = RemoteCopyCalculatePacketOverheadSize(&chunk, code, chunk_nbytes);
+      handler_->Write(overhead + chunk_nbytes);
+      handler_->Write(code);
+      RPCReference::SendDLTensor(handler_, &chunk);
+      handler_->Write(chunk_nbytes);
+      handler_->WriteArray(reinterpret_cast<char*>(from_bytes) + offset, chunk_nbytes);
+      ++num_in_flight;
+      // Send the chunk now, the remote copies it while the next one is transferred.
+      FlushWriter();
+      if (num_in_flight == max_in_flight) wait_for_ack();
+    }
+    while (num_in_flight != 0) wait_for_ack();
+  } catch (...) {
+    // Receive the answers of the chunks in flight, to keep the protocol in sync.
+    while (num_in_flight != 0) {
+      try {
+        wait_for_ack();
+      } catch (...) {
+      }
+    }
+    throw;
+  }
+}
+
+void RPCEndpoint::CopyFromRemoteChunked(DLTensor* from, void* to_bytes, uint64_t nbytes,
+                                        uint64_t chunk_bytes, int max_in_flight) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  RPCCode code = RPCCode::kCopyFromRemote;
+
+  uint64_t tensor_total_size_bytes = static_cast<uint64_t>(GetDataSize(*from));
+  ICHECK_LE(from->byte_offset + nbytes, tensor_total_size_bytes)
+      << "CopyFromRemote: overflow in tensor size: (byte_offset=" << from->byte_offset
+      << ", nbytes=" << nbytes << ", tensor_total_size=" << tensor_total_size_bytes << ")";
+  ICHECK_GT(chunk_bytes, 0U);
+  ICHECK_GT(max_in_flight, 0);
+
+  // The offsets of the chunks requested and not received yet, in order.
+  std::deque<uint64_t> in_flight;
+  auto receive_chunk = [&]() {
+    uint64_t offset = in_flight.front();
+    in_flight.pop_front();
+    ICHECK(HandleUntilReturnEvent(true, [](TVMArgs) {}) == RPCCode::kCopyAck);
+    handler_->ReadArray(reinterpret_cast<char*>(to_bytes) + offset,
+                        std::min(chunk_bytes, nbytes - offset));
+    handler_->FinishCopyAck();
+  };
+  try {
+    DLTensor chunk = *from;
+    for (uint64_t offset = 0; offset < nbytes; offset += chunk_bytes) {
+      uint64_t chunk_nbytes = std::min(chunk_bytes, nbytes - offset);
+      chunk.byte_offset = from->byte_offset + offset;
+      uint64_t overhead = RemoteCopyCalculatePacketOverheadSize(&chunk, code, chunk_nbytes);
+      handler_->Write(overhead);
+      handler_->Write(code);
+      RPCReference::SendDLTensor(handler_, &chunk);
+      handler_->Write(chunk_nbytes);
+      in_flight.push_back(offset);
+      FlushWriter();
+      if (in_flight.size() == static_cast<size_t>(max_in_flight)) receive_chunk();
+    }
+    while (!in_flight.empty()) receive_chunk();
+  } catch (...) {
+    // Receive the answers of the chunks in flight, to keep the protocol in sync.
+    while (!in_flight.empty()) {
+      try {
+        receive_chunk();
+      } catch (...) {
+      }
+    }
+    throw;
+  }
+}
+
 // SysCallEventHandler functions
 void RPCGetGlobalFunc(RPCSession* handler, TVMArgs args, TVMRetValue* rv) {
   std::string name = args[0];
@@ -1017,25 +1125,9 @@ class RPCClientSession : public RPCSession, public DeviceAPI {
     uint64_t overhead = RemoteCopyCalculatePacketOverheadSize(remote_to, code, nbytes);
     uint64_t rpc_max_size = GetRPCMaxTransferSize();
     ICHECK_GT(rpc_max_size, overhead) << "CopyToRemote: Invalid block size!";
-    const uint64_t block_size = rpc_max_size - overhead;
-    uint64_t block_count = 0;
-    const uint64_t num_blocks = nbytes / block_size;
-    void* from_bytes;
-
-    for (block_count = 0; block_count < num_blocks; block_count++) {
-      remote_to->byte_offset = block_count * block_size;
-      from_bytes = reinterpret_cast<void*>(
-          (reinterpret_cast<uint8_t*>(local_from_bytes) + block_count * block_size));
-      endpoint_->CopyToRemote(from_bytes, remote_to, block_size);
-    }
-
-    const uint64_t remainder_bytes = nbytes % block_size;
-    if (remainder_bytes != 0) {
-      remote_to->byte_offset = block_count * block_size;
-      from_bytes = reinterpret_cast<void*>(
-          (reinterpret_cast<uint8_t*>(local_from_bytes) + block_count * block_size));
-      endpoint_->CopyToRemote(from_bytes, remote_to, remainder_bytes);
-    }
+    const uint64_t block_size = std::min(rpc_max_size - overhead, copy_chunk_bytes_);
+    endpoint_->CopyToRemoteChunked(local_from_bytes, remote_to, nbytes, block_size,
+                                   copy_max_in_flight_);
   }
 
   void CopyFromRemote(DLTensor* remote_from, void* local_to_bytes, uint64_t nbytes) final {
@@ -1043,25 +1135,9 @@ class RPCClientSession : public RPCSession, public DeviceAPI {
     uint64_t overhead = RemoteCopyCalculatePacketOverheadSize(remote_from, code, nbytes);
     uint64_t rpc_max_size = GetRPCMaxTransferSize();
     ICHECK_GT(rpc_max_size, overhead) << "CopyFromRemote: Invalid block size!";
-    const uint64_t block_size = rpc_max_size - overhead;
-    uint64_t block_count = 0;
-    const uint64_t num_blocks = nbytes / block_size;
-    void* to_bytes;
-
-    for (block_count = 0; block_count < num_blocks; block_count++) {
-      remote_from->byte_offset = block_count * block_size;
-      to_bytes = reinterpret_cast<void*>(
-          (reinterpret_cast<uint8_t*>(local_to_bytes) + block_count * block_size));
-      endpoint_->CopyFromRemote(remote_from, to_bytes, block_size);
-    }
-
-    const uint64_t remainder_bytes = nbytes % block_size;
-    if (remainder_bytes != 0) {
-      remote_from->byte_offset = block_count * block_size;
-      to_bytes = reinterpret_cast<void*>(
-          (reinterpret_cast<uint8_t*>(local_to_bytes) + block_count * block_size));
-      endpoint_->CopyFromRemote(remote_from, to_bytes, remainder_bytes);
-    }
+    const uint64_t block_size = std::min(rpc_max_size - overhead, copy_chunk_bytes_);
+    endpoint_->CopyFromRemoteChunked(remote_from, local_to_bytes, nbytes, block_size,
+                                     copy_max_in_flight_);
   }
 
   void FreeHandle(void* handle, int type_code) final {
@@ -1141,6 +1217,8 @@ class RPCClientSession : public RPCSession, public DeviceAPI {
     if (rpc_func == nullptr) {
       rpc_chunk_max_size_bytes_ = (int64_t)kRPCMaxTransferSizeBytesDefault;
     } else {
+      // The CRT server handles one packet at a time, within its receive buffer.
+      copy_max_in_flight_ = 1;
       CallFunc(rpc_func, nullptr, nullptr, 0, [this](TVMArgs args) {
         // Use args[1] as return value, args[0] is tcode
         // Look at RPCWrappedFunc in src/runtime/rpc/rpc_module.cc
@@ -1153,8 +1231,20 @@ class RPCClientSession : public RPCSession, public DeviceAPI {
     return (uint64_t)rpc_chunk_max_size_bytes_;
   }
 
+  static uint64_t GetEnvOr(const char* name, uint64_t default_value) {
+    const char* val = getenv(name);
+    if (val == nullptr || std::atoll(val) <= 0) return default_value;
+    return static_cast<uint64_t>(std::atoll(val));
+  }
+
   std::shared_ptr<RPCEndpoint> endpoint_;
   int64_t rpc_chunk_max_size_bytes_ = -1;
+  // The size of the chunks of the copies, so that they are pipelined with the remote copies
+  // and the tensors are not staged entirely in memory on both sides.
+  uint64_t copy_chunk_bytes_ = GetEnvOr("TVM_RPC_COPY_CHUNK_BYTES", kRPCCopyChunkBytesDefault);
+  // The number of chunks of a copy which can be in flight.
+  int copy_max_in_flight_ =
+      static_cast<int>(GetEnvOr("TVM_RPC_COPY_MAX_IN_FLIGHT", kRPCCopyMaxInFlightDefault));
 };
 
 std::shared_ptr<RPCSession> CreateClientSession(std::shared_ptr<RPCEndpoint> endpoint) {
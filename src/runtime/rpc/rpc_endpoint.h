@@ -162,6 +162,28 @@ class RPCEndpoint {
    * \param type_hint Hint of content data type.
    */
   void CopyFromRemote(DLTensor* from, void* to_bytes, uint64_t nbytes);
+  /*!
+   * \brief Copy bytes into remote array content in chunks. The next chunks are sent
+   *  while the remote copies the previous ones.
+   * \param from_bytes The source host data.
+   * \param to The target array, the copy starts at its byte offset.
+   * \param nbytes The size of the memory in bytes.
+   * \param chunk_bytes The maximum size of a chunk in bytes.
+   * \param max_in_flight The maximum number of chunks the remote has not acknowledged yet.
+   */
+  void CopyToRemoteChunked(void* from_bytes, DLTensor* to, uint64_t nbytes, uint64_t chunk_bytes,
+                           int max_in_flight);
+  /*!
+   * \brief Copy bytes from remote array content in chunks. The next chunks are requested
+   *  before the previous ones are received.
+   * \param from The source array, the copy starts at its byte offset.
+   * \param to_bytes The target host data.
+   * \param nbytes The size of the memory in bytes.
+   * \param chunk_bytes The maximum size of a chunk in bytes.
+   * \param max_in_flight The maximum number of chunks requested and not received yet.
+   */
+  void CopyFromRemoteChunked(DLTensor* from, void* to_bytes, uint64_t nbytes,
+                             uint64_t chunk_bytes, int max_in_flight);
 
   /*!
    * \brief Call a remote defined system function with arguments.
@@ -189,6 +211,8 @@ class RPCEndpoint {
   // Handle events until receives a return
   // Also flushes channels so that the function advances.
   RPCCode HandleUntilReturnEvent(bool client_mode, RPCSession::FEncodeReturn setreturn);
+  // Send the content of the writer to the channel.
+  void FlushWriter();
   // Initalization
   void Init();
   // Internal channel.
@@ -25,17 +25,24 @@
 #include <tvm/runtime/c_backend_api.h>
 #include <tvm/runtime/c_runtime_api.h>
 #include <tvm/runtime/container/array.h>
+#include <tvm/runtime/container/map.h>
 #include <tvm/runtime/logging.h>
 #include <tvm/runtime/packed_func.h>
+#include <tvm/runtime/profiling.h>
 #include <tvm/runtime/registry.h>
 #include <tvm/runtime/threading_backend.h>
+#if defined(__linux__) || defined(__ANDROID__)
+#include <sched.h>
+#endif
 #if TVM_THREADPOOL_USE_OPENMP
 #include <omp.h>
 #endif
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <sstream>
@@ -60,32 +67,85 @@ uint32_t GetSpinCount() {
   return atoi(val);
 }
 
+// The spin count of the jobs launched by this thread, negative for the default spin count.
+thread_local int64_t launch_spin_count = -1;
+
+uint32_t GetLaunchSpinCount() {
+  // Initialize the spin count (from envvar TVM_THREAD_POOL_SPIN_COUNT) on
+  // the global first use of the ThreadPool.
+  // TODO(tulloch): should we make this configurable via standard APIs?
+  static uint32_t spin_count = GetSpinCount();
+  return launch_spin_count >= 0 ? static_cast<uint32_t>(launch_spin_count) : spin_count;
+}
+
+/*!
+ * \brief The time a thread spent waiting, spinning and then sleeping.
+ */
+struct WaitTime {
+  std::atomic<int64_t> spin_ns{0};
+  std::atomic<int64_t> sleep_ns{0};
+
+  /*!
+   * \brief Wait for a condition, spinning up to spin_count iterations and then sleeping.
+   * \param spin_count The number of iterations to spin before sleep.
+   * \param done Whether the condition is met.
+   * \param sleep Sleep until the condition is met.
+   */
+  template <typename FDone, typename FSleep>
+  void Wait(uint32_t spin_count, FDone done, FSleep sleep) {
+    if (done()) return;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < spin_count && !done(); ++i) {
+      tvm::runtime::threading::Yield();
+    }
+    auto spin_end = std::chrono::steady_clock::now();
+    spin_ns.fetch_add(ElapsedNs(start, spin_end), std::memory_order_relaxed);
+    if (done()) return;
+    sleep();
+    sleep_ns.fetch_add(ElapsedNs(spin_end, std::chrono::steady_clock::now()),
+                       std::memory_order_relaxed);
+  }
+
+  static int64_t ElapsedNs(std::chrono::steady_clock::time_point begin,
+                           std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+  }
+};
+
 }  // namespace
 
 // stride in the page, fit to cache line.
 constexpr int kSyncStride = 64 / sizeof(std::atomic<int>);
+// The number of launchers each launching thread recycles.
+constexpr size_t kMaxCachedLaunchers = 4;
 
 /*!
- * \brief Thread local main environment.
+ * \brief The environment of a parallel job, shared by the threads running its tasks.
+ *
+ *  The task ids are not assigned to threads up front, each thread participating to the
+ *  job claims the next task which has not started yet until all of them have started.
  */
 class ParallelLauncher {
  public:
   // Reset the task request.
   void Init(FTVMParallelLambda flambda, void* cdata, int num_task, bool need_sync) {
+    next_task_.store(0, std::memory_order_relaxed);
     num_pending_.store(num_task);
     this->cdata = cdata;
     this->flambda = flambda;
     this->env.num_task = num_task;
+    this->spin_count = GetLaunchSpinCount();
     has_error_.store(false);
     // reshape
     if (static_cast<size_t>(num_task) > par_errors_.size()) {
       par_errors_.resize(num_task + 1);
-      if (need_sync) {
+    }
+    if (need_sync) {
+      if (num_task > num_sync_counter_) {
         delete[] sync_counter_;
         sync_counter_ = new std::atomic<int>[num_task * kSyncStride];
+        num_sync_counter_ = num_task;
       }
-    }
-    if (need_sync) {
       for (int i = 0; i < num_task; ++i) {
         sync_counter_[i * kSyncStride].store(0, std::memory_order_relaxed);
       }
@@ -95,11 +155,39 @@ class ParallelLauncher {
     }
   }
   ~ParallelLauncher() { delete[] sync_counter_; }
-  // Wait n jobs to finish
-  int WaitForJobs() {
-    while (num_pending_.load() != 0) {
-      tvm::runtime::threading::Yield();
+  // Claim a task which has not started yet, return -1 when all the tasks have started.
+  int ClaimTask() {
+    if (next_task_.load(std::memory_order_relaxed) >= env.num_task) return -1;
+    int task_id = next_task_.fetch_add(1, std::memory_order_relaxed);
+    return task_id < env.num_task ? task_id : -1;
+  }
+  // Run a task on the current thread.
+  void RunTask(int task_id) {
+    ParallelLauncher* outer = current_;
+    current_ = this;
+    if ((*flambda)(task_id, &env, cdata) == 0) {
+      SignalJobFinish();
+    } else {
+      SignalJobError(task_id);
+    }
+    current_ = outer;
+  }
+  // Run tasks until all the tasks have started.
+  void RunTasks() {
+    for (int task_id = ClaimTask(); task_id >= 0; task_id = ClaimTask()) {
+      RunTask(task_id);
     }
+  }
+  // Wait n jobs to finish, spinning and then sleeping until the last one signals.
+  int WaitForJobs(WaitTime* wait_time) {
+    wait_time->Wait(
+        spin_count, [this] { return num_pending_.load() == 0; },
+        [this] {
+          std::unique_lock<std::mutex> lock(mutex_);
+          waiting_.store(true);
+          cv_.wait(lock, [this] { return num_pending_.load() == 0; });
+          waiting_.store(false);
+        });
     if (!has_error_.load()) return 0;
     std::ostringstream os;
     for (size_t i = 0; i < par_errors_.size(); ++i) {
@@ -113,153 +201,125 @@ class ParallelLauncher {
   }
   // Signal that one job has finished.
   void SignalJobError(int task_id) {
-    num_pending_.fetch_sub(1);
     par_errors_[task_id] = TVMGetLastError();
     has_error_.store(true);
+    SignalJobFinish();
   }
   // Signal that one job has finished.
-  void SignalJobFinish() { num_pending_.fetch_sub(1); }
-  // Get thread local version of the store.
-  static ParallelLauncher* ThreadLocal() { return dmlc::ThreadLocalStore<ParallelLauncher>::Get(); }
+  void SignalJobFinish() {
+    if (num_pending_.fetch_sub(1) == 1 && waiting_.load()) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cv_.notify_one();
+    }
+  }
+  /*!
+   * \brief Get a launcher which is not used by any thread.
+   *  The threads participating to a job keep a reference to it until they return from
+   *  RunTasks, which may be after the job is done. Each thread recycles a few launchers, so
+   *  that back to back launches find one which all the threads have left.
+   */
+  static std::shared_ptr<ParallelLauncher> Acquire() {
+    static thread_local std::vector<std::shared_ptr<ParallelLauncher>> cached;
+    for (const std::shared_ptr<ParallelLauncher>& launcher : cached) {
+      if (launcher.use_count() == 1) return launcher;
+    }
+    auto launcher = std::make_shared<ParallelLauncher>();
+    if (cached.size() < kMaxCachedLaunchers) {
+      cached.push_back(launcher);
+    }
+    return launcher;
+  }
+  // The job of the task running on this thread, nullptr if the thread is not running a task.
+  static ParallelLauncher* Current() { return current_; }
   // The parallel lambda
   FTVMParallelLambda flambda;
   // The closure data
   void* cdata;
   // Local env
   TVMParallelGroupEnv env;
-  // Whether this thread is worker of the pool.
-  // used to prevent recursive launch.
-  bool is_worker{false};
+  // The number of iterations the threads waiting for this job spin before sleep.
+  uint32_t spin_count{0};
 
  private:
+  // The next task to claim.
+  std::atomic<int32_t> next_task_{0};
   // The pending jobs.
-  std::atomic<int32_t> num_pending_;
+  std::atomic<int32_t> num_pending_{0};
   // Whether error has been countered.
-  std::atomic<bool> has_error_;
+  std::atomic<bool> has_error_{false};
+  // Whether the launching thread sleeps on cv_.
+  std::atomic<bool> waiting_{false};
+  // internal mutex and cv for the launching thread
+  std::mutex mutex_;
+  std::condition_variable cv_;
   // The counter page.
   std::atomic<int32_t>* sync_counter_{nullptr};
+  // The number of tasks the counter page can host.
+  int num_sync_counter_{0};
   // The error message
   std::vector<std::string> par_errors_;
+  // The job of the task running on this thread.
+  static thread_local ParallelLauncher* current_;
 };
 
-/*! \brief Lock-free single-producer-single-consumer queue for each thread */
-class SpscTaskQueue {
+thread_local ParallelLauncher* ParallelLauncher::current_ = nullptr;
+
+/*!
+ * \brief The tickets of the jobs waiting for a worker. A worker pops the tickets of its own
+ *  queue from the back, and steals the tickets of the other queues from the front.
+ */
+class WorkStealingQueue {
  public:
-  /*! \brief The task entry */
-  struct Task {
-    ParallelLauncher* launcher;
-    int32_t task_id;
+  /*! \brief A ticket lets the worker holding it participate to the job. */
+  struct Ticket {
+    std::shared_ptr<ParallelLauncher> launcher;
+    // When the ticket was pushed, to measure the queueing delay.
+    std::chrono::steady_clock::time_point push_time;
   };
 
-  SpscTaskQueue() : buffer_(new Task[kRingSize]), head_(0), tail_(0) {}
-
-  ~SpscTaskQueue() { delete[] buffer_; }
-
-  /*!
-   * \brief Push a task into the queue and notify the comsumer if it is on wait.
-   * \param input The task to be dequeued.
-   */
-  void Push(const Task& input) {
-    while (!Enqueue(input)) {
-      tvm::runtime::threading::Yield();
-    }
-    if (pending_.fetch_add(1) == -1) {
-      std::unique_lock<std::mutex> lock(mutex_);
-      cv_.notify_one();
-    }
+  void PushBack(Ticket ticket) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tickets_.push_back(std::move(ticket));
   }
 
-  /*!
-   * \brief Pop a task out of the queue and condition wait if no tasks.
-   * \param output The pointer to the task to be dequeued.
-   * \param spin_count The number of iterations to spin before sleep.
-   * \return Whether pop is successful (true) or we need to exit now (false).
-   */
-  bool Pop(Task* output, uint32_t spin_count) {
-    // Busy wait a bit when the queue is empty.
-    // If a new task comes to the queue quickly, this wait avoid the worker from sleeping.
-    // The default spin count is set by following the typical omp convention
-    for (uint32_t i = 0; i < spin_count && pending_.load() == 0; ++i) {
-      tvm::runtime::threading::Yield();
-    }
-    if (pending_.fetch_sub(1) == 0) {
-      std::unique_lock<std::mutex> lock(mutex_);
-      cv_.wait(lock, [this] { return pending_.load() >= 0 || exit_now_.load(); });
-    }
-    if (exit_now_.load(std::memory_order_relaxed)) {
-      return false;
-    }
-    const uint32_t head = head_.load(std::memory_order_relaxed);
-    // sanity check if the queue is empty
-    ICHECK(tail_.load(std::memory_order_acquire) != head);
-    *output = buffer_[head];
-    head_.store((head + 1) % kRingSize, std::memory_order_release);
+  bool PopBack(Ticket* ticket) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tickets_.empty()) return false;
+    *ticket = std::move(tickets_.back());
+    tickets_.pop_back();
     return true;
   }
 
-  /*!
-   * \brief Signal to terminate the worker.
-   */
-  void SignalForKill() {
+  bool PopFront(Ticket* ticket) {
     std::lock_guard<std::mutex> lock(mutex_);
-    exit_now_.store(true);
-    cv_.notify_all();
-  }
-
- protected:
-  /*!
-   * \brief Lock-free enqueue.
-   * \param input The task to be enqueued.
-   * \return Whether the task is enqueued.
-   */
-  bool Enqueue(const Task& input) {
-    if (exit_now_.load(std::memory_order_relaxed)) return false;
-
-    const uint32_t tail = tail_.load(std::memory_order_relaxed);
-
-    if ((tail + 1) % kRingSize != (head_.load(std::memory_order_acquire))) {
-      buffer_[tail] = input;
-      tail_.store((tail + 1) % kRingSize, std::memory_order_release);
-      return true;
-    }
-    return false;
+    if (tickets_.empty()) return false;
+    *ticket = std::move(tickets_.front());
+    tickets_.pop_front();
+    return true;
   }
 
-  // the cache line paddings are used for avoid false sharing between atomic variables
+ private:
+  // the cache line paddings are used for avoid false sharing between the queues
   typedef char cache_line_pad_t[kL1CacheBytes];
   cache_line_pad_t pad0_;
-  // size of the queue, the queue can host size_ - 1 items at most
-  // define it as a constant for better compiler optimization
-  static constexpr const int kRingSize = 2;
-  // pointer to access the item
-  Task* const buffer_;
-
-  cache_line_pad_t pad1_;
-  // queue head, where one gets a task from the queue
-  std::atomic<uint32_t> head_;
-
-  cache_line_pad_t pad2_;
-  // queue tail, when one puts a task to the queue
-  std::atomic<uint32_t> tail_;
-
-  cache_line_pad_t pad3_;
-  // pending tasks in the queue
-  std::atomic<int8_t> pending_{0};
-
-  cache_line_pad_t pad4_;
-  // signal for exit now
-  std::atomic<bool> exit_now_{false};
-
-  // internal mutex
   std::mutex mutex_;
-  // cv for consumer
-  std::condition_variable cv_;
+  std::deque<Ticket> tickets_;
+  cache_line_pad_t pad1_;
 };
 
-// The thread pool
+/*!
+ * \brief The thread pool.
+ *
+ *  By default each launching thread owns a pool. In the shared mode, the launching threads
+ *  share the workers of one process-wide pool: each launch only gets the workers which are
+ *  not already working for another launch, up to the quota of the launching thread, and
+ *  runs the rest of its tasks itself. A job with barriers only runs a task on each of the
+ *  granted workers and one on the launching thread.
+ */
 class ThreadPool {
  public:
-  ThreadPool() : num_workers_(tvm::runtime::threading::MaxConcurrency()) {
+  explicit ThreadPool(bool shared = false)
+      : num_workers_(tvm::runtime::threading::MaxConcurrency()), shared_(shared) {
     const char* exclude_worker0 = getenv("TVM_EXCLUDE_WORKER0");
     if (exclude_worker0 && atoi(exclude_worker0) == 0) {
       exclude_worker0_ = false;
@@ -267,112 +327,312 @@ class ThreadPool {
     Init();
   }
 
-  ~ThreadPool() {
-    for (std::unique_ptr<SpscTaskQueue>& q : queues_) {
-      q->SignalForKill();
-    }
-    threads_.reset();
-  }
+  ~ThreadPool() { Shutdown(); }
 
   void Reset() {
-    for (std::unique_ptr<SpscTaskQueue>& q : queues_) {
-      q->SignalForKill();
-    }
-    // Destroy threads before we destory the shared queue, otherwise we segfault on MacOS
-    threads_.reset();
-    queues_.clear();
+    Shutdown();
     Init();
   }
 
   int Launch(FTVMParallelLambda flambda, void* cdata, int num_task, int need_sync) {
-    ParallelLauncher* launcher = ParallelLauncher::ThreadLocal();
-    ICHECK(!launcher->is_worker)
-        << "Cannot launch parallel job inside worker, consider fuse then parallel";
-    if (num_task == 0) {
-      num_task = num_workers_used_;
-    }
+    static int tasks_per_worker = GetTasksPerWorker();
+    // A job launched from a task is nested, the workers may be busy with the outer job.
+    bool nested = ParallelLauncher::Current() != nullptr;
+    int num_workers_used = NumThreads();
     if (need_sync != 0) {
-      ICHECK_LE(num_task, num_workers_used_)
-          << "Request parallel sync task larger than number of threads used "
-          << " workers=" << num_workers_used_ << " request=" << num_task;
+      // The tasks of a job with barriers must all run at the same time, so the job is not
+      // over-decomposed. The workers are idle when the pool is owned by the launching thread,
+      // but may all be busy with the outer job of a nested one, which runs as a single task.
+      int max_task = nested ? 1 : num_workers_used;
+      num_task = num_task == 0 ? max_task : std::min(num_task, max_task);
+    } else if (num_task == 0) {
+      num_task = num_workers_used * tasks_per_worker;
     }
+    // use the main thread to run tasks
+    bool run_here = nested || shared_ || exclude_worker0_;
+    int num_tickets = std::min(num_task, num_workers_used) - (run_here ? 1 : 0);
+    if (shared_) {
+      num_tickets = AcquireWorkers(num_tickets);
+      // A shared launch may be granted fewer workers than tasks, even none. Only the granted
+      // workers and the launching thread are sure to run the tasks of a job with barriers at
+      // the same time.
+      if (need_sync != 0) {
+        num_task = num_tickets + 1;
+      }
+    }
+    std::shared_ptr<ParallelLauncher> launcher = ParallelLauncher::Acquire();
     launcher->Init(flambda, cdata, num_task, need_sync != 0);
-    SpscTaskQueue::Task tsk;
-    tsk.launcher = launcher;
-    // if worker0 is taken by the main, queues_[0] is abandoned
-    for (int i = exclude_worker0_; i < num_task; ++i) {
-      tsk.task_id = i;
-      queues_[i]->Push(tsk);
-    }
-    // use the main thread to run task 0
-    if (exclude_worker0_) {
-      TVMParallelGroupEnv* penv = &(tsk.launcher->env);
-      if ((*tsk.launcher->flambda)(0, penv, cdata) == 0) {
-        tsk.launcher->SignalJobFinish();
+    WorkStealingQueue::Ticket ticket{launcher, std::chrono::steady_clock::now()};
+    for (int i = 0; i < num_tickets; ++i) {
+      if (nested && worker_id_ >= 0) {
+        // Keep the tickets in the queue of this thread, the idle workers steal them.
+        queues_[worker_id_]->PushBack(ticket);
+      } else if (nested || shared_) {
+        queues_[next_queue_.fetch_add(1) % num_workers_used_.load()]->PushBack(ticket);
       } else {
-        tsk.launcher->SignalJobError(tsk.task_id);
+        // if worker0 is taken by the main, queues_[0] is abandoned
+        queues_[i + exclude_worker0_]->PushBack(ticket);
       }
     }
-    int res = launcher->WaitForJobs();
-    return res;
+    PublishTickets(num_tickets);
+    num_launches_.fetch_add(1, std::memory_order_relaxed);
+    if (run_here) {
+      launcher->RunTasks();
+    }
+    return launcher->WaitForJobs(&launcher_wait_time_);
   }
 
   static ThreadPool* ThreadLocal() { return dmlc::ThreadLocalStore<ThreadPool>::Get(); }
 
+  // The process-wide pool of the shared mode.
+  static ThreadPool* Global() {
+    // Never destroyed, the launching threads may still use it at exit.
+    static ThreadPool* pool = new ThreadPool(true);
+    return pool;
+  }
+
+  // Whether the launching threads share the process-wide pool.
+  static std::atomic<bool>& SharedMode() {
+    static std::atomic<bool> shared([] {
+      const char* val = getenv("TVM_THREAD_POOL_SHARED");
+      return val != nullptr && atoi(val) != 0;
+    }());
+    return shared;
+  }
+
+  // The pool of this thread: the pool it is a worker of, else the pool it launches jobs on.
+  static ThreadPool* Current() {
+    if (pool_ != nullptr) return pool_;
+    return SharedMode().load() ? Global() : ThreadLocal();
+  }
+
+  // Limit the number of workers of the shared pool used by the jobs of this thread.
+  static void SetLauncherQuota(int quota) { launcher_quota_ = quota; }
+
+  // The statistics of the pool, optionally resetting them.
+  Map<String, ObjectRef> GetStats(bool reset) {
+    auto count = [](int64_t value) { return ObjectRef(make_object<profiling::CountNode>(value)); };
+    auto duration_us = [](double microseconds) {
+      return ObjectRef(make_object<profiling::DurationNode>(microseconds));
+    };
+    int64_t num_tickets = num_tickets_run_.load();
+    double mean_queue_us = num_tickets == 0 ? 0.0 : total_queue_ns_.load() / 1e3 / num_tickets;
+    Map<String, ObjectRef> stats;
+    stats.Set("num_launches", count(num_launches_.load()));
+    stats.Set("num_tickets", count(num_tickets));
+    stats.Set("num_tickets_denied", count(num_tickets_denied_.load()));
+    stats.Set("mean_queue_delay_us", duration_us(mean_queue_us));
+    stats.Set("max_queue_delay_us", duration_us(max_queue_ns_.load() / 1e3));
+    stats.Set("launcher_spin_us", duration_us(launcher_wait_time_.spin_ns.load() / 1e3));
+    stats.Set("launcher_sleep_us", duration_us(launcher_wait_time_.sleep_ns.load() / 1e3));
+    Array<ObjectRef> workers;
+    for (const auto& wait_time : worker_wait_times_) {
+      Map<String, ObjectRef> worker;
+      worker.Set("spin_us", duration_us(wait_time->spin_ns.load() / 1e3));
+      worker.Set("sleep_us", duration_us(wait_time->sleep_ns.load() / 1e3));
+      workers.push_back(worker);
+    }
+    stats.Set("workers", workers);
+    if (reset) {
+      launcher_wait_time_.spin_ns.store(0);
+      launcher_wait_time_.sleep_ns.store(0);
+      for (const auto& wait_time : worker_wait_times_) {
+        wait_time->spin_ns.store(0);
+        wait_time->sleep_ns.store(0);
+      }
+      num_launches_.store(0);
+      num_tickets_run_.store(0);
+      num_tickets_denied_.store(0);
+      total_queue_ns_.store(0);
+      max_queue_ns_.store(0);
+    }
+    return stats;
+  }
+
   void UpdateWorkerConfiguration(threading::ThreadGroup::AffinityMode mode, int nthreads,
                                  const std::vector<unsigned int>& cpus) {
     // this will also reset the affinity of the ThreadGroup
     // may use less than the MaxConcurrency number of workers
-    num_workers_used_ = threads_->Configure(mode, nthreads, exclude_worker0_, cpus);
+    int num_workers_used = threads_->Configure(mode, nthreads, exclude_worker0_, cpus);
     // if MaxConcurrency restricted the number of workers (e.g., due to
     // hyperthreading), respect the restriction
-    num_workers_used_ = std::min(num_workers_, num_workers_used_);
+    num_workers_used_.store(std::min(num_workers_, num_workers_used));
   }
 
-  int32_t NumThreads() const { return num_workers_used_; }
+  int32_t NumThreads() const {
+    int num_workers_used = num_workers_used_.load();
+    if (shared_ && launcher_quota_ > 0) {
+      return std::min(num_workers_used, launcher_quota_);
+    }
+    return num_workers_used;
+  }
 
  private:
   // Shared initialization code
   void Init() {
     for (int i = 0; i < num_workers_; ++i) {
-      // The SpscTaskQueue only hosts ONE item at a time
-      queues_.emplace_back(std::make_unique<SpscTaskQueue>());
+      queues_.emplace_back(std::make_unique<WorkStealingQueue>());
+    }
+    if (worker_wait_times_.empty()) {
+      for (int i = 0; i < num_workers_; ++i) {
+        worker_wait_times_.emplace_back(std::make_unique<WaitTime>());
+      }
     }
     threads_ = std::make_unique<tvm::runtime::threading::ThreadGroup>(
         num_workers_, [this](int worker_id) { this->RunWorker(worker_id); },
         exclude_worker0_ /* include_main_thread */);
-    num_workers_used_ = threads_->Configure(threading::ThreadGroup::kBig, 0, exclude_worker0_);
+    num_workers_used_.store(
+        threads_->Configure(threading::ThreadGroup::kBig, 0, exclude_worker0_));
+    // An excluded worker 0 is the launching thread, not a thread of the pool.
+    free_workers_.store(num_workers_used_.load() - (exclude_worker0_ ? 1 : 0));
+  }
+
+  // Reserve up to n workers of the shared pool, return the number of reserved workers.
+  int AcquireWorkers(int n) {
+    if (n <= 0) return 0;
+    int free_workers = free_workers_.load();
+    int granted = 0;
+    do {
+      granted = std::max(std::min(n, free_workers), 0);
+    } while (granted != 0 && !free_workers_.compare_exchange_weak(free_workers,
+                                                                  free_workers - granted));
+    num_tickets_denied_.fetch_add(n - granted, std::memory_order_relaxed);
+    return granted;
+  }
+
+  // Record the queueing delay of a ticket popped by a worker.
+  void RecordQueueDelay(const WorkStealingQueue::Ticket& ticket) {
+    int64_t delay = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - ticket.push_time)
+                        .count();
+    num_tickets_run_.fetch_add(1, std::memory_order_relaxed);
+    total_queue_ns_.fetch_add(delay, std::memory_order_relaxed);
+    int64_t max_delay = max_queue_ns_.load(std::memory_order_relaxed);
+    while (delay > max_delay &&
+           !max_queue_ns_.compare_exchange_weak(max_delay, delay, std::memory_order_relaxed)) {
+    }
+  }
+
+  void Shutdown() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_now_.store(true);
+      cv_.notify_all();
+    }
+    // Destroy threads before we destory the queues, the workers may still be stealing.
+    threads_.reset();
+    queues_.clear();
+    num_tickets_.store(0);
+    exit_now_.store(false);
+  }
+
+  // Make the tickets pushed in the queues visible, and wake up the sleeping workers.
+  void PublishTickets(int num_tickets) {
+    if (num_tickets <= 0) return;
+    num_tickets_.fetch_add(num_tickets);
+    if (num_sleeping_.load() != 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cv_.notify_all();
+    }
+  }
+
+  // Pop a ticket from the queue of the worker, else steal one from the other queues.
+  bool PopTicket(int worker_id, WorkStealingQueue::Ticket* ticket) {
+    if (num_tickets_.load() == 0) return false;
+    bool found = queues_[worker_id]->PopBack(ticket);
+    for (int i = 1; !found && i < num_workers_; ++i) {
+      found = queues_[(worker_id + i) % num_workers_]->PopFront(ticket);
+    }
+    if (found) num_tickets_.fetch_sub(1);
+    return found;
+  }
+
+  // Whether the worker has tickets to pop, or should exit.
+  bool HasWork(int worker_id) const {
+    return exit_now_.load() || (worker_id < num_workers_used_.load() && num_tickets_.load() != 0);
   }
 
   // Internal worker function.
   void RunWorker(int worker_id) {
-    SpscTaskQueue* queue = queues_[worker_id].get();
-    SpscTaskQueue::Task task;
-    ParallelLauncher::ThreadLocal()->is_worker = true;
-    // Initialize the spin count (from envvar TVM_THREAD_POOL_SPIN_COUNT) on
-    // the global first use of the ThreadPool.
-    // TODO(tulloch): should we make this configurable via standard APIs?
-    static size_t spin_count = GetSpinCount();
-    while (queue->Pop(&task, spin_count)) {
-      ICHECK(task.launcher != nullptr);
-      TVMParallelGroupEnv* penv = &(task.launcher->env);
-      void* cdata = task.launcher->cdata;
-      if ((*task.launcher->flambda)(task.task_id, penv, cdata) == 0) {
-        task.launcher->SignalJobFinish();
-      } else {
-        task.launcher->SignalJobError(task.task_id);
+    pool_ = this;
+    worker_id_ = worker_id;
+    // The spin count of the last job run by the worker.
+    uint32_t spin_count = GetLaunchSpinCount();
+    WorkStealingQueue::Ticket ticket;
+    while (true) {
+      if (worker_id < num_workers_used_.load() && PopTicket(worker_id, &ticket)) {
+        RecordQueueDelay(ticket);
+        spin_count = ticket.launcher->spin_count;
+        ticket.launcher->RunTasks();
+        ticket.launcher.reset();
+        if (shared_) free_workers_.fetch_add(1);
+        continue;
       }
+      // Busy wait a bit when there is no ticket.
+      // If a new job comes quickly, this wait avoid the worker from sleeping.
+      // The default spin count is set by following the typical omp convention
+      worker_wait_times_[worker_id]->Wait(
+          spin_count, [this, worker_id] { return HasWork(worker_id); },
+          [this, worker_id] {
+            std::unique_lock<std::mutex> lock(mutex_);
+            num_sleeping_.fetch_add(1);
+            cv_.wait(lock, [this, worker_id] { return HasWork(worker_id); });
+            num_sleeping_.fetch_sub(1);
+          });
+      if (exit_now_.load()) return;
     }
   }
+
+  static int GetTasksPerWorker() {
+    const char* val = getenv("TVM_THREAD_POOL_TASKS_PER_WORKER");
+    if (val == nullptr || atoi(val) <= 0) return 1;
+    return atoi(val);
+  }
+
   int num_workers_;
+  // Whether this is the process-wide pool of the shared mode.
+  bool shared_;
   // number of workers used (can be restricted with affinity pref)
-  int num_workers_used_;
+  std::atomic<int> num_workers_used_{0};
+  // The number of workers of the shared pool which are not reserved by a launch.
+  std::atomic<int> free_workers_{0};
+  // The queue the next ticket of a nested or shared launch is pushed to.
+  std::atomic<uint32_t> next_queue_{0};
+  // The statistics of the pool.
+  std::atomic<int64_t> num_launches_{0};
+  std::atomic<int64_t> num_tickets_run_{0};
+  std::atomic<int64_t> num_tickets_denied_{0};
+  std::atomic<int64_t> total_queue_ns_{0};
+  std::atomic<int64_t> max_queue_ns_{0};
+  // The time the launching threads and each worker spent waiting.
+  WaitTime launcher_wait_time_;
+  std::vector<std::unique_ptr<WaitTime>> worker_wait_times_;
   // if or not to exclude worker 0 and use main to run task 0
   bool exclude_worker0_{true};
-  std::vector<std::unique_ptr<SpscTaskQueue>> queues_;
+  std::vector<std::unique_ptr<WorkStealingQueue>> queues_;
   std::unique_ptr<tvm::runtime::threading::ThreadGroup> threads_;
+  // The number of tickets in the queues.
+  std::atomic<int> num_tickets_{0};
+  // The number of workers sleeping on cv_.
+  std::atomic<int> num_sleeping_{0};
+  // signal for exit now
+  std::atomic<bool> exit_now_{false};
+  // internal mutex and cv for the sleeping workers
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  friend class ParallelLauncher;
+  // The pool this thread is a worker of, nullptr if it is not a worker.
+  static thread_local ThreadPool* pool_;
+  // The id of this thread in the pool it is a worker of.
+  static thread_local int worker_id_;
+  // The maximum number of workers of the shared pool the jobs of this thread use, 0 for all.
+  static thread_local int launcher_quota_;
 };
 
+thread_local ThreadPool* ThreadPool::pool_ = nullptr;
+thread_local int ThreadPool::worker_id_ = -1;
+thread_local int ThreadPool::launcher_quota_ = 0;
+
 /*!
  * \brief args[0] is the AffinityMode, args[1] is the number of threads.
  *  args2 is a list of CPUs which is used to set the CPU affinity.
@@ -396,6 +656,17 @@ TVM_REGISTER_GLOBAL("runtime.NumThreads").set_body_typed([]() -> int32_t {
   return threading::NumThreads();
 });
 
+TVM_REGISTER_GLOBAL("runtime.config_threadpool_shared").set_body_typed([](bool shared) {
+  ThreadPool::SharedMode().store(shared);
+});
+
+TVM_REGISTER_GLOBAL("runtime.config_threadpool_spin_count")
+    .set_body_typed([](int64_t spin_count) { threading::SetLaunchSpinCount(spin_count); });
+
+TVM_REGISTER_GLOBAL("runtime.ThreadPoolStats").set_body_typed([](bool reset) {
+  return ThreadPool::Current()->GetStats(reset);
+});
+
 namespace threading {
 
 #if TVM_THREADPOOL_USE_OPENMP
@@ -448,6 +719,9 @@ static void ConfigureOMP(tvm::runtime::threading::ThreadGroup::AffinityMode mode
 
 #endif
 
+/*! \brief The CPUs given to Configure by the calling thread, empty for the default ones. */
+thread_local std::vector<unsigned int> configured_cpus;
+
 void ResetThreadPool() { tvm::runtime::ThreadPool::ThreadLocal()->Reset(); }
 /*!
  * \brief configure the CPU id affinity
@@ -460,13 +734,44 @@ void ResetThreadPool() { tvm::runtime::ThreadPool::ThreadLocal()->Reset(); }
 TVM_DLL void Configure(tvm::runtime::threading::ThreadGroup::AffinityMode mode, int nthreads,
                        std::vector<unsigned int> cpus) {
   tvm::runtime::threading::SetMaxConcurrency(cpus.size());
+  configured_cpus = cpus;
 #if !TVM_THREADPOOL_USE_OPENMP
-  tvm::runtime::ThreadPool::ThreadLocal()->UpdateWorkerConfiguration(mode, nthreads, cpus);
+  if (tvm::runtime::ThreadPool::SharedMode().load()) {
+    // The workers of the shared pool serve all the launching threads, only limit the
+    // number of workers this thread uses instead of binding them.
+    tvm::runtime::ThreadPool::SetLauncherQuota(nthreads != 0 ? nthreads : cpus.size());
+  } else {
+    tvm::runtime::ThreadPool::ThreadLocal()->UpdateWorkerConfiguration(mode, nthreads, cpus);
+  }
 #else
   ConfigureOMP(mode, nthreads, cpus);
 #endif
 }
-int32_t NumThreads() { return tvm::runtime::ThreadPool::ThreadLocal()->NumThreads(); }
+std::vector<unsigned int> GetCpuIds() {
+  if (!configured_cpus.empty()) return configured_cpus;
+  std::vector<unsigned int> cpus;
+#if defined(__linux__) || defined(__ANDROID__)
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  if (sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0) {
+    for (unsigned int i = 0; i < CPU_SETSIZE; ++i) {
+      if (CPU_ISSET(i, &cpuset)) cpus.push_back(i);
+    }
+  }
+#endif
+  if (cpus.empty()) {
+    for (unsigned int i = 0; i < std::thread::hardware_concurrency(); ++i) {
+      cpus.push_back(i);
+    }
+  }
+  // Like the default configuration of the pool, leave the hyper-threads out.
+  cpus.resize(std::min(cpus.size(), static_cast<size_t>(MaxConcurrency())));
+  return cpus;
+}
+
+int32_t NumThreads() { return tvm::runtime::ThreadPool::Current()->NumThreads(); }
+
+void SetLaunchSpinCount(int64_t spin_count) { launch_spin_count = spin_count; }
 }  // namespace threading
 }  // namespace runtime
 }  // namespace tvm
@@ -482,7 +787,7 @@ int TVMBackendParallelLaunch(FTVMParallelLambda flambda, void* cdata, int num_ta
     return 0;
   } else {
 #if !TVM_THREADPOOL_USE_OPENMP
-    int res = tvm::runtime::ThreadPool::ThreadLocal()->Launch(flambda, cdata, num_task, 1);
+    int res = tvm::runtime::ThreadPool::Current()->Launch(flambda, cdata, num_task, 1);
     return res;
 #else
     if (num_task == 0) num_task = num_workers;
@@ -20,6 +20,7 @@
 #include <dmlc/logging.h>
 #include <gtest/gtest.h>
 #include <tvm/runtime/c_backend_api.h>
+#include <tvm/runtime/registry.h>
 #include <tvm/runtime/threading_backend.h>
 
 #include <atomic>
@@ -146,6 +147,125 @@ TEST(ThreadingBackend, TVMBackendParallelLaunchMultipleThreads) {
   }
 }
 
+TEST(ThreadingBackend, TVMBackendParallelLaunchNested) {
+  std::atomic<size_t> acc(0);
+  FTVMParallelLambda outer = [](int task_id, TVMParallelGroupEnv* penv, void* cdata) -> int {
+    return TVMBackendParallelLaunch(atomic_add_task_id, cdata, 0);
+  };
+  TVMBackendParallelLaunch(outer, &acc, 0);
+  int num_threads = tvm::runtime::threading::NumThreads();
+  EXPECT_EQ(acc.load(std::memory_order_relaxed), num_threads * N * (N - 1) / 2);
+}
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchUnevenTasks) {
+  // More tasks than threads are requested, with a barrier: the job runs as many tasks as
+  // threads, all at the same time.
+  std::atomic<size_t> acc(0);
+  FTVMParallelLambda triangular = [](int task_id, TVMParallelGroupEnv* penv, void* cdata) -> int {
+    auto* data = reinterpret_cast<std::atomic<size_t>*>(cdata);
+    for (int i = 0; i <= task_id; ++i) {
+      data->fetch_add(1, std::memory_order_relaxed);
+    }
+    TVMBackendParallelBarrier(task_id, penv);
+    // All the tasks have done their increments before any of them passes the barrier.
+    size_t num_task = penv->num_task;
+    return data->load(std::memory_order_relaxed) == num_task * (num_task + 1) / 2 ? 0 : -1;
+  };
+  EXPECT_EQ(TVMBackendParallelLaunch(triangular, &acc, 64), 0);
+  size_t num_threads = tvm::runtime::threading::NumThreads();
+  EXPECT_EQ(acc.load(std::memory_order_relaxed), num_threads * (num_threads + 1) / 2);
+}
+
+static FTVMParallelLambda two_barriers = [](int task_id, TVMParallelGroupEnv* penv,
+                                            void* cdata) -> int {
+  auto* data = reinterpret_cast<std::atomic<size_t>*>(cdata);
+  data->fetch_add(1, std::memory_order_relaxed);
+  TVMBackendParallelBarrier(task_id, penv);
+  bool first_loop_done = data->load(std::memory_order_relaxed) == size_t(penv->num_task);
+  TVMBackendParallelBarrier(task_id, penv);
+  data->fetch_add(1, std::memory_order_relaxed);
+  return first_loop_done ? 0 : -1;
+};
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchTwoBarriers) {
+  // Two parallel loops in one launch, with more tasks requested than threads.
+  int num_task = 4 * tvm::runtime::threading::MaxConcurrency();
+  std::atomic<size_t> acc(0);
+  EXPECT_EQ(TVMBackendParallelLaunch(two_barriers, &acc, num_task), 0);
+  EXPECT_EQ(acc.load(std::memory_order_relaxed),
+            2 * size_t(tvm::runtime::threading::NumThreads()));
+
+  // A job with barriers nested in the tasks of an outer job, whose tasks keep the workers,
+  // runs as a single task.
+  FTVMParallelLambda outer = [](int task_id, TVMParallelGroupEnv* penv, void* cdata) -> int {
+    std::atomic<size_t> acc(0);
+    if (TVMBackendParallelLaunch(two_barriers, &acc, 8) != 0) return -1;
+    return acc.load(std::memory_order_relaxed) == 2 ? 0 : -1;
+  };
+  EXPECT_EQ(TVMBackendParallelLaunch(outer, nullptr, 2), 0);
+}
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchSharedPool) {
+  const auto* config_shared = tvm::runtime::Registry::Get("runtime.config_threadpool_shared");
+  ASSERT_NE(config_shared, nullptr);
+  (*config_shared)(true);
+  std::vector<std::unique_ptr<std::thread>> ts;
+  for (int i = 0; i < 4; ++i) {
+    ts.emplace_back(new std::thread([i]() {
+      // Limit the share of the workers of half of the launching threads.
+      if (i % 2 == 0) {
+        tvm::runtime::threading::Configure(tvm::runtime::threading::ThreadGroup::kBig, 1, {});
+      }
+      for (int j = 0; j < 8; ++j) {
+        std::atomic<size_t> acc(0);
+        EXPECT_EQ(TVMBackendParallelLaunch(atomic_add_task_id, &acc, 0), 0);
+        EXPECT_EQ(acc.load(std::memory_order_relaxed), N * (N - 1) / 2);
+      }
+    }));
+  }
+  for (auto& t : ts) {
+    t->join();
+  }
+  (*config_shared)(false);
+}
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchSharedPoolBarrier) {
+  // The launches compete for the shared workers, some get none of them. A job with barriers
+  // runs one task on each granted worker and one on the launching thread.
+  const auto* config_shared = tvm::runtime::Registry::Get("runtime.config_threadpool_shared");
+  ASSERT_NE(config_shared, nullptr);
+  (*config_shared)(true);
+  std::vector<std::unique_ptr<std::thread>> ts;
+  for (int i = 0; i < 4; ++i) {
+    ts.emplace_back(new std::thread([]() {
+      for (int j = 0; j < 8; ++j) {
+        int num_task = tvm::runtime::threading::MaxConcurrency();
+        std::atomic<size_t> acc(0);
+        EXPECT_EQ(TVMBackendParallelLaunch(two_barriers, &acc, num_task), 0);
+        size_t num_run = acc.load(std::memory_order_relaxed) / 2;
+        EXPECT_EQ(acc.load(std::memory_order_relaxed), 2 * num_run);
+        EXPECT_GE(num_run, 1);
+        EXPECT_LE(num_run, size_t(num_task));
+      }
+    }));
+  }
+  for (auto& t : ts) {
+    t->join();
+  }
+  (*config_shared)(false);
+}
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchNoSpin) {
+  // The launching thread and the workers sleep as soon as they have to wait.
+  tvm::runtime::threading::SetLaunchSpinCount(0);
+  for (int i = 0; i < 8; ++i) {
+    std::atomic<size_t> acc(0);
+    EXPECT_EQ(TVMBackendParallelLaunch(atomic_add_task_id, &acc, 0), 0);
+    EXPECT_EQ(acc.load(std::memory_order_relaxed), N * (N - 1) / 2);
+  }
+  tvm::runtime::threading::SetLaunchSpinCount(-1);
+}
+
 TEST(ThreadingBackend, TVMBackendAffinityConfigure) {
   int max_concurrency = tvm::runtime::threading::MaxConcurrency();
   std::vector<std::unique_ptr<std::thread>> ts;
@@ -185,3 +305,18 @@ TEST(ThreadingBackend, TVMBackendAffinityConfigure) {
     t->join();
   }
 }
+
+TEST(ThreadingBackend, GetCpuIds) {
+  std::thread t([]() {
+    // By default, the CPUs of the affinity mask without the hyper-threads.
+    std::vector<unsigned int> cpus = tvm::runtime::threading::GetCpuIds();
+    EXPECT_FALSE(cpus.empty());
+    EXPECT_LE(cpus.size(), static_cast<size_t>(tvm::runtime::threading::MaxConcurrency()));
+    // Once configured, the CPUs given to the thread pool.
+    std::vector<unsigned int> configured = {cpus.back()};
+    tvm::runtime::threading::Configure(
+        tvm::runtime::threading::ThreadGroup::kSpecifyThreadShareAllCore, 0, configured);
+    EXPECT_EQ(tvm::runtime::threading::GetCpuIds(), configured);
+  });
+  t.join();
+}
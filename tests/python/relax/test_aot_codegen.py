@@ -0,0 +1,89 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import numpy as np
+import pytest
+import tvm
+import tvm.script
+import tvm.testing
+from tvm import relax
+from tvm.contrib import utils
+from tvm.script import relax as R, tir as T
+
+
+@tvm.script.ir_module
+class TestAOTModule:
+    @T.prim_func
+    def addone(A: T.Buffer[(16, 16), "float32"], B: T.Buffer[(16, 16), "float32"]) -> None:
+        for i, j in T.grid(16, 16):
+            with T.block("addone"):
+                vi, vj = T.axis.remap("SS", [i, j])
+                B[vi, vj] = A[vi, vj] + T.float32(1)
+
+    @T.prim_func
+    def add(
+        A: T.Buffer[(16, 16), "float32"],
+        B: T.Buffer[(16, 16), "float32"],
+        C: T.Buffer[(16, 16), "float32"],
+    ) -> None:
+        for i, j in T.grid(16, 16):
+            with T.block("add"):
+                vi, vj = T.axis.remap("SS", [i, j])
+                C[vi, vj] = A[vi, vj] + B[vi, vj]
+
+    @R.function
+    def main(x: R.Tensor((16, 16), "float32"), y: R.Tensor((16, 16), "float32")):
+        with R.dataflow():
+            lv0 = R.call_tir(addone, (x,), (16, 16), dtype="float32")
+            lv1 = R.call_tir(addone, (lv0,), (16, 16), dtype="float32")
+            lv2 = R.call_tir(add, (lv1, y), (16, 16), dtype="float32")
+            R.output(lv2)
+        return lv2
+
+
+def test_aot_build():
+    lib = relax.aot.build(TestAOTModule, "llvm")
+    source = lib.get_source()
+    assert "tvmgen_default_main_arena" in source
+    assert "RelaxVM" not in source
+
+    temp_dir = utils.tempdir()
+    path = temp_dir.relpath("aot.so")
+    lib.export_library(path)
+    func = tvm.runtime.load_module(path)["tvmgen_default_main"]
+
+    x = np.random.rand(16, 16).astype("float32")
+    y = np.random.rand(16, 16).astype("float32")
+    for _ in range(2):
+        res = func(tvm.nd.array(x), tvm.nd.array(y))
+        tvm.testing.assert_allclose(res.numpy(), x + 2 + y, rtol=1e-7, atol=1e-7)
+
+
+def test_aot_dynamic_shape_unsupported():
+    @tvm.script.ir_module
+    class Module:
+        @R.function
+        def main(x: R.Tensor(("n",), "float32")) -> R.Tensor:
+            n = T.var("int64")
+            gv = R.call_tir("test.op.identity", (x,), (n,), dtype="float32")
+            return gv
+
+    with pytest.raises(tvm.TVMError):
+        relax.aot.build(Module, "llvm")
+
+
+if __name__ == "__main__":
+    tvm.testing.main()
@@ -227,6 +227,37 @@ def test_meta_schedule_extract_tasks():
         assert task.task_name in expected_weights
         assert expected_weights[task.task_name] == task.weight
 
+    # The workloads shared by several models are a single task.
+    tasks = ms.relax_integration.extract_tasks([Module, Module], Target("llvm --num-cores=16"))
+    assert len(tasks) == len(expected_weights)
+    for task in tasks:
+        assert 2 * expected_weights[task.task_name] == task.weight
+
+    # The tasks already tuned for their target in the database are skipped. The build and run
+    # failures are committed with a run time of 1e10 seconds, they do not count as tuned.
+    database = ms.database.MemoryDatabase()
+    for task_name, target, run_secs in [
+        ("add1", tasks[0].target, [1.0]),
+        ("add2", Target("llvm"), [1.0]),
+        ("multiply1", tasks[0].target, [1e10]),
+    ]:
+        tuned = [task for task in tasks if task.task_name == task_name][0]
+        workload = database.commit_workload(tuned.dispatched[0])
+        database.commit_tuning_record(
+            ms.database.TuningRecord(
+                tvm.tir.Schedule(tuned.dispatched[0]).trace,
+                workload,
+                run_secs,
+                target,
+                ms.arg_info.ArgInfo.from_prim_func(func=tuned.dispatched[0]["main"]),
+            )
+        )
+    num_workloads = len(database.workloads)
+    new_tasks = ms.relax_integration.filter_tuned_tasks(tasks, database)
+    assert sorted(task.task_name for task in new_tasks) == ["add2", "multiply1"]
+    # The filter does not commit the workloads of the tasks to the database.
+    assert len(database.workloads) == num_workloads
+
 
 if __name__ == "__main__":
     pytest.main([__file__])
@@ -437,5 +437,68 @@ def test_vm_shape_lowering_func_param_with_shape():
     assert s5.op.name == "relax.vm.builtin.store_shape"
 
 
+def test_vm_shape_lowering_batched_shape_func():
+    @tvm.script.ir_module
+    class TestVMShapeLower:
+        @R.function
+        def foo(x: R.Tensor(("n", "m"), "float32")) -> R.Tensor:
+            n, m = T.var("int64"), T.var("int64")
+            gv0 = R.call_tir("test.op.identity", (x,), (n * 2, m), dtype="float32")
+            gv1 = R.call_tir("test.op.identity", (gv0,), (n * 2, m * 3), dtype="float32")
+            return gv1
+
+    new_mod = relax.transform.VMShapeLower()(TestVMShapeLower)
+
+    # A single shape function fills the heap for both shapes, which are then only loaded.
+    bindings = [b for block in new_mod["foo"].body.blocks for b in block.bindings]
+    shape_func_calls = [b for b in bindings if isinstance(b.value.op, relax.GlobalVar)]
+    load_shapes = [
+        b
+        for b in bindings
+        if isinstance(b.value.op, tvm.ir.Op) and b.value.op.name == "relax.vm.builtin.load_shape"
+    ]
+    assert len(shape_func_calls) == 1
+    assert len(load_shapes) == 2
+
+
+def test_vm_shape_lowering_batched_shape_func_in_branch():
+    @tvm.script.ir_module
+    class TestVMShapeLower:
+        @R.function
+        def foo(cond: R.Tensor((), "bool"), x: R.Tensor(("n", "m"), "float32")) -> R.Tensor:
+            n, m = T.var("int64"), T.var("int64")
+            gv0 = R.call_tir("test.op.identity", (x,), (n * 2, m), dtype="float32")
+            if cond:
+                w = R.call_tir("test.op.identity", (gv0,), (n * 4, m), dtype="float32")
+            else:
+                w = gv0
+            return w
+
+    new_mod = relax.transform.VMShapeLower()(TestVMShapeLower)
+
+    def shape_func_stores(seq):
+        bindings = [b for block in seq.blocks for b in block.bindings]
+        calls = [
+            b.value
+            for b in bindings
+            if isinstance(b.value, relax.Call) and isinstance(b.value.op, relax.GlobalVar)
+        ]
+        assert len(calls) == 1
+        stores = []
+        tvm.tir.stmt_functor.post_order_visit(
+            new_mod[calls[0].op].body,
+            lambda stmt: stores.append(stmt) if isinstance(stmt, tvm.tir.BufferStore) else None,
+        )
+        return len(stores)
+
+    # The shape only used in the branch is computed by a shape function of the branch.
+    body = new_mod["foo"].body
+    assert shape_func_stores(body) == 1
+    if_node = [
+        b.value for block in body.blocks for b in block.bindings if isinstance(b.value, relax.If)
+    ][0]
+    assert shape_func_stores(if_node.true_branch) == 1
+
+
 if __name__ == "__main__":
     pytest.main([__file__])
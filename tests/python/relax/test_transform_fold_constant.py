@@ -276,5 +276,85 @@ def test_int32_fold():
     tvm.ir.assert_structural_equal(after, expected)
 
 
+def test_fold_in_parallel_with_shared_kernel():
+    @tvm.script.ir_module
+    class Module:
+        @T.prim_func
+        def addone(A: T.Buffer[(16, 16), "float32"], B: T.Buffer[(16, 16), "float32"]) -> None:
+            for i, j in T.grid(16, 16):
+                with T.block("addone"):
+                    vi, vj = T.axis.remap("SS", [i, j])
+                    B[vi, vj] = A[vi, vj] + T.float32(1)
+
+        @T.prim_func
+        def addone1(A: T.Buffer[(16, 16), "float32"], B: T.Buffer[(16, 16), "float32"]) -> None:
+            for i, j in T.grid(16, 16):
+                with T.block("addone"):
+                    vi, vj = T.axis.remap("SS", [i, j])
+                    B[vi, vj] = A[vi, vj] + T.float32(1)
+
+        @R.function
+        def before(c0: R.Tensor((16, 16), "float32")):
+            lv0 = relax.call_tir(addone, (c0,), (16, 16), dtype="float32")
+            lv1 = relax.call_tir(addone1, (lv0,), (16, 16), dtype="float32")
+            return lv1
+
+        @R.function
+        def expected(c1: R.Tensor((16, 16), "float32"), c2: R.Tensor((16, 16), "float32")):
+            lv0 = c1
+            lv1 = c2
+            return c2
+
+    c0_np = np.arange((16 * 16)).astype("float32").reshape(16, 16)
+    c1_np = c0_np + 1
+    c2_np = c1_np + 1
+    before = gen_mod(Module, "before", {"c0": c0_np})
+    expected = gen_mod(Module, "expected", {"c1": c1_np, "c2": c2_np})
+
+    # Count the kernels built, addone and addone1 must share one.
+    llvm_build = tvm.get_global_func("target.build.llvm")
+    num_builds = [0]
+
+    def counting_build(mod, target):
+        num_builds[0] += 1
+        return llvm_build(mod, target)
+
+    tvm.register_func("target.build.llvm", counting_build, override=True)
+    try:
+        with tvm.transform.PassContext(config={"relax.FoldConstant.num_threads": 2}):
+            after = relax.transform.FoldConstant()(before)
+    finally:
+        tvm.register_func("target.build.llvm", llvm_build, override=True)
+    tvm.ir.assert_structural_equal(after, expected)
+    assert num_builds[0] == 1
+
+
+def test_skip_large_broadcast():
+    @tvm.script.ir_module
+    class Module:
+        @T.prim_func
+        def broadcast(A: T.Buffer[(4,), "float32"], B: T.Buffer[(1024, 4), "float32"]) -> None:
+            for i, j in T.grid(1024, 4):
+                with T.block("broadcast"):
+                    vi, vj = T.axis.remap("SS", [i, j])
+                    B[vi, vj] = A[vj]
+
+        @R.function
+        def before(c0: R.Tensor((4,), "float32")):
+            lv0 = relax.call_tir(broadcast, (c0,), (1024, 4), dtype="float32")
+            return lv0
+
+    before = gen_mod(Module, "before", {"c0": np.arange(4).astype("float32")})
+    with tvm.transform.PassContext(config={"relax.FoldConstant.max_size_ratio": 4}):
+        after = relax.transform.FoldConstant()(before)
+    tvm.ir.assert_structural_equal(after, before)
+
+    after = relax.transform.FoldConstant()(before)
+    assert len(after["main"].body.blocks[0].bindings) == 1
+    binding = after["main"].body.blocks[0].bindings[0]
+    assert isinstance(binding.value, relax.Constant)
+    assert binding.value.data.shape == (1024, 4)
+
+
 if __name__ == "__main__":
     tvm.testing.main()
@@ -755,5 +755,176 @@ def test_softmax():
     _check(before(), expected())
 
 
+def test_fuse_non_main_function():
+    """Test that the functions other than main are fused."""
+
+    def before():
+        bb = relax.BlockBuilder()
+        x = relax.Var("x", R.Tensor([10, 20], "float32"))
+        with bb.function("helper", [x]):
+            with bb.dataflow():
+                lv0 = bb.emit_te(topi.add, x, x)
+                gv = bb.emit_output(bb.call_te(topi.exp, lv0))
+            bb.emit_func_output(gv)
+
+        return bb.get()
+
+    def expected():
+        bb = relax.BlockBuilder()
+        x = relax.Var("x", R.Tensor([10, 20], "float32"))
+        with bb.function("fused_add_exp", [x], attrs={"Primitive": 1}):
+            with bb.dataflow():
+                lv0 = bb.emit_te(topi.add, x, x)
+                gv = bb.emit_output(bb.call_te(topi.exp, lv0))
+            bb.emit_func_output(gv)
+        fused_add_exp = bb.get().get_global_var("fused_add_exp")
+
+        x = relax.Var("x", R.Tensor([10, 20], "float32"))
+        with bb.function("helper", [x]):
+            with bb.dataflow():
+                gv = bb.emit_output(relax.Call(fused_add_exp, [x]))
+            bb.emit_func_output(gv)
+
+        return bb.get()
+
+    _check(before(), expected())
+
+
+def _emit_nested_seq(bb, params, emit_body):
+    """Emit a dataflow block in a nested scope of the current function, e.g. a branch."""
+    bb.begin_scope(params)
+    bb._begin_dataflow_block()
+    output = emit_body()
+    block = bb._end_block()
+    bb.end_scope()
+    return relax.SeqExpr([block], output)
+
+
+def _emit_fused_add_exp(bb):
+    x = relax.Var("x", R.Tensor([10, 20], "float32"))
+    with bb.function("fused_add_exp", [x], attrs={"Primitive": 1}):
+        with bb.dataflow():
+            lv0 = bb.emit_te(topi.add, x, x)
+            gv = bb.emit_output(bb.call_te(topi.exp, lv0))
+        bb.emit_func_output(gv)
+    return bb.get().get_global_var("fused_add_exp")
+
+
+def test_fuse_if_branch():
+    """Test that the dataflow blocks in the branches of an If are fused."""
+
+    def before():
+        bb = relax.BlockBuilder()
+        cond = relax.Var("cond", R.Tensor((), "bool"))
+        x = relax.Var("x", R.Tensor([10, 20], "float32"))
+        with bb.function("main", [cond, x]):
+
+            def true_branch():
+                lv0 = bb.emit_te(topi.add, x, x)
+                return bb.emit_output(bb.call_te(topi.exp, lv0))
+
+            then_seq = _emit_nested_seq(bb, None, true_branch)
+            gv = bb.emit(relax.If(cond, then_seq, relax.SeqExpr([], x)))
+            bb.emit_func_output(gv)
+
+        return bb.get()
+
+    def expected():
+        bb = relax.BlockBuilder()
+        fused_add_exp = _emit_fused_add_exp(bb)
+
+        cond = relax.Var("cond", R.Tensor((), "bool"))
+        x = relax.Var("x", R.Tensor([10, 20], "float32"))
+        with bb.function("main", [cond, x]):
+
+            def true_branch():
+                return bb.emit_output(relax.Call(fused_add_exp, [x]))
+
+            then_seq = _emit_nested_seq(bb, None, true_branch)
+            gv = bb.emit(relax.If(cond, then_seq, relax.SeqExpr([], x)))
+            bb.emit_func_output(gv)
+
+        return bb.get()
+
+    _check(before(), expected())
+
+
+def test_fuse_closure():
+    """Test that the dataflow blocks in a function defined inside another function are fused."""
+
+    def before():
+        bb = relax.BlockBuilder()
+        x = relax.Var("x", R.Tensor([10, 20], "float32"))
+        with bb.function("main", [x]):
+            y = relax.Var("y", R.Tensor([10, 20], "float32"))
+
+            def closure_body():
+                lv0 = bb.emit_te(topi.add, y, y)
+                return bb.emit_output(bb.call_te(topi.exp, lv0))
+
+            closure = bb.emit(relax.Function([y], _emit_nested_seq(bb, [y], closure_body)))
+            gv = bb.emit(relax.Call(closure, [x]))
+            bb.emit_func_output(gv)
+
+        return bb.get()
+
+    def expected():
+        bb = relax.BlockBuilder()
+        fused_add_exp = _emit_fused_add_exp(bb)
+
+        x = relax.Var("x", R.Tensor([10, 20], "float32"))
+        with bb.function("main", [x]):
+            y = relax.Var("y", R.Tensor([10, 20], "float32"))
+
+            def closure_body():
+                return bb.emit_output(relax.Call(fused_add_exp, [y]))
+
+            closure = bb.emit(relax.Function([y], _emit_nested_seq(bb, [y], closure_body)))
+            gv = bb.emit(relax.Call(closure, [x]))
+            bb.emit_func_output(gv)
+
+        return bb.get()
+
+    _check(before(), expected())
+
+
+def test_fuse_reduction_epilogue():
+    """Test that a reduction is fused with its elementwise consumer when enabled."""
+
+    def before():
+        bb = relax.BlockBuilder()
+        x = relax.Var("x", R.Tensor([10, 20], "float32"))
+        with bb.function("main", [x]):
+            with bb.dataflow():
+                lv0 = bb.emit_te(topi.sum, x, axis=1)
+                gv = bb.emit_output(bb.call_te(topi.exp, lv0))
+            bb.emit_func_output(gv)
+
+        return bb.get()
+
+    def expected():
+        bb = relax.BlockBuilder()
+        x = relax.Var("x", R.Tensor([10, 20], "float32"))
+        with bb.function("fused_sum_exp", [x], attrs={"Primitive": 1}):
+            with bb.dataflow():
+                lv0 = bb.emit_te(topi.sum, x, axis=1)
+                gv = bb.emit_output(bb.call_te(topi.exp, lv0))
+            bb.emit_func_output(gv)
+        fused_sum_exp = bb.get().get_global_var("fused_sum_exp")
+
+        x = relax.Var("x", R.Tensor([10, 20], "float32"))
+        with bb.function("main", [x]):
+            with bb.dataflow():
+                gv = bb.emit_output(relax.Call(fused_sum_exp, [x]))
+            bb.emit_func_output(gv)
+
+        return bb.get()
+
+    # The reduction is not fused by default.
+    _check(before(), relax.transform.AnnotateTIROpPattern()(before()))
+    with tvm.transform.PassContext(config={"relax.FuseOps.fuse_reduction_epilogue": True}):
+        _check(before(), expected())
+
+
 if __name__ == "__main__":
     tvm.testing.main()
@@ -0,0 +1,232 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import numpy as np
+import tvm
+import tvm.testing
+from tvm import relax
+from tvm.script import relax as R, tir as T
+
+
+@tvm.script.ir_module
+class Alias:
+    @T.prim_func
+    def add_one(A: T.Buffer[(2, 4), "float32"], B: T.Buffer[(2, 4), "float32"]) -> None:
+        for i, j in T.grid(2, 4):
+            with T.block("add_one"):
+                vi, vj = T.axis.remap("SS", [i, j])
+                B[vi, vj] = A[vi, vj] + T.float32(1)
+
+    @R.function
+    def tuple_alias(x: R.Tensor((2, 4), "float32")):
+        with R.dataflow():
+            lv0 = R.call_tir(add_one, (x,), (2, 4), dtype="float32")
+            lv1 = R.call_tir(add_one, (lv0,), (2, 4), dtype="float32")
+            t = (lv0, lv1)
+            lv2 = t[0]
+            gv = R.call_tir(add_one, (lv2,), (2, 4), dtype="float32")
+            R.output(gv)
+        return gv
+
+    @R.function
+    def tuple_escape(x: R.Tensor((2, 4), "float32")):
+        with R.dataflow():
+            lv0 = R.call_tir(add_one, (x,), (2, 4), dtype="float32")
+            lv1 = R.call_tir(add_one, (lv0,), (2, 4), dtype="float32")
+            gv = (lv0, lv1)
+            R.output(gv)
+        return gv
+
+    @R.function
+    def packed_alias(x: R.Tensor((2, 4), "float32")):
+        lv0 = R.call_tir(add_one, (x,), (2, 4), dtype="float32")
+        lv1 = R.call_packed("vm.builtin.copy", lv0, type_args=(R.Tensor(ndim=2, dtype="float32")))
+        gv = R.call_tir(add_one, (lv1,), (2, 4), dtype="float32")
+        return gv
+
+
+def _bindings(func):
+    return [binding for block in func.body.blocks for binding in block.bindings]
+
+
+def _op_name(binding):
+    value = binding.value
+    if isinstance(value, relax.Call) and isinstance(value.op, tvm.ir.Op):
+        return value.op.name
+    return None
+
+
+def _kill_after_last_use(mod, plan=False):
+    passes = [relax.transform.ToNonDataflow(), relax.transform.CallTIRRewrite()]
+    if plan:
+        passes.append(relax.transform.StaticPlanBlockMemory())
+    passes.append(relax.transform.KillAfterLastUse())
+    return tvm.transform.Sequential(passes)(mod)
+
+
+def _kill_index(bindings, var):
+    for i, binding in enumerate(bindings):
+        if _op_name(binding) == "relax.memory.kill_tensor" and binding.value.args[0].same_as(var):
+            return i
+    return None
+
+
+def _last_call_tir_index(bindings):
+    return max(
+        i
+        for i, binding in enumerate(bindings)
+        if isinstance(binding.value, relax.Call) and isinstance(binding.value.op, relax.GlobalVar)
+    )
+
+
+def _killed_names(bindings):
+    return [
+        binding.value.args[0].name_hint
+        for binding in bindings
+        if _op_name(binding) in ("relax.memory.kill_tensor", "relax.memory.kill_storage")
+    ]
+
+
+def test_kill_through_tuple_alias():
+    bindings = _bindings(_kill_after_last_use(Alias)["tuple_alias"])
+    allocs = [b.var for b in bindings if _op_name(b) == "relax.builtin.alloc_tensor"]
+    assert len(allocs) == 3
+    # t[0] may alias any field of t, so lv0 and lv1 live until the last call reads it.
+    lv0_kill = _kill_index(bindings, allocs[0])
+    lv1_kill = _kill_index(bindings, allocs[1])
+    assert lv0_kill is not None and lv1_kill is not None
+    assert lv0_kill > _last_call_tir_index(bindings)
+    assert lv1_kill > _last_call_tir_index(bindings)
+    # the tuple and the projection holding them are released as well.
+    killed = _killed_names(bindings)
+    assert {"lv0", "lv1", "t", "lv2"} <= set(killed)
+    assert len(killed) == len(set(killed))
+    # the output is never killed.
+    assert _kill_index(bindings, allocs[2]) is None
+    assert "gv" not in killed
+
+
+def test_no_kill_of_escaping_tuple():
+    names = [_op_name(b) for b in _bindings(_kill_after_last_use(Alias)["tuple_escape"])]
+    assert "relax.memory.kill_tensor" not in names
+
+
+def test_kill_through_packed_result():
+    bindings = _bindings(_kill_after_last_use(Alias)["packed_alias"])
+    allocs = [b.var for b in bindings if _op_name(b) == "relax.builtin.alloc_tensor"]
+    assert len(allocs) == 2
+    # the packed result may be lv0 itself, so lv0 lives until the call reading it.
+    lv0_kill = _kill_index(bindings, allocs[0])
+    assert lv0_kill is not None
+    assert lv0_kill > _last_call_tir_index(bindings)
+    assert {"lv0", "lv1"} <= set(_killed_names(bindings))
+    assert _kill_index(bindings, allocs[1]) is None
+
+
+def test_kill_planned_storage():
+    bindings = _bindings(_kill_after_last_use(Alias, plan=True)["tuple_alias"])
+    names = [_op_name(b) for b in bindings]
+    assert {"t", "lv2"} <= set(_killed_names(bindings))
+    assert names.count("relax.memory.kill_storage") >= 1
+    # the storage is released after all the tensors allocated from it.
+    last_kill_tensor = len(names) - 1 - names[::-1].index("relax.memory.kill_tensor")
+    assert names.index("relax.memory.kill_storage") > last_kill_tensor
+
+
+def test_vm_run():
+    target = tvm.target.Target("llvm", host="llvm")
+    ex = relax.vm.build(Alias, target)
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    x_np = np.random.rand(2, 4).astype(np.float32)
+    res = vm["tuple_alias"](tvm.nd.array(x_np))
+    tvm.testing.assert_allclose(res.numpy(), x_np + 2, rtol=1e-7, atol=1e-7)
+    res = vm["packed_alias"](tvm.nd.array(x_np))
+    tvm.testing.assert_allclose(res.numpy(), x_np + 2, rtol=1e-7, atol=1e-7)
+    lv0, lv1 = vm["tuple_escape"](tvm.nd.array(x_np))
+    tvm.testing.assert_allclose(lv0.numpy(), x_np + 1, rtol=1e-7, atol=1e-7)
+    tvm.testing.assert_allclose(lv1.numpy(), x_np + 2, rtol=1e-7, atol=1e-7)
+
+
+@tvm.script.ir_module
+class AliasInUse:
+    @T.prim_func
+    def add_one(A: T.Buffer[(2, 4), "float32"], B: T.Buffer[(2, 4), "float32"]) -> None:
+        for i, j in T.grid(2, 4):
+            with T.block("add_one"):
+                vi, vj = T.axis.remap("SS", [i, j])
+                B[vi, vj] = A[vi, vj] + T.float32(1)
+
+    @R.function
+    def tuple_alias(x: R.Tensor((2, 4), "float32")):
+        s0 = R.call_packed(
+            "test.kill.record_in_use", x, type_args=(R.Tensor(ndim=2, dtype="float32"))
+        )
+        lv0 = R.call_tir(add_one, (x,), (2, 4), dtype="float32")
+        lv1 = R.call_tir(add_one, (lv0,), (2, 4), dtype="float32")
+        s1 = R.call_packed(
+            "test.kill.record_in_use", x, type_args=(R.Tensor(ndim=2, dtype="float32"))
+        )
+        t = (lv0, lv1)
+        lv2 = t[0]
+        gv = R.call_tir(add_one, (lv2,), (2, 4), dtype="float32")
+        s2 = R.call_packed(
+            "test.kill.record_in_use", x, type_args=(R.Tensor(ndim=2, dtype="float32"))
+        )
+        return gv
+
+    @R.function
+    def packed_alias(x: R.Tensor((2, 4), "float32")):
+        s0 = R.call_packed(
+            "test.kill.record_in_use", x, type_args=(R.Tensor(ndim=2, dtype="float32"))
+        )
+        lv0 = R.call_tir(add_one, (x,), (2, 4), dtype="float32")
+        lv1 = R.call_packed("vm.builtin.copy", lv0, type_args=(R.Tensor(ndim=2, dtype="float32")))
+        s1 = R.call_packed(
+            "test.kill.record_in_use", x, type_args=(R.Tensor(ndim=2, dtype="float32"))
+        )
+        gv = R.call_tir(add_one, (lv1,), (2, 4), dtype="float32")
+        s2 = R.call_packed(
+            "test.kill.record_in_use", x, type_args=(R.Tensor(ndim=2, dtype="float32"))
+        )
+        return gv
+
+
+def test_vm_release_aliases():
+    target = tvm.target.Target("llvm", host="llvm")
+    ex = relax.vm.build(AliasInUse, target)
+    in_use = []
+
+    def record_in_use(x):
+        in_use.append(vm.memory_stats(tvm.cpu())["bytes_in_use"])
+        return x
+
+    tvm.register_func("test.kill.record_in_use", record_in_use, override=True)
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    x = tvm.nd.array(np.random.rand(2, 4).astype(np.float32))
+    # The number of intermediate buffers live at the second record of each function.
+    for name, num_live in [("tuple_alias", 2), ("packed_alias", 1)]:
+        in_use.clear()
+        vm[name](x)
+        assert len(in_use) == 3
+        buffer_bytes = (in_use[1] - in_use[0]) // num_live
+        assert buffer_bytes > 0
+        # The intermediates went back to the allocator through every register holding them,
+        # only the output is still in use at the last record.
+        assert in_use[2] - in_use[0] == buffer_bytes, name
+
+
+if __name__ == "__main__":
+    tvm.testing.main()
@@ -0,0 +1,130 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import numpy as np
+import tvm
+import tvm.testing
+from tvm import relax
+from tvm.script import relax as R, tir as T
+
+
+@tvm.script.ir_module
+class Matmul:
+    @T.prim_func
+    def tir_matmul(x: T.handle, y: T.handle, z: T.handle) -> None:
+        m = T.var("int32")
+        n = T.var("int32")
+        k = T.var("int32")
+        A = T.match_buffer(x, (m, n))
+        B = T.match_buffer(y, (n, k))
+        C = T.match_buffer(z, (m, k))
+        for i, j, k in T.grid(m, k, n):
+            with T.block("matmul"):
+                vi, vj, vk = T.axis.remap("SSR", [i, j, k])
+                with T.init():
+                    C[vi, vj] = T.float32(0)
+                C[vi, vj] = C[vi, vj] + A[vi, vk] * B[vk, vj]
+
+    @R.function
+    def main(x: R.Tensor(("m", "n"), "float32"), w: R.Tensor(("n", 8), "float32")):
+        m = T.var("int64")
+        gv0 = R.call_tir(tir_matmul, (x, w), (m, 8), dtype="float32")
+        return gv0
+
+
+def test_specialize_shapes():
+    m, n = Matmul["main"].params[0].struct_info.shape.values
+    mod = relax.transform.SpecializeShapes("main", {m: 4, n: 16})(Matmul)
+    main = mod["main"]
+    assert [int(dim) for dim in main.params[0].struct_info.shape.values] == [4, 16]
+    assert [int(dim) for dim in main.params[1].struct_info.shape.values] == [16, 8]
+
+    call = main.body.blocks[0].bindings[0].value
+    kernel = mod[call.args[0]]
+    assert call.args[0].name_hint != "tir_matmul"
+    assert len(kernel.params) == 3
+    shapes = [[int(dim) for dim in kernel.buffer_map[p].shape] for p in kernel.params]
+    assert shapes == [[4, 16], [16, 8], [4, 8]]
+    # The generic kernel is kept.
+    assert mod.get_global_var("tir_matmul")
+
+    target = tvm.target.Target("llvm", host="llvm")
+    vm = relax.VirtualMachine(relax.vm.build(mod, target), tvm.cpu())
+    x = tvm.nd.array(np.random.rand(4, 16).astype(np.float32))
+    w = tvm.nd.array(np.random.rand(16, 8).astype(np.float32))
+    res = vm["main"](x, w)
+    tvm.testing.assert_allclose(res.numpy(), np.dot(x.numpy(), w.numpy()), rtol=1e-6, atol=1e-6)
+
+
+def test_specialize_shapes_partial():
+    n = Matmul["main"].params[0].struct_info.shape.values[1]
+    mod = relax.transform.SpecializeShapes("main", {n: 16})(Matmul)
+    main = mod["main"]
+    assert isinstance(main.params[0].struct_info.shape.values[0], tvm.tir.Var)
+    call = main.body.blocks[0].bindings[0].value
+    # The kernel stays dynamic while m is unknown.
+    assert call.args[0].name_hint == "tir_matmul"
+
+
+def test_shape_bucketed_vm():
+    target = tvm.target.Target("llvm", host="llvm")
+    vm = relax.ShapeBucketedVirtualMachine(
+        Matmul, target, tvm.cpu(), hot_threshold=2, max_buckets=1
+    )
+    w = tvm.nd.array(np.random.rand(16, 8).astype(np.float32))
+
+    def check(m):
+        x = tvm.nd.array(np.random.rand(m, 16).astype(np.float32))
+        res = vm(x, w)
+        expected = np.dot(x.numpy(), w.numpy())
+        tvm.testing.assert_allclose(res.numpy(), expected, rtol=1e-6, atol=1e-6)
+
+    for m in [4, 4, 4, 3, 3, 3]:
+        # The specialized executable is built in the background.
+        check(m)
+    vm.wait_for_builds()
+    check(4)
+    assert vm.specialized_shapes == [((4, 16), (16, 8))]
+
+
+def test_specialize_shapes_by_var():
+    @tvm.script.ir_module
+    class Add:
+        @T.prim_func
+        def tir_add(x: T.handle, y: T.handle, z: T.handle) -> None:
+            n = T.var("int32")
+            A = T.match_buffer(x, (n,))
+            B = T.match_buffer(y, (n,))
+            C = T.match_buffer(z, (n,))
+            for i in T.serial(n):
+                with T.block("add"):
+                    vi = T.axis.remap("S", [i])
+                    C[vi] = A[vi] + B[vi]
+
+        @R.function
+        def main(x: R.Tensor(("n",), "float32")):
+            n = T.var("int64")
+            gv0 = R.call_tir(tir_add, (x, x), (n,), dtype="float32")
+            return gv0
+
+    # Another var named n, which is not the one of the parameter of main.
+    other_n = tvm.tir.Var("n", "int64")
+    mod = relax.transform.SpecializeShapes("main", {other_n: 4})(Add)
+    assert isinstance(mod["main"].params[0].struct_info.shape.values[0], tvm.tir.Var)
+
+
+if __name__ == "__main__":
+    tvm.testing.main()
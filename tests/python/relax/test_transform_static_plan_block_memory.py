@@ -0,0 +1,105 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import numpy as np
+import tvm
+import tvm.testing
+from tvm import relax
+from tvm.script import relax as R, tir as T
+
+
+@tvm.script.ir_module
+class Chain:
+    @T.prim_func
+    def add_one(A: T.Buffer[(2, 4), "float32"], B: T.Buffer[(2, 4), "float32"]) -> None:
+        for i, j in T.grid(2, 4):
+            with T.block("add_one"):
+                vi, vj = T.axis.remap("SS", [i, j])
+                B[vi, vj] = A[vi, vj] + T.float32(1)
+
+    @R.function
+    def main(x: R.Tensor((2, 4), "float32")):
+        with R.dataflow():
+            lv0 = R.call_tir(add_one, (x,), (2, 4), dtype="float32")
+            lv1 = R.call_tir(add_one, (lv0,), (2, 4), dtype="float32")
+            lv2 = R.call_tir(add_one, (lv1,), (2, 4), dtype="float32")
+            gv = R.call_tir(add_one, (lv2,), (2, 4), dtype="float32")
+            R.output(gv)
+        return gv
+
+
+def _plan(mod):
+    seq = tvm.transform.Sequential(
+        [
+            relax.transform.ToNonDataflow(),
+            relax.transform.CallTIRRewrite(),
+            relax.transform.StaticPlanBlockMemory(),
+        ]
+    )
+    return seq(mod)
+
+
+def _alloc_calls(func, op_name):
+    return [
+        binding.value
+        for block in func.body.blocks
+        for binding in block.bindings
+        if isinstance(binding.value, relax.Call)
+        and isinstance(binding.value.op, tvm.ir.Op)
+        and binding.value.op.name == op_name
+    ]
+
+
+def test_reuse_non_overlapping_tensors():
+    func = _plan(Chain)["main"]
+
+    storages = _alloc_calls(func, "relax.memory.alloc_storage")
+    assert len(storages) == 1
+    # lv0 and lv2 are never alive at the same time and share the offset 0.
+    tensors = _alloc_calls(func, "relax.memory.alloc_tensor")
+    assert [t.attrs.offset for t in tensors] == [0, 64, 0]
+    assert all(t.args[0].same_as(func.body.blocks[0].bindings[0].var) for t in tensors)
+    assert storages[0].args[0].values[0].value == 96
+    # the output of the function is not planned.
+    assert len(_alloc_calls(func, "relax.builtin.alloc_tensor")) == 1
+
+
+def test_symbolic_shape_not_planned():
+    @tvm.script.ir_module
+    class Module:
+        @R.function
+        def main(x: R.Tensor(("n",), "float32")):
+            n = T.var("int64")
+            lv0 = R.call_tir("test.vm.identity", (x,), (n,), dtype="float32")
+            gv = R.call_tir("test.vm.identity", (lv0,), (n,), dtype="float32")
+            return gv
+
+    func = _plan(Module)["main"]
+    assert len(_alloc_calls(func, "relax.memory.alloc_storage")) == 0
+    assert len(_alloc_calls(func, "relax.builtin.alloc_tensor")) == 2
+
+
+def test_vm_run():
+    target = tvm.target.Target("llvm", host="llvm")
+    ex = relax.vm.build(Chain, target)
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    x_np = np.random.rand(2, 4).astype(np.float32)
+    res = vm["main"](tvm.nd.array(x_np))
+    tvm.testing.assert_allclose(res.numpy(), x_np + 4, rtol=1e-7, atol=1e-7)
+
+
+if __name__ == "__main__":
+    tvm.testing.main()
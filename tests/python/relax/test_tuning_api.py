@@ -17,6 +17,7 @@
 
 import pytest
 import numpy as np
+import os
 import os.path as osp
 import tempfile
 from typing import List
@@ -36,6 +37,7 @@ from tvm.relax.transform.tuning_api import (
     Trace,
     TuningRecord,
     JSONDatabase,
+    IndexedDatabase,
     default_generate_candidate,
     default_consider_eval_passes,
     default_evaluate,
@@ -381,6 +383,96 @@ def test_database():
         assert len(new_tuning_records) == 0
 
 
+def test_indexed_database():
+    mod1, mod2 = setup_test_const_folding()
+    knob = Knob("test", {"noapply": Choice()})
+    trace = Trace(mod1, [knob, knob], ["noapply", "noapply"])
+    target = tvm.target.Target("llvm")
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        database = IndexedDatabase(tmpdir, top_k=2)
+        workload1 = database.commit_workload(mod1)
+        database.commit_measurement_record(workload1, target, [1.0, 0.5])
+        for run_secs in [[0.3], [0.1], [0.2]]:
+            database.commit_tuning_record(workload1, target, TuningRecord(trace, run_secs))
+        assert not database.has_workload(mod2)
+
+        # Reopen the database, which only loads the index.
+        database = IndexedDatabase(tmpdir, top_k=2)
+        assert database.has_workload(mod1)
+        workload1 = database.commit_workload(mod1)
+        assert database.has_tuning_record(workload1, target)
+        records = database.get_top_k(workload1, target, top_k=5)
+        assert [float(record.run_secs[0]) for record in records] == pytest.approx([0.1, 0.2])
+        assert len(database.get_measurement_record(workload1, target)) == 2
+
+        database.compact()
+        database = IndexedDatabase(tmpdir, top_k=2)
+        workload1 = database.commit_workload(mod1)
+        records = database.get_top_k(workload1, target, top_k=1)
+        assert len(records) == 1
+        assert str(records[0].trace) == str(trace)
+        workload2 = database.commit_workload(mod2)
+        assert not database.has_tuning_record(workload2, target)
+        assert len(database.get_measurement_record(workload2, target)) == 0
+        # The records of a target are not found for another one.
+        assert not database.has_tuning_record(workload1, tvm.target.Target("llvm -num-cores=2"))
+
+
+def test_indexed_database_interrupted_compact():
+    mod1, _ = setup_test_const_folding()
+    knob = Knob("test", {"noapply": Choice()})
+    trace = Trace(mod1, [knob, knob], ["noapply", "noapply"])
+    target = tvm.target.Target("llvm")
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        database = IndexedDatabase(tmpdir, top_k=1)
+        workload1 = database.commit_workload(mod1)
+        for run_secs in [[0.3], [0.1]]:
+            database.commit_tuning_record(workload1, target, TuningRecord(trace, run_secs))
+        index_path = osp.join(tmpdir, "index.bin")
+        with open(index_path, "rb") as f:
+            old_index = f.read()
+        database.compact()
+
+        # Stop the compaction after the data file is replaced, but not the index.
+        os.rename(index_path, index_path + ".tmp")
+        with open(index_path, "wb") as f:
+            f.write(old_index)
+        database = IndexedDatabase(tmpdir, top_k=1)
+        workload1 = database.commit_workload(mod1)
+        records = database.get_top_k(workload1, target, top_k=1)
+        assert [float(record.run_secs[0]) for record in records] == pytest.approx([0.1])
+
+
+def test_indexed_database_torn_commit():
+    mod1, _ = setup_test_const_folding()
+    knob = Knob("test", {"noapply": Choice()})
+    trace = Trace(mod1, [knob, knob], ["noapply", "noapply"])
+    target = tvm.target.Target("llvm")
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        database = IndexedDatabase(tmpdir, top_k=3)
+        workload1 = database.commit_workload(mod1)
+        for run_secs in [[0.3], [0.1]]:
+            database.commit_tuning_record(workload1, target, TuningRecord(trace, run_secs))
+
+        # Stop the last commit in the middle of writing its index entry.
+        index_path = osp.join(tmpdir, "index.bin")
+        os.truncate(index_path, os.path.getsize(index_path) - 10)
+        database = IndexedDatabase(tmpdir, top_k=3)
+        workload1 = database.commit_workload(mod1)
+        records = database.get_top_k(workload1, target, top_k=3)
+        assert [float(record.run_secs[0]) for record in records] == pytest.approx([0.3])
+
+        # The commits after the torn one are read back once the database is reopened.
+        database.commit_tuning_record(workload1, target, TuningRecord(trace, [0.2]))
+        database = IndexedDatabase(tmpdir, top_k=3)
+        workload1 = database.commit_workload(mod1)
+        records = database.get_top_k(workload1, target, top_k=3)
+        assert [float(record.run_secs[0]) for record in records] == pytest.approx([0.2, 0.3])
+        assert all(str(record.trace) == str(trace) for record in records)
+
 def test_default_functions():
     mod = setup_test()
     assert isinstance(mod, tvm.IRModule)
@@ -15,10 +15,13 @@
 # specific language governing permissions and limitations
 # under the License.
 import os
+from concurrent.futures import ThreadPoolExecutor
 from typing import Any, Callable, List, Tuple
 
 import sys
 import tempfile
+import threading
+import time
 import numpy as np
 import pytest
 import tvm
@@ -647,6 +650,129 @@ def test_vm_emit_te_constant_param_cpu():
     tvm.testing.assert_allclose(add_res.numpy(), x_np + c_np, rtol=1e-7, atol=1e-7)
 
 
+def test_vm_profile():
+    x_np = np.random.rand(2, 2).astype("float32")
+    bb = relax.BlockBuilder()
+    x = relax.Var("x", R.Tensor((2, 2), "float32"))
+    with bb.function("main", [x]):
+        with bb.dataflow():
+            lv0 = bb.emit_te(topi.add, x, x)
+            lv1 = bb.emit_te(topi.multiply, lv0, x)
+            gv = bb.emit_output(lv1)
+        bb.emit_func_output(gv)
+
+    ex = relax.vm.build(bb.get(), "llvm")
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    report = vm.profile("main", tvm.nd.array(x_np))
+    names = [str(call["Name"]) for call in report.calls]
+    assert "add" in names
+    assert "multiply" in names
+    assert any(name == "vm.builtin.alloc_storage" for name in names)
+    alloc_calls = [c for c in report.calls if str(c["Name"]) == "vm.builtin.alloc_storage"]
+    assert all(c["Allocated Bytes"].value > 0 for c in alloc_calls)
+    assert "Device Sync" in report.calls[0]
+    # The VM still runs normally after profiling.
+    res = vm["main"](tvm.nd.array(x_np))
+    tvm.testing.assert_allclose(res.numpy(), (x_np + x_np) * x_np, rtol=1e-7, atol=1e-7)
+
+
+def test_vm_to_device_multi_device():
+    x_np = np.random.rand(2, 2).astype("float32")
+    c_np = np.random.rand(2, 2).astype("float32")
+    bb = relax.BlockBuilder()
+    x = relax.Var("x", R.Tensor((2, 2), "float32"))
+    with bb.function("main", [x]):
+        with bb.dataflow():
+            lv0 = bb.emit(relax.op.to_device(x, 1))
+            c = bb.emit(relax.op.to_device(relax.const(c_np, "float32"), 1))
+            lv1 = bb.emit_te(topi.add, lv0, c)
+            lv2 = bb.emit(relax.op.to_device(lv1, 0))
+            lv3 = bb.emit_te(topi.multiply, lv2, lv2)
+            gv = bb.emit_output(lv3)
+        bb.emit_func_output(gv)
+
+    mod = relax.transform.CallTIRRewrite()(relax.transform.ToNonDataflow()(bb.get()))
+    alloc_device_indexes = []
+
+    def _record_alloc(expr):
+        if isinstance(expr, relax.Call) and expr.op == tvm.ir.Op.get("relax.builtin.alloc_tensor"):
+            alloc_device_indexes.append(expr.attrs.runtime_device_index)
+
+    relax.analysis.post_order_visit(mod["main"], _record_alloc)
+    assert sorted(alloc_device_indexes) == [0, 1]
+
+    ex = relax.vm.build(bb.get(), "llvm")
+    # Three CPU devices, the last one is the host.
+    vm = relax.VirtualMachine(ex, [tvm.cpu(1), tvm.cpu(2), tvm.cpu(0)])
+    res = vm["main"](tvm.nd.array(x_np, tvm.cpu(1)))
+    assert res.device == tvm.cpu(1)
+    expected = (x_np + c_np) * (x_np + c_np)
+    tvm.testing.assert_allclose(res.numpy(), expected, rtol=1e-7, atol=1e-7)
+
+
+def test_vm_to_device_host():
+    x_np = np.random.rand(2, 2).astype("float32")
+    bb = relax.BlockBuilder()
+    x = relax.Var("x", R.Tensor((2, 2), "float32"))
+    with bb.function("main", [x]):
+        with bb.dataflow():
+            # Device -1 is the host.
+            lv0 = bb.emit(relax.op.to_device(x, -1))
+            lv1 = bb.emit_te(topi.add, lv0, lv0)
+            lv2 = bb.emit(relax.op.to_device(lv1, 0))
+            gv = bb.emit_output(lv2)
+        bb.emit_func_output(gv)
+
+    mod = relax.transform.CallTIRRewrite()(relax.transform.ToNonDataflow()(bb.get()))
+    alloc_device_indexes = []
+
+    def _record_alloc(expr):
+        if isinstance(expr, relax.Call) and expr.op == tvm.ir.Op.get("relax.builtin.alloc_tensor"):
+            alloc_device_indexes.append(expr.attrs.runtime_device_index)
+
+    relax.analysis.post_order_visit(mod["main"], _record_alloc)
+    assert alloc_device_indexes == [-1]
+
+    ex = relax.vm.build(bb.get(), "llvm")
+    vm = relax.VirtualMachine(ex, [tvm.cpu(1), tvm.cpu(0)])
+    res = vm["main"](tvm.nd.array(x_np, tvm.cpu(1)))
+    assert res.device == tvm.cpu(1)
+    tvm.testing.assert_allclose(res.numpy(), x_np + x_np, rtol=1e-7, atol=1e-7)
+
+def test_vm_exec_save_file_mapped_constants():
+    x_np = np.random.rand(2, 2).astype("float32")
+    c_np = np.random.rand(2, 2).astype("float32")
+    d_np = np.random.rand(3).astype("float32")
+
+    bb = relax.BlockBuilder()
+    x = relax.Var("x", R.Tensor((2, 2), "float32"))
+    with bb.function("main", [x]):
+        with bb.dataflow():
+            lv0 = bb.emit_te(topi.add, x, relax.const(c_np, "float32"))
+            gv = bb.emit_output(relax.Tuple([lv0, relax.const(d_np, "float32")]))
+        bb.emit_func_output(gv)
+
+    ex = relax.vm.build(bb.get(), "llvm")
+
+    from tvm.contrib import utils
+
+    temp_dir = utils.tempdir()
+    path_exec = temp_dir.relpath("exec.rxexec")
+    path_lib = temp_dir.relpath("lib.so")
+    ex.mod.save(path_exec)
+    ex.mod.imported_modules[0].export_library(path_lib)
+
+    loaded = tvm.runtime.load_module(path_exec, "relax.Executable")
+    loaded.import_module(tvm.runtime.load_module(path_lib))
+    loaded_exec = relax.vm.Executable(loaded)
+    assert ex.as_text() == loaded_exec.as_text()
+
+    vm = relax.VirtualMachine(loaded_exec, tvm.cpu())
+    res = vm["main"](tvm.nd.array(x_np))
+    tvm.testing.assert_allclose(res[0].numpy(), x_np + c_np, rtol=1e-7, atol=1e-7)
+    tvm.testing.assert_allclose(res[1].numpy(), d_np, rtol=1e-7, atol=1e-7)
+
+
 @tvm.testing.requires_gpu
 def test_vm_emit_te_constant_param_gpu():
     x_np = np.random.rand(2, 2).astype("float32")
@@ -674,6 +800,41 @@ def test_vm_emit_te_constant_param_gpu():
     tvm.testing.assert_allclose(add_res.numpy(), x_np + c_np, rtol=1e-7, atol=1e-7)
 
 
+@tvm.testing.requires_gpu
+def test_vm_async_execution_gpu():
+    @tvm.script.ir_module
+    class TestVMAsyncIf:
+        @T.prim_func
+        def add_one(A: T.Buffer[(4,), "float32"], B: T.Buffer[(4,), "float32"]):
+            for i in T.thread_binding(4, thread="threadIdx.x"):
+                with T.block("B"):
+                    vi = T.axis.spatial(4, i)
+                    B[vi] = A[vi] + T.float32(1)
+
+        @R.function
+        def main(cond: R.Tensor((), "bool"), x: R.Tensor((4,), "float32")):
+            if cond:
+                y = R.call_tir(add_one, (x,), (4,), dtype="float32")
+                w = R.call_tir(add_one, (y,), (4,), dtype="float32")
+            else:
+                w = R.call_tir(add_one, (x,), (4,), dtype="float32")
+            return w
+
+    ex = relax.vm.build(TestVMAsyncIf, "cuda")
+    dev = tvm.cuda()
+    vm = relax.VirtualMachine(ex, dev)
+    vm.set_async_execution(True)
+    x_np = np.random.rand(4).astype("float32")
+    x = tvm.nd.array(x_np, dev)
+    res = vm["main"](tvm.nd.array(True, dev), x)
+    tvm.testing.assert_allclose(res.numpy(), x_np + 2, rtol=1e-7, atol=1e-7)
+    res = vm["main"](tvm.nd.array(False, dev), x)
+    tvm.testing.assert_allclose(res.numpy(), x_np + 1, rtol=1e-7, atol=1e-7)
+    vm.set_async_execution(False)
+    res = vm["main"](tvm.nd.array(True, dev), x)
+    tvm.testing.assert_allclose(res.numpy(), x_np + 2, rtol=1e-7, atol=1e-7)
+
+
 def test_vm_relax_symbolic_shape():
     bb = relax.BlockBuilder()
     n = tir.Var("n", "int64")
@@ -1023,6 +1184,127 @@ def test_vm_invoke_closure():
     )
 
 
+def test_vm_concurrent_invoke():
+    @tvm.script.ir_module
+    class TestVMConcurrent:
+        @R.function
+        def recursion(n: R.Tensor((1,), "float32")) -> R.Tensor:
+            cond = R.call_packed(
+                "test.vm.equal_zero", n, type_args=(R.Tensor(ndim=1, dtype="float32"))
+            )
+            if cond:
+                res = R.const(1.0)
+            else:
+                gv0 = R.call_packed(
+                    "test.vm.subtract_one", n, type_args=(R.Tensor(ndim=1, dtype="float32"))
+                )
+                tmp = recursion(gv0)
+                res = R.call_packed(
+                    "test.vm.add", tmp, tmp, type_args=(R.Tensor(ndim=1, dtype="float32"))
+                )
+            return res
+
+    target = tvm.target.Target("llvm", host="llvm")
+    ex = relax.vm.build(TestVMConcurrent, target)
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    func = vm["recursion"]
+
+    def run(runs):
+        for _ in range(20):
+            res = func(tvm.nd.array(np.full((1,), runs, dtype="float32")))
+            tvm.testing.assert_allclose(res.numpy(), np.power(2.0, runs), rtol=1e-7, atol=1e-7)
+        return runs
+
+    # Each thread runs with its own frames on the same VM.
+    with ThreadPoolExecutor(max_workers=4) as executor:
+        assert list(executor.map(run, range(1, 9))) == list(range(1, 9))
+
+
+def test_vm_context_released_on_thread_exit():
+    ib = relax.ExecBuilder()
+    with ib.function("main", num_inputs=0):
+        ib.emit_call(
+            "vm.builtin.alloc_storage",
+            args=[ib.vm_state(), (1024 * 1024,), ib.imm(0), tvm.DataType("float32")],
+            dst=ib.r(0),
+        )
+        ib.emit_ret(ib.r(0))
+    ex = ib.get()
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    bytes_in_use = vm.memory_stats(tvm.cpu())["bytes_in_use"]
+
+    def run():
+        # The output of the stateful call is held by the context of the thread.
+        vm.set_input("main")
+        vm.invoke_stateful("main")
+
+    thread = threading.Thread(target=run)
+    thread.start()
+    thread.join()
+    # The context, and the output it holds, is released once the thread has exited.
+    deadline = time.time() + 5
+    while vm.memory_stats(tvm.cpu())["bytes_in_use"] != bytes_in_use and time.time() < deadline:
+        time.sleep(0.01)
+    assert vm.memory_stats(tvm.cpu())["bytes_in_use"] == bytes_in_use
+
+
+def test_vm_pooled_allocator():
+    ib = relax.ExecBuilder()
+    with ib.function("main", num_inputs=0):
+        ib.emit_call(
+            "vm.builtin.alloc_storage",
+            args=[ib.vm_state(), (1024 * 1024,), ib.imm(0), tvm.DataType("float32")],
+            dst=ib.r(0),
+        )
+        ib.emit_ret(ib.r(0))
+    ex = ib.get()
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    vm.trim_memory(tvm.cpu())
+    vm["main"]()
+    before = vm.memory_stats(tvm.cpu())
+    assert before["bytes_cached"] >= 1024 * 1024
+    # The buffer freed by the previous call is reused.
+    vm["main"]()
+    after = vm.memory_stats(tvm.cpu())
+    assert after["num_allocs"] == before["num_allocs"] + 1
+    assert after["num_hits"] == before["num_hits"] + 1
+    assert after["hit_rate"] > before["hit_rate"]
+    vm.trim_memory(tvm.cpu())
+    assert vm.memory_stats(tvm.cpu())["bytes_cached"] == 0
+
+
+def test_vm_pooled_allocator_limit_and_idle_trim():
+    ib = relax.ExecBuilder()
+    with ib.function("main", num_inputs=0):
+        ib.emit_call(
+            "vm.builtin.alloc_storage",
+            args=[ib.vm_state(), (1024 * 1024,), ib.imm(0), tvm.DataType("float32")],
+            dst=ib.r(0),
+        )
+        ib.emit_ret(ib.r(0))
+    ex = ib.get()
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    vm.trim_memory(tvm.cpu())
+    in_use = vm.memory_stats(tvm.cpu())["bytes_in_use"]
+    # The cap is enforced: an allocation past it fails instead of growing the pool.
+    vm.set_memory_limit(tvm.cpu(), in_use + 512 * 1024)
+    try:
+        with pytest.raises(TVMError):
+            vm["main"]()
+    finally:
+        vm.set_memory_limit(tvm.cpu(), 0)
+    vm.set_idle_trim(tvm.cpu(), 200)
+    try:
+        vm["main"]()
+        assert vm.memory_stats(tvm.cpu())["bytes_cached"] >= 1024 * 1024
+        deadline = time.time() + 5
+        while vm.memory_stats(tvm.cpu())["bytes_cached"] != 0 and time.time() < deadline:
+            time.sleep(0.01)
+        assert vm.memory_stats(tvm.cpu())["bytes_cached"] == 0
+    finally:
+        vm.set_idle_trim(tvm.cpu(), 0)
+
+
 def test_time_evaluator():
     @tvm.script.ir_module
     class TestTimeEvaluator:
@@ -1268,5 +1550,110 @@ def test_set_input_get_failure_rpc():
     run_on_rpc(TestVMSetInput, set_input_attempt_get)
 
 
+def test_vm_load_prepacked_params():
+    @tvm.script.ir_module
+    class TestVMPrepack:
+        @T.prim_func
+        def transpose(A: T.Buffer[(3, 4), "float32"], B: T.Buffer[(4, 3), "float32"]):
+            T.func_attr({"global_symbol": "transpose"})
+            for i, j in T.grid(4, 3):
+                with T.block("transpose"):
+                    vi, vj = T.axis.remap("SS", [i, j])
+                    B[vi, vj] = A[vj, vi]
+
+        @T.prim_func
+        def add(
+            A: T.Buffer[(4, 3), "float32"],
+            B: T.Buffer[(4, 3), "float32"],
+            C: T.Buffer[(4, 3), "float32"],
+        ):
+            T.func_attr({"global_symbol": "add"})
+            for i, j in T.grid(4, 3):
+                with T.block("add"):
+                    vi, vj = T.axis.remap("SS", [i, j])
+                    C[vi, vj] = A[vi, vj] + B[vi, vj]
+
+        @R.function
+        def main(x: R.Tensor((4, 3), "float32"), w: R.Tensor((3, 4), "float32")):
+            with R.dataflow():
+                wt = R.call_tir(transpose, (w,), (4, 3), dtype="float32")
+                gv = R.call_tir(add, (x, wt), (4, 3), dtype="float32")
+                R.output(gv)
+            return gv
+
+        @R.function
+        def transposed_const():
+            c = R.const(
+                [[1.0, 2.0, 3.0, 4.0], [5.0, 6.0, 7.0, 8.0], [9.0, 10.0, 11.0, 12.0]],
+                dtype="float32",
+            )
+            gv = R.call_tir(transpose, (c,), (4, 3), dtype="float32")
+            return gv
+
+    w_np = np.random.rand(3, 4).astype("float32")
+    mod, params = relax.transform.prepack_params(TestVMPrepack, "main", {"w": w_np})
+    # Only main is folded.
+    assert mod["transposed_const"].same_as(TestVMPrepack["transposed_const"])
+    # The transposed weight is computed offline and becomes a param of main.
+    assert [p.name_hint for p in mod["main"].params] == ["x", "wt"]
+    assert list(params.keys()) == ["wt"]
+    tvm.testing.assert_allclose(params["wt"].numpy(), w_np.T)
+
+    ex = relax.vm.build(mod, "llvm")
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    vm.load_params("main", tvm.runtime.save_param_dict(params))
+    x_np = np.random.rand(4, 3).astype("float32")
+    res = vm["main"](tvm.nd.array(x_np))
+    tvm.testing.assert_allclose(res.numpy(), x_np + w_np.T, rtol=1e-7, atol=1e-7)
+
+
+def test_vm_load_params_on_param_device():
+    bb = relax.BlockBuilder()
+    x = relax.Var("x", R.Tensor((2, 2), "float32"))
+    w = relax.Var("w", R.Tensor((2, 2), "float32"))
+    with bb.function("main", [x, w]):
+        with bb.dataflow():
+            lv0 = bb.emit(relax.op.to_device(x, 1))
+            lv1 = bb.emit(relax.op.to_device(w, 1))
+            lv2 = bb.emit_te(topi.add, lv0, lv1)
+            gv = bb.emit_output(relax.Tuple([lv2, lv1]))
+        bb.emit_func_output(gv)
+
+    ex = relax.vm.build(bb.get(), "llvm")
+    # Three CPU devices, the last one is the host.
+    vm = relax.VirtualMachine(ex, [tvm.cpu(1), tvm.cpu(2), tvm.cpu(0)])
+    x_np = np.random.rand(2, 2).astype("float32")
+    w_np = np.random.rand(2, 2).astype("float32")
+    vm.load_params("main", {"w": tvm.nd.array(w_np, tvm.cpu(0))})
+    res0 = vm["main"](tvm.nd.array(x_np, tvm.cpu(1)))
+    res1 = vm["main"](tvm.nd.array(x_np, tvm.cpu(1)))
+    tvm.testing.assert_allclose(res0[0].numpy(), x_np + w_np, rtol=1e-7, atol=1e-7)
+    # w is bound on the device main moves it to, so it is not copied again by every call.
+    assert res0[1].device == tvm.cpu(2)
+    assert res0[1].handle.contents.data == res1[1].handle.contents.data
+
+
+def test_vm_load_params_queries():
+    bb = relax.BlockBuilder()
+    x = relax.Var("x", R.Tensor((2, 2), "float32"))
+    w = relax.Var("w", R.Tensor((2, 2), "float32"))
+    y = relax.Var("y", R.Tensor((2, 2), "float32"))
+    with bb.function("main", [x, w, y]):
+        gv = bb.emit_te(topi.add, bb.emit_te(topi.add, x, w), y)
+        bb.emit_func_output(gv)
+
+    ex = relax.vm.build(bb.get(), "llvm")
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    x_np, w_np, y_np = (np.random.rand(2, 2).astype("float32") for _ in range(3))
+    vm.load_params("main", {"w": tvm.nd.array(w_np)})
+    # The bound param is not a param of main anymore.
+    assert vm.module["get_function_arity"]("main") == 2
+    assert vm.module["get_function_param_name"]("main", 1) == "y"
+    vm.set_input("main", y=tvm.nd.array(y_np), x=tvm.nd.array(x_np))
+    vm.invoke_stateful("main")
+    res = vm.get_outputs("main")
+    tvm.testing.assert_allclose(res.numpy(), x_np + w_np + y_np, rtol=1e-7, atol=1e-7)
+
+
 if __name__ == "__main__":
     tvm.testing.main()
@@ -138,6 +138,34 @@ def test_load_unexpected_params():
     rt_mod.load_params(runtime.save_param_dict(new_params))
 
 
+@tvm.testing.requires_llvm
+def test_inter_op_parallelism():
+    # Independent branches, whose intermediate results share storages.
+    x = relay.var("x", shape=(8, 16))
+    branches = []
+    for i in range(4):
+        y = relay.exp(relay.add(x, relay.const(float(i))))
+        y = relay.nn.relu(relay.multiply(y, relay.const(0.5)))
+        branches.append(relay.sum(y, axis=1, keepdims=True))
+    z = relay.concatenate(branches, axis=1)
+    mod = tvm.IRModule.from_expr(relay.Function([x], z))
+    with tvm.transform.PassContext(opt_level=0):
+        lib = relay.build(mod, target="llvm")
+
+    a = np.random.uniform(size=(8, 16)).astype("float32")
+    expected = None
+    for num_groups in [0, 2, 4]:
+        rt_mod = graph_executor.GraphModule(lib["default"](tvm.cpu(0)))
+        rt_mod.set_inter_op_parallelism(num_groups)
+        for _ in range(3):
+            rt_mod.run(x=a)
+            out = rt_mod.get_output(0).numpy()
+            if expected is None:
+                expected = out
+            tvm.testing.assert_allclose(out, expected, rtol=1e-5)
+
+
 if __name__ == "__main__":
     test_graph_simple()
     test_load_unexpected_params()
+    test_inter_op_parallelism()
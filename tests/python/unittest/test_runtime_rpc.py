@@ -17,6 +17,7 @@
 import tvm
 from tvm import te
 import tvm.testing
+import ctypes
 import multiprocessing
 import os
 import stat
@@ -176,6 +177,46 @@ def test_rpc_large_array():
     check_remote()
 
 
+@tvm.testing.requires_rpc
+def test_rpc_chunked_array():
+    # small chunks, so that the copies are split and pipelined
+    old_chunk_bytes = os.environ.get("TVM_RPC_COPY_CHUNK_BYTES")
+    os.environ["TVM_RPC_COPY_CHUNK_BYTES"] = "1000"
+    try:
+        server = rpc.Server()
+        remote = rpc.connect("127.0.0.1", server.port)
+    finally:
+        if old_chunk_bytes is None:
+            del os.environ["TVM_RPC_COPY_CHUNK_BYTES"]
+        else:
+            os.environ["TVM_RPC_COPY_CHUNK_BYTES"] = old_chunk_bytes
+
+    dev = remote.cpu(0)
+    a_np = np.random.uniform(size=(123, 45)).astype("float32")
+    a = tvm.nd.array(a_np, dev)
+    np.testing.assert_equal(a.numpy(), a_np)
+    b = tvm.nd.empty((45,), "float32", dev)
+    a_np[7] = np.random.uniform(size=45)
+    b.copyfrom(a_np[7])
+    np.testing.assert_equal(b.numpy(), a_np[7])
+
+    # a view of the rows 7 to 29 of a, at a non-zero byte offset in its allocation
+    shape = (tvm._ffi.runtime_ctypes.tvm_shape_index_t * 2)(23, 45)
+    view_tensor = tvm._ffi.runtime_ctypes.TVMArray()
+    view_tensor.data = a.handle.contents.data
+    view_tensor.device = a.handle.contents.device
+    view_tensor.ndim = 2
+    view_tensor.dtype = a.handle.contents.dtype
+    view_tensor.shape = shape
+    view_tensor.byte_offset = a.handle.contents.byte_offset + 7 * 45 * 4
+    view = tvm.nd.NDArray(ctypes.pointer(view_tensor), True)
+    np.testing.assert_equal(view.numpy(), a_np[7:30])
+    rows_np = np.random.uniform(size=(23, 45)).astype("float32")
+    view.copyfrom(rows_np)
+    a_np[7:30] = rows_np
+    np.testing.assert_equal(a.numpy(), a_np)
+
+
 @tvm.testing.requires_rpc
 def test_rpc_echo():
     def check(remote):